@@ -0,0 +1,398 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: benchReservations.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: End-to-end benchmark of the reservation operations of
+* the Ferry Reservation System. Starts from empty data files in its
+* own directory, creates vessels and sailings, books the given number
+* of vehicles and then times, call by call:
+*   createSailing          SAILING request per sailing
+*   createReservation      CREATE request per vehicle (adds the vehicle)
+*   viewReservations       once per reservation, round robin over sailings
+*   checkIn                CHECKIN request per reservation
+*   updateSailing          1 m taken per reservation, round robin over sailings
+*   deleteReservation      the first half of the reservations
+*   deleteReservations     once per sailing, removing the rest
+* and writes the count, time, throughput and p50 / p99 / max latency
+* of each operation as JSON, so runs can be compared between releases.
+*
+* Usage: benchReservations [--scale=<n>[k|M]] [--per-sailing=<n>]
+*        [--durability=sync|group|async] [--dir=<path>] [--output=<file>]
+*
+* Design Issues: createReservation and checkIn of the Reservation
+* Manager ask the user for the vehicle's details, so the benchmark
+* sends the Service module's CREATE and CHECKIN requests, which do
+* the same work without asking; the other operations call the
+* managers directly. Their console messages are discarded while timed
+* The default durability is async so the log's commit interval does
+* not hide the cost of the operations; it is recorded in the results
+*/
+//============================================================
+
+#include "reservation.hpp"
+#include "reservationManager.hpp"
+#include "sailing.hpp"
+#include "sailingKey.hpp"
+#include "sailingManager.hpp"
+#include "service.hpp"
+#include "vehicle.hpp"
+#include "vessel.hpp"
+#include "writeAheadLog.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//============================================================
+// Struct: BenchOptions
+// Purpose: Settings taken from the command line
+//------------------------------------------------------------
+struct BenchOptions
+{
+    long scale = 10000;          // reservations booked
+    long perSailing = 200;       // reservations per sailing
+    std::string durability = "async";
+    std::string dir = "bench-data"; // where the data files are created
+    std::string output;          // results file, standard output if empty
+};
+
+// Struct: BenchResult
+// Purpose: Timings of one operation
+//------------------------------------------------------------
+struct BenchResult
+{
+    std::string name;
+    long count = 0;
+    double seconds = 0;
+    double p50Us = 0;
+    double p99Us = 0;
+    double maxUs = 0;
+};
+
+// Struct: NullBuffer
+// Purpose: Stream buffer that discards everything written to it
+//------------------------------------------------------------
+struct NullBuffer : std::streambuf
+{
+    int overflow(int c) override
+    {
+        return c;
+    }
+};
+
+//============================================================
+// Module scope static variables
+//------------------------------------------------------------
+static const long BENCHMAXSCALE = 10000000;  // largest number of reservations
+static const int BENCHVESSELS = 4;           // vessels the sailings are spread over
+static const long BENCHLANEMETERS = 5;       // meters of each lane per reservation a sailing holds
+static const int BENCHTERMINALSAILINGS = 28 * 24; // sailings per terminal code: 28 days, 24 hours
+static const char* DATAFILES[] = {"ferry.wal", "vehicles.dat", "vehicles.idx", "vessels.dat",
+                                  "reservations.dat", "sailings.dat"};
+static std::vector<BenchResult> results;
+
+//============================================================
+// Function parseCount reads a positive count with an optional k
+// (thousand) or M (million) suffix
+// Throws an exception if the text is not such a count
+//------------------------------------------------------------
+static long parseCount(const std::string& text)
+{
+    std::size_t used = 0;
+    long value = std::stol(text, &used);
+    if (used + 1 == text.size() && (text.back() == 'k' || text.back() == 'K'))
+    {
+        value *= 1000;
+    }
+    else if (used + 1 == text.size() && text.back() == 'M')
+    {
+        value *= 1000000;
+    }
+    else if (used != text.size())
+    {
+        throw std::runtime_error("Invalid count " + text);
+    }
+    if (value <= 0)
+    {
+        throw std::runtime_error("Invalid count " + text);
+    }
+    return value;
+}
+
+// Function parseOptions reads the command line arguments
+// Throws an exception for an unknown or malformed argument
+//------------------------------------------------------------
+static BenchOptions parseOptions(int argc, char* argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--scale=", 0) == 0)
+        {
+            options.scale = parseCount(arg.substr(8));
+        }
+        else if (arg.rfind("--per-sailing=", 0) == 0)
+        {
+            options.perSailing = parseCount(arg.substr(14));
+        }
+        else if (arg.rfind("--durability=", 0) == 0)
+        {
+            options.durability = arg.substr(13);
+            walParseDurability(options.durability);
+        }
+        else if (arg.rfind("--dir=", 0) == 0)
+        {
+            options.dir = arg.substr(6);
+        }
+        else if (arg.rfind("--output=", 0) == 0)
+        {
+            options.output = arg.substr(9);
+        }
+        else
+        {
+            throw std::runtime_error("Unknown argument " + arg);
+        }
+    }
+    if (options.scale > BENCHMAXSCALE)
+    {
+        throw std::runtime_error("--scale is at most " + std::to_string(BENCHMAXSCALE));
+    }
+    if (options.perSailing < 2)
+    {
+        throw std::runtime_error("--per-sailing must be at least 2");
+    }
+    return options;
+}
+
+// Function makeSailingID writes the ID of the n-th benchmark sailing;
+// IDs increase with n
+//------------------------------------------------------------
+static void makeSailingID(long n, char sailingID[])
+{
+    long terminal = n / BENCHTERMINALSAILINGS;
+    long rest = n % BENCHTERMINALSAILINGS;
+    std::snprintf(sailingID, SAILINGIDSIZE, "%c%c%c-%02ld-%02ld",
+                  static_cast<char>('A' + terminal / (26 * 26) % 26),
+                  static_cast<char>('A' + terminal / 26 % 26),
+                  static_cast<char>('A' + terminal % 26),
+                  rest / 24 + 1, rest % 24);
+}
+
+// Function makeLicence writes the licence plate of the n-th vehicle
+//------------------------------------------------------------
+static void makeLicence(long n, char licence[])
+{
+    std::snprintf(licence, sizeof(Reservation::vehicleLicence), "V%08ld", n % 100000000);
+}
+
+// Function request runs a Service request, throwing its reason if
+// it failed
+//------------------------------------------------------------
+static void request(const std::string& text)
+{
+    std::string reply = serviceExecute(text);
+    if (reply.rfind("OK", 0) != 0)
+    {
+        throw std::runtime_error(text + ": " + reply);
+    }
+}
+
+// Function measure calls op(i) for i from 0 to count - 1, timing each
+// call, and records the results under name
+//------------------------------------------------------------
+template <typename Operation>
+static void measure(const std::string& name, long count, Operation op)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::vector<uint32_t> nanoseconds(count); // latency of each call, saturated at ~4 s
+    auto start = Clock::now();
+    auto before = start;
+    for (long i = 0; i < count; ++i)
+    {
+        op(i);
+        auto after = Clock::now();
+        long long taken = std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
+        nanoseconds[i] = static_cast<uint32_t>(std::min<long long>(taken, UINT32_MAX));
+        before = after;
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.count = count;
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    auto percentile = [&nanoseconds](double p)
+    {
+        auto at = nanoseconds.begin() + static_cast<long>(p * (nanoseconds.size() - 1));
+        std::nth_element(nanoseconds.begin(), at, nanoseconds.end());
+        return *at / 1000.0;
+    };
+    result.p50Us = percentile(0.50);
+    result.p99Us = percentile(0.99);
+    result.maxUs = *std::max_element(nanoseconds.begin(), nanoseconds.end()) / 1000.0;
+    results.push_back(result);
+    std::cerr << std::fixed << std::setprecision(2) << std::setw(20) << std::left << name
+              << std::right << std::setw(10) << count << " ops " << std::setw(9) << result.seconds << " s  p50 "
+              << result.p50Us << " us  p99 " << result.p99Us << " us\n";
+}
+
+// Function writeResults writes the settings and results as JSON
+//------------------------------------------------------------
+static void writeResults(std::ostream& out, const BenchOptions& options, long sailings)
+{
+    out << std::fixed << std::setprecision(3)
+        << "{\n  \"benchmark\": \"reservations\",\n"
+        << "  \"scale\": " << options.scale << ",\n"
+        << "  \"sailings\": " << sailings << ",\n"
+        << "  \"vessels\": " << BENCHVESSELS << ",\n"
+        << "  \"durability\": \"" << options.durability << "\",\n"
+        << "  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult& r = results[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"name\": \"" << r.name << "\", \"count\": " << r.count
+            << ", \"seconds\": " << r.seconds
+            << ", \"opsPerSecond\": " << (r.seconds > 0 ? r.count / r.seconds : 0)
+            << ", \"p50Us\": " << r.p50Us << ", \"p99Us\": " << r.p99Us
+            << ", \"maxUs\": " << r.maxUs << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+//============================================================
+// Function runBenchmark books options.scale vehicles on fresh data
+// files and times each operation
+// Throws an exception if an operation fails
+//------------------------------------------------------------
+static long runBenchmark(const BenchOptions& options)
+{
+    long sailings = (options.scale + options.perSailing - 1) / options.perSailing;
+    std::vector<std::array<char, SAILINGIDSIZE>> sailingIDs(sailings);
+    for (long s = 0; s < sailings; ++s)
+    {
+        makeSailingID(s, sailingIDs[s].data());
+    }
+
+    for (int v = 0; v < BENCHVESSELS; ++v)
+    {
+        std::string lane = std::to_string(options.perSailing * BENCHLANEMETERS);
+        request("VESSEL Bench" + std::to_string(v) + " " + lane + " " + lane);
+    }
+    measure("createSailing", sailings, [&](long i)
+    {
+        request(std::string("SAILING ") + sailingIDs[i].data() + " Bench" + std::to_string(i % BENCHVESSELS));
+    });
+    measure("createReservation", options.scale, [&](long i)
+    {
+        char line[96];
+        char licence[sizeof(Reservation::vehicleLicence)];
+        makeLicence(i, licence);
+        std::snprintf(line, sizeof(line), "CREATE %s %s 604555%04ld %ld 2", sailingIDs[i % sailings].data(),
+                      licence, i % 10000, 5 + i % 3);
+        request(line);
+    });
+    measure("viewReservations", options.scale, [&](long i)
+    {
+        viewReservations(sailingIDs[i % sailings].data());
+    });
+    measure("checkIn", options.scale, [&](long i)
+    {
+        char licence[sizeof(Reservation::vehicleLicence)];
+        makeLicence(i, licence);
+        request(std::string("CHECKIN ") + sailingIDs[i % sailings].data() + " " + licence);
+    });
+    measure("updateSailing", options.scale, [&](long i)
+    {
+        updateSailing(sailingIDs[i % sailings].data(), 1);
+    });
+    measure("deleteReservation", options.scale / 2, [&](long i)
+    {
+        char licence[sizeof(Reservation::vehicleLicence)];
+        makeLicence(i, licence);
+        deleteReservations(sailingIDs[i % sailings].data(), licence);
+    });
+    measure("deleteReservations", sailings, [&](long i)
+    {
+        deleteReservations(sailingIDs[i].data());
+    });
+    return sailings;
+}
+
+//============================================================
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    try
+    {
+        options = parseOptions(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n'
+                  << "Usage: benchReservations [--scale=<n>[k|M]] [--per-sailing=<n>]\n"
+                  << "       [--durability=sync|group|async] [--dir=<path>] [--output=<file>]\n";
+        return 1;
+    }
+
+    // Results go to a file or standard output; the modules' messages go nowhere
+    std::ofstream file;
+    if (!options.output.empty())
+    {
+        file.open(options.output);
+        if (!file)
+        {
+            std::cerr << "Cannot open " << options.output << '\n';
+            return 1;
+        }
+    }
+    NullBuffer discard;
+    std::streambuf* console = std::cout.rdbuf(&discard);
+    long sailings = 0;
+    int status = 0;
+    try
+    {
+        // Start from empty data files, kept apart from a real system's
+        std::filesystem::create_directories(options.dir);
+        std::filesystem::current_path(options.dir);
+        for (const char* name : DATAFILES)
+        {
+            std::filesystem::remove(name);
+        }
+        walOpen(DATAFILES[0], walParseDurability(options.durability), 10);
+        vehicleOpen();
+        vesselOpen();
+        reservationOpen();
+        sailingOpen();
+        sailings = runBenchmark(options);
+        walClose();
+        vehicleClose();
+        vesselClose();
+        reservationClose();
+        sailingClose();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        status = 1;
+    }
+    std::cout.rdbuf(console);
+    if (status == 0)
+    {
+        writeResults(file.is_open() ? static_cast<std::ostream&>(file) : std::cout, options, sailings);
+    }
+    return status;
+}
@@ -0,0 +1,685 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: benchStorage.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Microbenchmark of the ways a data file of fixed-length
+* records can be read and written. The same workloads run against
+* each storage backend over files of Reservation, Sailing, Vehicle and
+* Vessel records:
+*   append        the file is built one record at a time
+*   scan          every record read in order
+*   pointRead     records read at random slots
+*   update        records overwritten in place at random slots
+*   swapDelete    a random record replaced by the last, file cut by one
+* Backends:
+*   fstream       std::fstream seek and read / write per record
+*   pread         one pread / pwrite system call per record
+*   mmap          the MappedFile module, records copied to and from memory
+*   blocks        pread / pwrite of whole BLOCKSIZE blocks through a
+*                 small write-back cache
+* For each run it reports records per second, the read and write
+* system calls made, the bytes they moved and the page faults taken,
+* as a table on std::cerr and as JSON.
+*
+* Usage: benchStorage [--records=<n>[k|M]] [--dir=<path>] [--output=<file>]
+*
+* Design Issues: System calls and bytes are the kernel's counts for
+* the process from /proc/self/io: every read and write family call,
+* but not seeks, truncation or mapping. Pages of a mapping are moved
+* by page faults instead, so those are reported too
+* Files are not synced; the runs measure the path to the page cache
+* Not available on Windows
+*/
+//============================================================
+
+#include "mappedFile.hpp"
+#include "reservation.hpp"
+#include "sailing.hpp"
+#include "vehicle.hpp"
+#include "vessel.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <sys/resource.h>
+  #include <unistd.h>
+#endif
+
+//============================================================
+// Struct: StorageCounters
+// Purpose: Kernel counts of the process's I/O at one moment
+//------------------------------------------------------------
+struct StorageCounters
+{
+    uint64_t syscalls = 0;   // read and write family system calls
+    uint64_t bytes = 0;      // bytes those calls moved
+    uint64_t pageFaults = 0; // minor and major page faults
+    uint64_t countBytes = 0; // bytes read from /proc/self/io to take these counts
+};
+
+// Struct: StorageResult
+// Purpose: Outcome of one workload on one backend and record type
+//------------------------------------------------------------
+struct StorageResult
+{
+    std::string record;
+    std::string backend;
+    std::string workload;
+    long records = 0;
+    double seconds = 0;
+    StorageCounters used;
+};
+
+//============================================================
+// Class: StorageBackend
+// Purpose: One way of reading and writing the records of a file.
+// Slots are numbered from 0; writing slot count() appends
+//------------------------------------------------------------
+class StorageBackend
+{
+public:
+    virtual ~StorageBackend() = default;
+    virtual const char* name() const = 0;
+    // Function create opens fileName as a new, empty file of records of size bytes
+    virtual void create(const std::string& fileName, std::size_t size) = 0;
+    virtual void read(long slot, void* record) = 0;
+    virtual void write(long slot, const void* record) = 0;
+    // Function truncate cuts the file down to count records
+    virtual void truncate(long count) = 0;
+    // Function flush hands every change made so far to the kernel
+    virtual void flush() = 0;
+    virtual void close() = 0;
+};
+
+//============================================================
+// Module scope static variables
+//------------------------------------------------------------
+static const long STORAGEMAXRECORDS = 10000000; // largest file, in records
+static const std::size_t BLOCKSIZE = 64 * 1024; // bytes per block of the blocks backend
+static const std::size_t CACHEBLOCKS = 64;      // blocks the blocks backend keeps in memory
+static const unsigned RANDOMSEED = 276;         // same slots for every backend
+static std::vector<StorageResult> results;
+
+//============================================================
+// Function throwError throws an exception naming the failed call
+//------------------------------------------------------------
+static void throwError(const std::string& what)
+{
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+#ifndef _WIN32
+//============================================================
+// Class: FstreamBackend
+// Purpose: Seek and read or write one record at a time, the way the
+// data files were first accessed; the stream's own buffer is kept
+//------------------------------------------------------------
+class FstreamBackend : public StorageBackend
+{
+public:
+    const char* name() const override
+    {
+        return "fstream";
+    }
+    void create(const std::string& fileName, std::size_t size) override
+    {
+        this->fileName = fileName;
+        recordSize = size;
+        file.open(fileName, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            throw std::runtime_error("Cannot create " + fileName);
+        }
+        position = -1;
+    }
+    void read(long slot, void* record) override
+    {
+        // Reads in order carry on from where the last one stopped
+        if (position != slot)
+        {
+            file.seekg(static_cast<std::streamoff>(slot * recordSize));
+        }
+        if (!file.read(static_cast<char*>(record), static_cast<std::streamsize>(recordSize)))
+        {
+            throw std::runtime_error("Error reading from " + fileName);
+        }
+        position = slot + 1;
+    }
+    void write(long slot, const void* record) override
+    {
+        file.seekp(static_cast<std::streamoff>(slot * recordSize));
+        if (!file.write(static_cast<const char*>(record), static_cast<std::streamsize>(recordSize)))
+        {
+            throw std::runtime_error("Error writing to " + fileName);
+        }
+        position = -1;
+    }
+    void truncate(long count) override
+    {
+        file.flush();
+        std::filesystem::resize_file(fileName, static_cast<std::uintmax_t>(count * recordSize));
+        position = -1;
+    }
+    void flush() override
+    {
+        file.flush();
+    }
+    void close() override
+    {
+        file.close();
+    }
+
+private:
+    std::string fileName;
+    std::fstream file;
+    std::size_t recordSize = 0;
+    long position = -1; // slot the get position is at, -1 if unknown
+};
+
+// Class: PreadBackend
+// Purpose: One positioned system call per record, no buffering
+//------------------------------------------------------------
+class PreadBackend : public StorageBackend
+{
+public:
+    const char* name() const override
+    {
+        return "pread";
+    }
+    void create(const std::string& fileName, std::size_t size) override
+    {
+        fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            throwError("Cannot create " + fileName);
+        }
+        recordSize = size;
+    }
+    void read(long slot, void* record) override
+    {
+        if (pread(fd, record, recordSize, static_cast<off_t>(slot * recordSize)) != static_cast<ssize_t>(recordSize))
+        {
+            throwError("pread");
+        }
+    }
+    void write(long slot, const void* record) override
+    {
+        if (pwrite(fd, record, recordSize, static_cast<off_t>(slot * recordSize)) != static_cast<ssize_t>(recordSize))
+        {
+            throwError("pwrite");
+        }
+    }
+    void truncate(long count) override
+    {
+        if (ftruncate(fd, static_cast<off_t>(count * recordSize)) != 0)
+        {
+            throwError("ftruncate");
+        }
+    }
+    void flush() override
+    {
+    }
+    void close() override
+    {
+        ::close(fd);
+        fd = -1;
+    }
+
+private:
+    int fd = -1;
+    std::size_t recordSize = 0;
+};
+
+// Class: MmapBackend
+// Purpose: Records copied to and from a mapping of the MappedFile
+// module, grown in chunks as the data files grow
+//------------------------------------------------------------
+class MmapBackend : public StorageBackend
+{
+public:
+    const char* name() const override
+    {
+        return "mmap";
+    }
+    void create(const std::string& fileName, std::size_t size) override
+    {
+        std::filesystem::remove(fileName);
+        mappedOpen(file, fileName);
+        recordSize = size;
+    }
+    void read(long slot, void* record) override
+    {
+        std::memcpy(record, file.base + slot * recordSize, recordSize);
+    }
+    void write(long slot, const void* record) override
+    {
+        std::size_t end = (slot + 1) * recordSize;
+        if (end > file.size)
+        {
+            mappedResize(file, end);
+        }
+        std::memcpy(file.base + slot * recordSize, record, recordSize);
+    }
+    void truncate(long count) override
+    {
+        mappedResize(file, count * recordSize);
+    }
+    void flush() override
+    {
+    }
+    void close() override
+    {
+        mappedClose(file);
+    }
+
+private:
+    MappedFile file;
+    std::size_t recordSize = 0;
+};
+
+// Class: BlockBackend
+// Purpose: Whole blocks read and written with pread / pwrite through
+// a direct-mapped cache of CACHEBLOCKS blocks; changed blocks are
+// written back when evicted or flushed
+//------------------------------------------------------------
+class BlockBackend : public StorageBackend
+{
+public:
+    const char* name() const override
+    {
+        return "blocks";
+    }
+    void create(const std::string& fileName, std::size_t size) override
+    {
+        fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            throwError("Cannot create " + fileName);
+        }
+        recordSize = size;
+        fileSize = 0;
+        cache.assign(CACHEBLOCKS, CachedBlock());
+    }
+    void read(long slot, void* record) override
+    {
+        copy(slot * recordSize, static_cast<char*>(record), false);
+    }
+    void write(long slot, const void* record) override
+    {
+        copy(slot * recordSize, const_cast<char*>(static_cast<const char*>(record)), true);
+        fileSize = std::max(fileSize, (slot + 1) * recordSize);
+    }
+    void truncate(long count) override
+    {
+        fileSize = count * recordSize;
+    }
+    void flush() override
+    {
+        for (CachedBlock& block : cache)
+        {
+            writeBack(block);
+        }
+        if (ftruncate(fd, static_cast<off_t>(fileSize)) != 0)
+        {
+            throwError("ftruncate");
+        }
+    }
+    void close() override
+    {
+        flush();
+        ::close(fd);
+        fd = -1;
+        cache.clear();
+    }
+
+private:
+    struct CachedBlock
+    {
+        long number = -1; // block held, -1 if none
+        bool dirty = false;
+        std::vector<char> data;
+    };
+
+    // Function load returns the cache entry holding block number,
+    // reading it in, and writing back the block it replaces, if needed
+    CachedBlock& load(long number)
+    {
+        CachedBlock& block = cache[number % CACHEBLOCKS];
+        if (block.number == number)
+        {
+            return block;
+        }
+        writeBack(block);
+        block.data.assign(BLOCKSIZE, 0);
+        std::size_t start = number * BLOCKSIZE;
+        if (start < fileSize && pread(fd, block.data.data(), BLOCKSIZE, static_cast<off_t>(start)) < 0)
+        {
+            throwError("pread");
+        }
+        block.number = number;
+        return block;
+    }
+
+    // Function writeBack writes a changed block, up to the end of the file
+    void writeBack(CachedBlock& block)
+    {
+        std::size_t start = block.number * BLOCKSIZE;
+        if (block.number >= 0 && block.dirty && start < fileSize)
+        {
+            std::size_t length = std::min(BLOCKSIZE, fileSize - start);
+            if (pwrite(fd, block.data.data(), length, static_cast<off_t>(start)) != static_cast<ssize_t>(length))
+            {
+                throwError("pwrite");
+            }
+        }
+        block.dirty = false;
+    }
+
+    // Function copy moves one record between the cache and record,
+    // which may straddle two blocks
+    void copy(std::size_t offset, char* record, bool toCache)
+    {
+        std::size_t done = 0;
+        while (done < recordSize)
+        {
+            CachedBlock& block = load(static_cast<long>((offset + done) / BLOCKSIZE));
+            std::size_t within = (offset + done) % BLOCKSIZE;
+            std::size_t length = std::min(recordSize - done, BLOCKSIZE - within);
+            if (toCache)
+            {
+                std::memcpy(block.data.data() + within, record + done, length);
+                block.dirty = true;
+            }
+            else
+            {
+                std::memcpy(record + done, block.data.data() + within, length);
+            }
+            done += length;
+        }
+    }
+
+    int fd = -1;
+    std::size_t recordSize = 0;
+    std::size_t fileSize = 0; // bytes of records, including ones only in the cache
+    std::vector<CachedBlock> cache;
+};
+
+//============================================================
+// Function readCounters reads the process's I/O counts from the kernel
+//------------------------------------------------------------
+static StorageCounters readCounters()
+{
+    // One read of the whole file, so taking the counts costs a known amount
+    StorageCounters counters;
+    char text[1024];
+    ssize_t length = -1;
+    int fd = ::open("/proc/self/io", O_RDONLY);
+    if (fd >= 0)
+    {
+        length = ::read(fd, text, sizeof(text) - 1);
+        ::close(fd);
+    }
+    counters.countBytes = length > 0 ? static_cast<uint64_t>(length) : 0;
+    std::istringstream io(std::string(text, counters.countBytes));
+    std::string key;
+    uint64_t value;
+    while (io >> key >> value)
+    {
+        if (key == "syscr:" || key == "syscw:")
+        {
+            counters.syscalls += value;
+        }
+        else if (key == "rchar:" || key == "wchar:")
+        {
+            counters.bytes += value;
+        }
+    }
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    counters.pageFaults = static_cast<uint64_t>(usage.ru_minflt + usage.ru_majflt);
+    return counters;
+}
+
+// Function measure runs work on a backend, which is flushed at the
+// end, and records its time and I/O under the given names
+//------------------------------------------------------------
+template <typename Work>
+static void measure(const char* record, StorageBackend& backend, const char* workload, long count, Work work)
+{
+    StorageCounters before = readCounters();
+    auto start = std::chrono::steady_clock::now();
+    work();
+    backend.flush();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    StorageCounters after = readCounters();
+
+    StorageResult result;
+    result.record = record;
+    result.backend = backend.name();
+    result.workload = workload;
+    result.records = count;
+    result.seconds = seconds;
+    // The read that took the first counts is only counted in the second
+    result.used.syscalls = after.syscalls - before.syscalls - (before.countBytes > 0 ? 1 : 0);
+    result.used.bytes = after.bytes - before.bytes - before.countBytes;
+    result.used.pageFaults = after.pageFaults - before.pageFaults;
+    results.push_back(result);
+    std::cerr << std::left << std::setw(12) << record << std::setw(9) << result.backend << std::setw(11) << workload
+              << std::right << std::fixed << std::setprecision(0) << std::setw(13)
+              << (seconds > 0 ? count / seconds : 0) << " rec/s" << std::setw(10) << result.used.syscalls
+              << " calls" << std::setw(12) << result.used.bytes << " bytes" << std::setw(8)
+              << result.used.pageFaults << " faults\n";
+}
+
+// Function runWorkloads runs every workload on a new file of count
+// records of type T through backend
+//------------------------------------------------------------
+template <typename T>
+static void runWorkloads(const char* record, StorageBackend& backend, long count, const std::string& dir)
+{
+    std::vector<long> slots(count); // random slots, the same for every backend
+    std::mt19937_64 random(RANDOMSEED);
+    for (long& slot : slots)
+    {
+        slot = static_cast<long>(random() % static_cast<uint64_t>(count));
+    }
+    auto make = [](long i)
+    {
+        T r{};
+        std::memcpy(&r, &i, std::min(sizeof(i), sizeof(T)));
+        return r;
+    };
+    T r;
+    volatile long checksum = 0; // keeps the reads from being optimized away
+
+    backend.create(dir + "/" + record + "-" + backend.name() + ".dat", sizeof(T));
+    measure(record, backend, "append", count, [&]
+    {
+        for (long i = 0; i < count; ++i)
+        {
+            r = make(i);
+            backend.write(i, &r);
+        }
+    });
+    measure(record, backend, "scan", count, [&]
+    {
+        for (long i = 0; i < count; ++i)
+        {
+            backend.read(i, &r);
+            checksum = checksum + reinterpret_cast<const unsigned char*>(&r)[0];
+        }
+    });
+    measure(record, backend, "pointRead", count, [&]
+    {
+        for (long slot : slots)
+        {
+            backend.read(slot, &r);
+            checksum = checksum + reinterpret_cast<const unsigned char*>(&r)[0];
+        }
+    });
+    measure(record, backend, "update", count, [&]
+    {
+        for (long i = 0; i < count; ++i)
+        {
+            r = make(i);
+            backend.write(slots[i], &r);
+        }
+    });
+    measure(record, backend, "swapDelete", count / 2, [&]
+    {
+        for (long last = count - 1; last >= count - count / 2; --last)
+        {
+            backend.read(last, &r);
+            backend.write(slots[last] % last, &r);
+            backend.truncate(last);
+        }
+    });
+    backend.close();
+}
+#endif
+
+//============================================================
+// Function writeResults writes the results as JSON
+//------------------------------------------------------------
+static void writeResults(std::ostream& out, long count)
+{
+    out << std::fixed << std::setprecision(3)
+        << "{\n  \"benchmark\": \"storage\",\n"
+        << "  \"records\": " << count << ",\n"
+        << "  \"blockSize\": " << BLOCKSIZE << ",\n"
+        << "  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const StorageResult& r = results[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"record\": \"" << r.record << "\", \"backend\": \"" << r.backend
+            << "\", \"workload\": \"" << r.workload << "\", \"records\": " << r.records
+            << ", \"seconds\": " << r.seconds
+            << ", \"recordsPerSecond\": " << (r.seconds > 0 ? r.records / r.seconds : 0)
+            << ", \"syscalls\": " << r.used.syscalls << ", \"bytes\": " << r.used.bytes
+            << ", \"pageFaults\": " << r.used.pageFaults << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+// Function parseCount reads a positive count with an optional k
+// (thousand) or M (million) suffix
+// Throws an exception if the text is not such a count
+//------------------------------------------------------------
+static long parseCount(const std::string& text)
+{
+    std::size_t used = 0;
+    long value = std::stol(text, &used);
+    if (used + 1 == text.size() && (text.back() == 'k' || text.back() == 'K'))
+    {
+        value *= 1000;
+    }
+    else if (used + 1 == text.size() && text.back() == 'M')
+    {
+        value *= 1000000;
+    }
+    else if (used != text.size())
+    {
+        throw std::runtime_error("Invalid count " + text);
+    }
+    if (value < 2 || value > STORAGEMAXRECORDS)
+    {
+        throw std::runtime_error("Count " + text + " is out of range");
+    }
+    return value;
+}
+
+//============================================================
+int main(int argc, char* argv[])
+{
+    long count = 100000;
+    std::string dir = "bench-data";
+    std::string output;
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg.rfind("--records=", 0) == 0)
+            {
+                count = parseCount(arg.substr(10));
+            }
+            else if (arg.rfind("--dir=", 0) == 0)
+            {
+                dir = arg.substr(6);
+            }
+            else if (arg.rfind("--output=", 0) == 0)
+            {
+                output = arg.substr(9);
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument " + arg);
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n'
+                  << "Usage: benchStorage [--records=<n>[k|M]] [--dir=<path>] [--output=<file>]\n";
+        return 1;
+    }
+#ifdef _WIN32
+    std::cerr << "The storage benchmark is not supported on Windows.\n";
+    return 1;
+#else
+    try
+    {
+        std::filesystem::create_directories(dir);
+        FstreamBackend fstreamBackend;
+        PreadBackend preadBackend;
+        MmapBackend mmapBackend;
+        BlockBackend blockBackend;
+        StorageBackend* backends[] = {&fstreamBackend, &preadBackend, &mmapBackend, &blockBackend};
+        for (StorageBackend* backend : backends)
+        {
+            runWorkloads<Reservation>("reservation", *backend, count, dir);
+            runWorkloads<Sailing>("sailing", *backend, count, dir);
+            runWorkloads<Vehicle>("vehicle", *backend, count, dir);
+            runWorkloads<Vessel>("vessel", *backend, count, dir);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    if (output.empty())
+    {
+        writeResults(std::cout, count);
+    }
+    else
+    {
+        std::ofstream file(output);
+        writeResults(file, count);
+        if (!file)
+        {
+            std::cerr << "Cannot write " << output << '\n';
+            return 1;
+        }
+    }
+    return 0;
+#endif
+}
@@ -0,0 +1,107 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: bloomFilter.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation file of the BloomFilter module of the
+* Ferry Reservation System. A key is hashed once with 64-bit FNV-1a;
+* the two halves of the hash generate all probe positions
+* (double hashing), so adding or testing a key is one pass over it.
+*
+* Design Issues: Filter lives in memory only and is rebuilt by the
+* owning storage module when its data file is opened
+*/
+//============================================================
+
+#include "bloomFilter.hpp"
+
+//============================================================
+// Module scope constants
+//------------------------------------------------------------
+static const int BITSPERKEY = 10; // bits of the array per expected key
+static const int PROBES = 7;      // bits set and tested per key
+static const int MINWORDS = 16;   // smallest array that is allocated
+
+//============================================================
+// Function hashKey returns the 64-bit FNV-1a hash of a null terminated key
+//------------------------------------------------------------
+static uint64_t hashKey(const char key[])
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0; key[i] != '\0'; ++i)
+    {
+        hash ^= static_cast<unsigned char>(key[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+//============================================================
+// Function bloomClear removes every key and sizes the filter
+// for expected keys
+//------------------------------------------------------------
+void bloomClear(BloomFilter& filter, int expected)
+{
+    std::size_t words = MINWORDS;
+    while (words * 64 < static_cast<std::size_t>(expected) * BITSPERKEY)
+    {
+        words *= 2;
+    }
+    filter.bits.assign(words, 0);
+    filter.capacity = static_cast<int>(words * 64 / BITSPERKEY);
+    filter.count = 0;
+}
+
+// Function bloomAdd adds a null terminated key to the filter
+//------------------------------------------------------------
+void bloomAdd(BloomFilter& filter, const char key[])
+{
+    if (filter.bits.empty())
+    {
+        bloomClear(filter, 0);
+    }
+    uint64_t hash = hashKey(key);
+    uint64_t step = (hash >> 32) | 1; // odd, so every probe differs
+    uint64_t mask = filter.bits.size() * 64 - 1;
+    for (int i = 0; i < PROBES; ++i)
+    {
+        uint64_t bit = (hash + i * step) & mask;
+        filter.bits[bit / 64] |= 1ull << (bit % 64);
+    }
+    filter.count++;
+}
+
+// Function bloomMayContain returns false if key was never added,
+// and true if it probably was
+//------------------------------------------------------------
+bool bloomMayContain(const BloomFilter& filter, const char key[])
+{
+    if (filter.bits.empty())
+    {
+        return false;
+    }
+    uint64_t hash = hashKey(key);
+    uint64_t step = (hash >> 32) | 1;
+    uint64_t mask = filter.bits.size() * 64 - 1;
+    for (int i = 0; i < PROBES; ++i)
+    {
+        uint64_t bit = (hash + i * step) & mask;
+        if ((filter.bits[bit / 64] & (1ull << (bit % 64))) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function bloomIsFull returns true once the filter holds more keys
+// than it was sized for and should be rebuilt larger
+//------------------------------------------------------------
+bool bloomIsFull(const BloomFilter& filter)
+{
+    return filter.count > filter.capacity;
+}
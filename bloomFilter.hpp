@@ -0,0 +1,53 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: bloomFilter.hpp
+*
+* Description: Header file of the BloomFilter module of the Ferry
+* Reservation System. A Bloom filter answers "is this key possibly
+* stored?" from a small bit array in memory. A "no" is always right,
+* so a storage module can reject most lookups of unknown keys
+* without touching its index or data file; a "yes" still has to be
+* confirmed with the real index.
+*
+* Design Issues: Keys cannot be removed, so the filter suits data
+* that is only ever added to, or is rebuilt after deletions
+* About 10 bits per key and 7 probes give a false positive rate
+* under 1% while the filter holds no more than its expected keys
+*/
+//============================================================
+#pragma once
+#include <cstdint>
+#include <vector>
+
+//============================================================
+// Struct: BloomFilter
+// Purpose: Bit array sized for an expected number of keys
+//------------------------------------------------------------
+struct BloomFilter
+{
+    std::vector<uint64_t> bits; // bit array, size is a power of two words
+    int capacity = 0;           // keys the filter was sized for
+    int count = 0;              // keys added since the last clear
+};
+
+//============================================================
+// Function bloomClear removes every key and sizes the filter
+// for expected keys
+//------------------------------------------------------------
+void bloomClear(BloomFilter& filter, int expected);
+
+// Function bloomAdd adds a null terminated key to the filter
+//------------------------------------------------------------
+void bloomAdd(BloomFilter& filter, const char key[]);
+
+// Function bloomMayContain returns false if key was never added,
+// and true if it probably was
+//------------------------------------------------------------
+bool bloomMayContain(const BloomFilter& filter, const char key[]);
+
+// Function bloomIsFull returns true once the filter holds more keys
+// than it was sized for and should be rebuilt larger
+//------------------------------------------------------------
+bool bloomIsFull(const BloomFilter& filter);
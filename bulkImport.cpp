@@ -0,0 +1,518 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: bulkImport.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation file of the BulkImport module of the
+* Ferry Reservation System. A file is read into memory and cut into
+* one piece per thread at line ends; each thread parses and checks
+* the lines of its piece. The records are then checked against the
+* stored ones in file order and written with one append per file.
+*
+* Design Issues: Only the parsing runs on several threads; the storage
+* modules are used from the calling thread alone
+* The records of a file are committed to the write-ahead log together
+* Space for the imported reservations is taken with reserveSailingSpace
+* in file order, and given back if they cannot be written
+*/
+//============================================================
+
+#include "bulkImport.hpp"
+#include "reservation.hpp"
+#include "sailing.hpp"
+#include "vehicle.hpp"
+#include "vessel.hpp"
+#include "writeAheadLog.hpp"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+//============================================================
+// Template: ImportParser
+// Purpose: Turns the fields of one line into a record, or returns
+// false and says what is wrong with them
+//------------------------------------------------------------
+template <typename T>
+using ImportParser = bool (*)(const std::string_view fields[], int count, T& record, std::string& problem);
+
+// Struct: ImportChunk
+// Purpose: The lines one thread parses, and what it made of them
+//------------------------------------------------------------
+template <typename T>
+struct ImportChunk
+{
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    int lineCount = 0;        // every line, including skipped ones
+    int lines = 0;            // data lines
+    int invalid = 0;          // data lines that did not parse
+    std::vector<T> records;   // parsed records
+    std::vector<int> recordLines; // line of each record, counted from the chunk
+    std::vector<std::pair<int, std::string>> problems; // first invalid lines
+};
+
+// Struct: ImportFile
+// Purpose: The parsed records of a file, in file order
+//------------------------------------------------------------
+template <typename T>
+struct ImportFile
+{
+    std::string fileName;
+    std::vector<T> records;
+    std::vector<int> lines;   // line number of each record
+    ImportResult result;
+    int reported = 0;         // problems written to std::cerr
+};
+
+//============================================================
+// Module scope static variables
+//------------------------------------------------------------
+static const int IMPORTMAXFIELDS = 4;         // most fields on a line of any file
+static const int IMPORTMAXPROBLEMS = 10;      // problems reported per file; the rest are only counted
+static const std::size_t IMPORTMINCHUNK = 1 << 20; // smallest piece of a file given to a thread
+static const std::size_t PLATEMAX = sizeof(Reservation::vehicleLicence) - 1; // longest licence plate
+
+//============================================================
+// Function reportProblem writes the line and reason of one of the
+// first IMPORTMAXPROBLEMS problems of a file to std::cerr
+//------------------------------------------------------------
+template <typename T>
+static void reportProblem(ImportFile<T>& file, int line, const std::string& problem)
+{
+    if (file.reported++ < IMPORTMAXPROBLEMS)
+    {
+        std::cerr << file.fileName << ':' << line << ": " << problem << '\n';
+    }
+}
+
+// Function trim returns text without its leading and trailing blanks
+//------------------------------------------------------------
+static std::string_view trim(std::string_view text)
+{
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+    {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r'))
+    {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// Function splitFields cuts line at its commas into fields
+// Returns the number of fields, or IMPORTMAXFIELDS + 1 if there are more
+//------------------------------------------------------------
+static int splitFields(std::string_view line, std::string_view fields[])
+{
+    int count = 0;
+    while (true)
+    {
+        std::size_t comma = line.find(',');
+        if (count == IMPORTMAXFIELDS)
+        {
+            return count + 1;
+        }
+        fields[count++] = trim(line.substr(0, comma));
+        if (comma == std::string_view::npos)
+        {
+            return count;
+        }
+        line.remove_prefix(comma + 1);
+    }
+}
+
+// Function sameWord compares two words, ignoring case
+//------------------------------------------------------------
+static bool sameWord(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y)
+                      { return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y)); });
+}
+
+// Function copyField copies a non-empty field that fits in size
+// characters, including the terminator, into field
+//------------------------------------------------------------
+static bool copyField(std::string_view text, char field[], std::size_t size, const char what[], std::string& problem)
+{
+    if (text.empty() || text.size() >= size)
+    {
+        problem = std::string("invalid ") + what + " '" + std::string(text) + "'";
+        return false;
+    }
+    std::memcpy(field, text.data(), text.size());
+    field[text.size()] = '\0';
+    return true;
+}
+
+// Function parsePlate copies a licence plate of letters and digits
+//------------------------------------------------------------
+static bool parsePlate(std::string_view text, char field[], std::string& problem)
+{
+    bool plain = std::all_of(text.begin(), text.end(), [](char c)
+                             { return std::isalnum(static_cast<unsigned char>(c)) != 0; });
+    if (!plain || text.size() > PLATEMAX)
+    {
+        problem = "invalid licence plate '" + std::string(text) + "'";
+        return false;
+    }
+    return copyField(text, field, PLATEMAX + 1, "licence plate", problem);
+}
+
+// Function parseSailingID reads a ttt-dd-hh sailing ID into key
+//------------------------------------------------------------
+static bool parseSailingID(std::string_view text, SailingKey& key, std::string& problem)
+{
+    char sailingID[SAILINGIDSIZE];
+    if (text.size() != SAILINGIDSIZE - 1 ||
+        !copyField(text, sailingID, sizeof(sailingID), "sailing ID", problem) ||
+        !sailingKeyParse(sailingID, key))
+    {
+        problem = "invalid sailing ID '" + std::string(text) + "'";
+        return false;
+    }
+    return true;
+}
+
+// Function parseLength reads a length in meters, which must be positive
+//------------------------------------------------------------
+static bool parseLength(std::string_view text, const char what[], float& value, std::string& problem)
+{
+    std::from_chars_result parsed = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (parsed.ec != std::errc() || parsed.ptr != text.data() + text.size() || !(value > 0))
+    {
+        problem = std::string("invalid ") + what + " '" + std::string(text) + "'";
+        return false;
+    }
+    return true;
+}
+
+// Function checkFieldCount says how many fields a line must have
+//------------------------------------------------------------
+static bool checkFieldCount(int count, int expected, std::string& problem)
+{
+    if (count != expected)
+    {
+        problem = "expected " + std::to_string(expected) + " fields";
+        return false;
+    }
+    return true;
+}
+
+//============================================================
+// Function parseVehicle reads licence,phone,length,height
+//------------------------------------------------------------
+static bool parseVehicle(const std::string_view fields[], int count, Vehicle& v, std::string& problem)
+{
+    return checkFieldCount(count, 4, problem) &&
+           parsePlate(fields[0], v.vehicleLicence, problem) &&
+           copyField(fields[1], v.phone, sizeof(v.phone), "phone number", problem) &&
+           parseLength(fields[2], "length", v.vehicleLength, problem) &&
+           parseLength(fields[3], "height", v.vehicleHeight, problem);
+}
+
+// Function parseSailing reads sailing,vessel
+//------------------------------------------------------------
+static bool parseSailing(const std::string_view fields[], int count, Sailing& s, std::string& problem)
+{
+    return checkFieldCount(count, 2, problem) &&
+           parseSailingID(fields[0], s.sailingID, problem) &&
+           copyField(fields[1], s.vesselName, sizeof(s.vesselName), "vessel name", problem);
+}
+
+// Function parseReservation reads sailing,licence
+//------------------------------------------------------------
+static bool parseReservation(const std::string_view fields[], int count, Reservation& r, std::string& problem)
+{
+    r.onBoard = false;
+    r.isLRL = false;
+    return checkFieldCount(count, 2, problem) &&
+           parseSailingID(fields[0], r.sailingID, problem) &&
+           parsePlate(fields[1], r.vehicleLicence, problem);
+}
+
+//============================================================
+// Function parseChunk parses the lines of one piece of a file; in the
+// first piece, the first data line is skipped if it names the columns
+//------------------------------------------------------------
+template <typename T>
+static void parseChunk(ImportChunk<T>& chunk, bool first, const char header[], ImportParser<T> parse)
+{
+    std::string problem;
+    std::string_view fields[IMPORTMAXFIELDS + 1];
+    const char* next = chunk.begin;
+    while (next < chunk.end)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(next, '\n', chunk.end - next));
+        const char* lineEnd = newline != nullptr ? newline : chunk.end;
+        std::string_view line = trim(std::string_view(next, lineEnd - next));
+        next = lineEnd + 1;
+        int number = ++chunk.lineCount;
+
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+        int count = splitFields(line, fields);
+        bool columns = first && sameWord(fields[0], header);
+        first = false;
+        if (columns)
+        {
+            continue;
+        }
+        chunk.lines++;
+        T record{};
+        if (!parse(fields, count, record, problem))
+        {
+            chunk.invalid++;
+            if (chunk.problems.size() < static_cast<std::size_t>(IMPORTMAXPROBLEMS))
+            {
+                chunk.problems.emplace_back(number, problem);
+            }
+            continue;
+        }
+        chunk.records.push_back(record);
+        chunk.recordLines.push_back(number);
+    }
+}
+
+// Function parseFile reads file.fileName and parses it on up to
+// threads threads, one piece of at least IMPORTMINCHUNK bytes each
+// Throws an exception if the file cannot be read
+//------------------------------------------------------------
+template <typename T>
+static void parseFile(ImportFile<T>& file, int threads, const char header[], ImportParser<T> parse)
+{
+    std::ifstream in(file.fileName, std::ios::binary | std::ios::ate);
+    if (!in)
+    {
+        throw std::runtime_error("Cannot open " + file.fileName);
+    }
+    std::string data(static_cast<std::size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    if (!in.read(&data[0], static_cast<std::streamsize>(data.size())))
+    {
+        throw std::runtime_error("Cannot read " + file.fileName);
+    }
+
+    // Cut the file at the first line end after each even share
+    std::size_t pieces = std::max<std::size_t>(1, std::min<std::size_t>(threads, data.size() / IMPORTMINCHUNK));
+    std::vector<ImportChunk<T>> chunks(pieces);
+    const char* start = data.data();
+    const char* finish = data.data() + data.size();
+    for (std::size_t c = 0; c < pieces; ++c)
+    {
+        const char* end = finish;
+        const char* share = data.data() + data.size() * (c + 1) / pieces;
+        if (c + 1 < pieces && share > start)
+        {
+            const char* newline = static_cast<const char*>(std::memchr(share, '\n', finish - share));
+            end = newline != nullptr ? newline + 1 : finish;
+        }
+        else if (c + 1 < pieces)
+        {
+            end = start;
+        }
+        chunks[c].begin = start;
+        chunks[c].end = end;
+        start = end;
+    }
+    std::vector<std::thread> workers;
+    for (std::size_t c = 1; c < pieces; ++c)
+    {
+        workers.emplace_back(parseChunk<T>, std::ref(chunks[c]), false, header, parse);
+    }
+    parseChunk<T>(chunks[0], true, header, parse);
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    // Number the lines of each piece after those of the pieces before it
+    int firstLine = 0;
+    for (ImportChunk<T>& chunk : chunks)
+    {
+        for (const auto& problem : chunk.problems)
+        {
+            reportProblem(file, firstLine + problem.first, problem.second);
+        }
+        file.result.lines += chunk.lines;
+        file.result.invalid += chunk.invalid;
+        file.records.insert(file.records.end(), chunk.records.begin(), chunk.records.end());
+        for (int line : chunk.recordLines)
+        {
+            file.lines.push_back(firstLine + line);
+        }
+        firstLine += chunk.lineCount;
+    }
+}
+
+//============================================================
+// Function importVehicles adds the vehicles listed in fileName,
+// parsing the file on the given number of threads
+// Throws an exception if the file cannot be read or written
+//------------------------------------------------------------
+ImportResult importVehicles(const std::string& fileName, int threads)
+{
+    ImportFile<Vehicle> file;
+    file.fileName = fileName;
+    parseFile<Vehicle>(file, threads, "licence", parseVehicle);
+
+    std::vector<Vehicle> fresh;
+    std::unordered_set<std::string_view> seen;
+    seen.reserve(file.records.size());
+    for (const Vehicle& v : file.records)
+    {
+        Vehicle stored;
+        if (findVehicle(v.vehicleLicence, stored) >= 0 || !seen.insert(v.vehicleLicence).second)
+        {
+            file.result.duplicates++;
+            continue;
+        }
+        fresh.push_back(v);
+    }
+    {
+        WalBatch batch;
+        writeVehicles(fresh);
+    }
+    file.result.imported = static_cast<int>(fresh.size());
+    return file.result;
+}
+
+// Function importSailings adds the sailings listed in fileName,
+// parsing the file on the given number of threads
+// Throws an exception if the file cannot be read or written
+//------------------------------------------------------------
+ImportResult importSailings(const std::string& fileName, int threads)
+{
+    ImportFile<Sailing> file;
+    file.fileName = fileName;
+    parseFile<Sailing>(file, threads, "sailing", parseSailing);
+
+    // A new sailing has all of its vessel's lane length left
+    std::unordered_map<std::string, int> vesselLengths;
+    Vessel vessel;
+    vesselReset();
+    while (getNextVessel(vessel))
+    {
+        vesselLengths[vessel.name] = static_cast<int>(vessel.HCLL + vessel.LCLL);
+    }
+    std::vector<SailingKey> stored;
+    for (const Sailing& s : *sailingSnapshot())
+    {
+        stored.push_back(s.sailingID);
+    }
+
+    std::vector<Sailing> fresh;
+    std::unordered_set<SailingKey> seen;
+    seen.reserve(file.records.size());
+    for (std::size_t i = 0; i < file.records.size(); ++i)
+    {
+        Sailing s = file.records[i];
+        auto vessel = vesselLengths.find(s.vesselName);
+        if (vessel == vesselLengths.end())
+        {
+            file.result.invalid++;
+            reportProblem(file, file.lines[i], std::string("unknown vessel '") + s.vesselName + "'");
+            continue;
+        }
+        if (std::binary_search(stored.begin(), stored.end(), s.sailingID) || !seen.insert(s.sailingID).second)
+        {
+            file.result.duplicates++;
+            continue;
+        }
+        s.lowRemainingLength = static_cast<float>(vessel->second);
+        s.highRemainingLength = 0.0f;
+        fresh.push_back(s);
+    }
+    {
+        WalBatch batch;
+        writeSailings(fresh);
+    }
+    file.result.imported = static_cast<int>(fresh.size());
+    return file.result;
+}
+
+// Function importReservations books the reservations listed in
+// fileName, parsing the file on the given number of threads
+// Throws an exception if the file cannot be read or written
+//------------------------------------------------------------
+ImportResult importReservations(const std::string& fileName, int threads)
+{
+    ImportFile<Reservation> file;
+    file.fileName = fileName;
+    parseFile<Reservation>(file, threads, "sailing", parseReservation);
+
+    std::vector<Reservation> fresh;
+    std::vector<float> lengths; // space taken for each fresh reservation
+    std::unordered_set<std::string> seen;
+    seen.reserve(file.records.size());
+    for (std::size_t i = 0; i < file.records.size(); ++i)
+    {
+        const Reservation& r = file.records[i];
+        Reservation existing;
+        std::string key(reinterpret_cast<const char*>(&r.sailingID), sizeof(r.sailingID));
+        key += r.vehicleLicence;
+        if (findReservation(r.sailingID, r.vehicleLicence, existing) >= 0 || !seen.insert(key).second)
+        {
+            file.result.duplicates++;
+            continue;
+        }
+        Vehicle v;
+        if (findVehicle(r.vehicleLicence, v) < 0)
+        {
+            file.result.invalid++;
+            reportProblem(file, file.lines[i], std::string("unknown vehicle '") + r.vehicleLicence + "'");
+            continue;
+        }
+        try
+        {
+            if (!reserveSailingSpace(r.sailingID, v.vehicleLength))
+            {
+                file.result.full++;
+                continue;
+            }
+        }
+        catch (const std::runtime_error&)
+        {
+            char sailingID[SAILINGIDSIZE];
+            sailingKeyFormat(r.sailingID, sailingID);
+            file.result.invalid++;
+            reportProblem(file, file.lines[i], std::string("unknown sailing '") + sailingID + "'");
+            continue;
+        }
+        fresh.push_back(r);
+        lengths.push_back(v.vehicleLength);
+    }
+    try
+    {
+        WalBatch batch;
+        writeReservations(fresh);
+        sailingFlushCapacity();
+    }
+    catch (const std::exception&)
+    {
+        for (std::size_t i = 0; i < fresh.size(); ++i)
+        {
+            releaseSailingSpace(fresh[i].sailingID, lengths[i]);
+        }
+        throw;
+    }
+    file.result.imported = static_cast<int>(fresh.size());
+    return file.result;
+}
@@ -0,0 +1,60 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: bulkImport.hpp
+*
+* Description: Header file of the BulkImport module of the Ferry
+* Reservation System. Loads vehicles, sailings and reservations from
+* CSV files, such as a season's schedule or a fleet customer's
+* pre-bookings, in one pass instead of one request at a time.
+*
+* Files hold one record per line, fields separated by commas:
+*   vehicles:      licence,phone,length,height
+*   sailings:      sailing,vessel         (ttt-dd-hh, an existing vessel)
+*   reservations:  sailing,licence        (an existing sailing and vehicle)
+* A first line naming the columns, blank lines and lines starting
+* with '#' are skipped. A sailing gets all of its vessel's lane length;
+* a reservation takes its vehicle's length from the sailing.
+*
+* Design Issues: Records already stored, or repeated in the file, are
+* skipped, so an import can be run again after it was interrupted
+* Invalid lines are skipped and the first few are reported on std::cerr
+* Sailings and vehicles must be imported before the reservations on them
+* The storage modules must be open and used by no other thread
+*/
+//============================================================
+#pragma once
+#include <string>
+
+//============================================================
+// Struct: ImportResult
+// Purpose: What became of the lines of an imported file
+//------------------------------------------------------------
+struct ImportResult
+{
+    int lines = 0;      // data lines, without the header, comments and blank lines
+    int imported = 0;   // records written
+    int duplicates = 0; // records already stored or earlier in the file
+    int invalid = 0;    // malformed lines, or lines naming an unknown vessel, sailing or vehicle
+    int full = 0;       // reservations turned away because the sailing was full
+};
+
+//============================================================
+// Function importVehicles adds the vehicles listed in fileName,
+// parsing the file on the given number of threads
+// Throws an exception if the file cannot be read or written
+//------------------------------------------------------------
+ImportResult importVehicles(const std::string& fileName, int threads);
+
+// Function importSailings adds the sailings listed in fileName,
+// parsing the file on the given number of threads
+// Throws an exception if the file cannot be read or written
+//------------------------------------------------------------
+ImportResult importSailings(const std::string& fileName, int threads);
+
+// Function importReservations books the reservations listed in
+// fileName, parsing the file on the given number of threads
+// Throws an exception if the file cannot be read or written
+//------------------------------------------------------------
+ImportResult importReservations(const std::string& fileName, int threads);
@@ -0,0 +1,145 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: client.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation file of the Client module of the
+* Ferry Reservation System. Requests and replies are single lines
+* of text on a Unix domain socket.
+*
+* Design Issues: Bytes read past the end of a reply are kept for
+* the next one
+*/
+//============================================================
+
+#include "client.hpp"
+#include <stdexcept>
+#ifndef _WIN32
+  #include <cerrno>
+  #include <cstring>
+  #include <sys/socket.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+//============================================================
+// Module scope static variables
+//------------------------------------------------------------
+static int clientFd = -1;       // connection to the daemon, -1 if none
+static std::string pending;     // received bytes not yet returned
+
+//============================================================
+// Function clientConnect connects to the daemon listening on socketPath
+// Throws an exception if it cannot connect
+//------------------------------------------------------------
+void clientConnect(const std::string& socketPath)
+{
+#ifdef _WIN32
+    (void)socketPath;
+    throw std::runtime_error("Connecting to the daemon is not supported on Windows.");
+#else
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        throw std::runtime_error("Socket path " + socketPath + " is too long.");
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        int error = errno;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        throw std::runtime_error("Cannot connect to " + socketPath + ": " + std::strerror(error));
+    }
+    clientFd = fd;
+    pending.clear();
+#endif
+}
+
+// Function clientIsConnected returns true between clientConnect
+// and clientClose
+//------------------------------------------------------------
+bool clientIsConnected()
+{
+    return clientFd >= 0;
+}
+
+// Function clientRequest sends one request line (see service.hpp) and
+// returns the results of the reply, without the leading "OK"
+// Throws an exception with the daemon's reason if the request failed,
+// or if the connection is lost
+//------------------------------------------------------------
+std::string clientRequest(const std::string& request)
+{
+#ifdef _WIN32
+    (void)request;
+    throw std::runtime_error("Not connected to the daemon.");
+#else
+    if (clientFd < 0)
+    {
+        throw std::runtime_error("Not connected to the daemon.");
+    }
+    std::string line = request + '\n';
+    std::size_t sent = 0;
+    while (sent < line.size())
+    {
+        ssize_t n = send(clientFd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            throw std::runtime_error("Lost the connection to the daemon.");
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+
+    std::size_t end;
+    while ((end = pending.find('\n')) == std::string::npos)
+    {
+        char buffer[512];
+        ssize_t n = read(clientFd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            throw std::runtime_error("Lost the connection to the daemon.");
+        }
+        pending.append(buffer, static_cast<std::size_t>(n));
+    }
+    std::string reply = pending.substr(0, end);
+    pending.erase(0, end + 1);
+
+    if (reply.rfind("OK", 0) == 0)
+    {
+        return reply.size() > 3 ? reply.substr(3) : "";
+    }
+    throw std::runtime_error(reply.rfind("ERR ", 0) == 0 ? reply.substr(4) : reply);
+#endif
+}
+
+// Function clientClose disconnects from the daemon
+//------------------------------------------------------------
+void clientClose()
+{
+#ifndef _WIN32
+    if (clientFd >= 0)
+    {
+        close(clientFd);
+    }
+#endif
+    clientFd = -1;
+    pending.clear();
+}
@@ -0,0 +1,40 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: client.hpp
+*
+* Description: Header file of the Client module of the Ferry
+* Reservation System. A terminal started with --connect does not
+* open the data files itself; the UI sends each operation to the
+* daemon (see daemon.hpp) through this module instead.
+*
+* Design Issues: One connection per terminal, one request in
+* flight at a time
+* Not available on Windows
+*/
+//============================================================
+#pragma once
+#include <string>
+
+//============================================================
+// Function clientConnect connects to the daemon listening on socketPath
+// Throws an exception if it cannot connect
+//------------------------------------------------------------
+void clientConnect(const std::string& socketPath);
+
+// Function clientIsConnected returns true between clientConnect
+// and clientClose
+//------------------------------------------------------------
+bool clientIsConnected();
+
+// Function clientRequest sends one request line (see service.hpp) and
+// returns the results of the reply, without the leading "OK"
+// Throws an exception with the daemon's reason if the request failed,
+// or if the connection is lost
+//------------------------------------------------------------
+std::string clientRequest(const std::string& request);
+
+// Function clientClose disconnects from the daemon
+//------------------------------------------------------------
+void clientClose();
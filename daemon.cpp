@@ -0,0 +1,408 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: daemon.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation file of the Daemon module of the
+* Ferry Reservation System. The main thread accepts connections;
+* each connection gets a thread that reads its request lines, hands
+* every request to the worker owning its sailing and writes back the
+* reply. Requests that name no sailing go to the first worker.
+*
+* Design Issues: A worker runs its requests one at a time, so a
+* connection waiting on a busy sailing does not stop the others
+* A worker does not wait for the write-ahead log: the connection
+* waits for its request's commit, so the next request on the sailing
+* runs in the meantime and one flush commits them all
+* The accept loop also writes the space booked on each sailing back
+* to the sailing file every CAPACITYFLUSHMS; what a crash loses of it
+* is worked out again from the reservations at the next start
+* The data itself stays in the storage modules, which the Service
+* module guards with a reader/writer lock; see service.hpp
+*/
+//============================================================
+
+#include "daemon.hpp"
+#include "logger.hpp"
+#include "service.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+  #include <cerrno>
+  #include <csignal>
+  #include <cstring>
+  #include <poll.h>
+  #include <sys/socket.h>
+  #include <sys/stat.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+#ifndef _WIN32
+//============================================================
+// Struct: DaemonReply
+// Purpose: Reply to a request and the log record it must wait for
+//------------------------------------------------------------
+struct DaemonReply
+{
+    std::string text;
+    uint64_t commitLsn = 0;
+};
+
+// Struct: DaemonJob
+// Purpose: One request waiting for a worker, and where its reply goes
+//------------------------------------------------------------
+struct DaemonJob
+{
+    std::string request;
+    std::promise<DaemonReply> reply;
+};
+
+// Struct: DaemonWorker
+// Purpose: Queue of requests for the sailings one thread owns
+//------------------------------------------------------------
+struct DaemonWorker
+{
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<DaemonJob> jobs;
+    bool stopping = false;
+    std::thread thread;
+};
+
+// Struct: DaemonConnection
+// Purpose: A connected terminal and the thread serving it
+//------------------------------------------------------------
+struct DaemonConnection
+{
+    int fd = -1;
+    std::atomic<bool> done{false};
+    std::thread thread;
+};
+
+//============================================================
+// Module scope static variables
+//------------------------------------------------------------
+static const int ACCEPTPOLLMS = 200;   // how often the accept loop checks for a signal
+static const int CAPACITYFLUSHMS = 200; // how often booked space is written to the sailing file
+static const int READSIZE = 4096;      // bytes read from a connection at a time
+static const uint64_t SHARDMIX = 0x9E3779B97F4A7C15ull; // spreads sailing keys over workers
+static volatile std::sig_atomic_t stopRequested = 0; // set by SIGINT / SIGTERM
+static std::vector<DaemonWorker*> workers; // one per worker thread
+
+//============================================================
+// Function onStopSignal asks the accept loop to stop
+//------------------------------------------------------------
+static void onStopSignal(int)
+{
+    stopRequested = 1;
+}
+
+// Function runWorker runs the requests queued for one worker until
+// it is stopped and its queue is empty
+//------------------------------------------------------------
+static void runWorker(DaemonWorker* worker)
+{
+    while (true)
+    {
+        DaemonJob job;
+        {
+            std::unique_lock<std::mutex> lock(worker->mutex);
+            worker->ready.wait(lock, [worker] { return worker->stopping || !worker->jobs.empty(); });
+            if (worker->jobs.empty())
+            {
+                return;
+            }
+            job = std::move(worker->jobs.front());
+            worker->jobs.pop_front();
+        }
+        // The commit is waited for by the connection, not the worker
+        DaemonReply reply;
+        reply.text = serviceApply(job.request, reply.commitLsn);
+        job.reply.set_value(std::move(reply));
+    }
+}
+
+// Function submit queues a request on the worker owning its sailing,
+// waits for it to run and returns the reply once it is committed
+//------------------------------------------------------------
+static std::string submit(const std::string& request)
+{
+    // Sailings differ mostly in their high bits; mix them before choosing
+    uint64_t key = serviceSailingKey(request);
+    DaemonWorker* worker = workers[((key * SHARDMIX) >> 32) % workers.size()];
+    DaemonJob job;
+    job.request = request;
+    std::future<DaemonReply> future = job.reply.get_future();
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->jobs.push_back(std::move(job));
+    }
+    worker->ready.notify_one();
+    DaemonReply reply = future.get();
+    return serviceCommit(reply.text, reply.commitLsn);
+}
+
+// Function writeAll sends every byte of text, returning false if the
+// terminal has gone away
+//------------------------------------------------------------
+static bool writeAll(int fd, const std::string& text)
+{
+    std::size_t sent = 0;
+    while (sent < text.size())
+    {
+        ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+// Function serveConnection answers the request lines of one terminal
+// until it disconnects or the daemon stops
+//------------------------------------------------------------
+static void serveConnection(DaemonConnection* connection)
+{
+    std::string pending;
+    char buffer[READSIZE];
+    while (true)
+    {
+        ssize_t n = read(connection->fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        pending.append(buffer, static_cast<std::size_t>(n));
+
+        // Answer every complete line; replies to one batch go out together
+        std::string replies;
+        std::size_t start = 0;
+        std::size_t end;
+        while ((end = pending.find('\n', start)) != std::string::npos)
+        {
+            std::string request = pending.substr(start, end - start);
+            if (!request.empty() && request.back() == '\r')
+            {
+                request.pop_back();
+            }
+            start = end + 1;
+            if (!request.empty())
+            {
+                replies += submit(request) + '\n';
+            }
+        }
+        pending.erase(0, start);
+        if (!replies.empty() && !writeAll(connection->fd, replies))
+        {
+            break;
+        }
+    }
+    connection->done = true;
+}
+
+// Function reapConnections joins and removes the connections whose
+// terminal has gone away
+//------------------------------------------------------------
+static void reapConnections(std::list<DaemonConnection>& connections)
+{
+    for (auto it = connections.begin(); it != connections.end();)
+    {
+        if (it->done)
+        {
+            it->thread.join();
+            close(it->fd);
+            it = connections.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+// Function removeStaleSocket removes the socket at address if no
+// daemon is listening on it any more, and leaves a path that does not
+// exist alone
+// Throws an exception if a daemon answers there or the path is not a
+// socket left behind
+//------------------------------------------------------------
+static void removeStaleSocket(const sockaddr_un& address)
+{
+    struct stat status;
+    if (lstat(address.sun_path, &status) != 0 && errno == ENOENT)
+    {
+        return;
+    }
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0)
+    {
+        throw std::runtime_error(std::string("Cannot create socket: ") + std::strerror(errno));
+    }
+    int connected = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    int error = errno;
+    close(probe);
+    if (connected == 0)
+    {
+        throw std::runtime_error(std::string("A daemon is already serving on ") + address.sun_path + ".");
+    }
+    if (error != ECONNREFUSED || !S_ISSOCK(status.st_mode))
+    {
+        throw std::runtime_error(std::string("Cannot use ") + address.sun_path + ": " +
+                                 (S_ISSOCK(status.st_mode) ? std::strerror(error) : "not a socket"));
+    }
+    // nobody listens: an earlier daemon did not shut down
+    unlink(address.sun_path);
+}
+
+// Function openSocket creates the listening socket at socketPath,
+// replacing a socket left behind by an earlier daemon, and stores the
+// device and inode of the socket file in created
+// Throws an exception if it cannot be created or a daemon is serving there
+//------------------------------------------------------------
+static int openSocket(const std::string& socketPath, struct stat& created)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        throw std::runtime_error("Socket path " + socketPath + " is too long.");
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    removeStaleSocket(address);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        throw std::runtime_error(std::string("Cannot create socket: ") + std::strerror(errno));
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        stat(socketPath.c_str(), &created) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error("Cannot listen on " + socketPath + ": " + std::strerror(error));
+    }
+    return fd;
+}
+#endif
+
+//============================================================
+// Function daemonRun serves requests on the socket at socketPath
+// with the given number of worker threads until the process gets
+// SIGINT or SIGTERM. The storage modules must be open
+// Throws an exception if the socket cannot be created or another
+// daemon is serving on it
+//------------------------------------------------------------
+void daemonRun(const std::string& socketPath, int workerCount)
+{
+#ifdef _WIN32
+    (void)socketPath;
+    (void)workerCount;
+    throw std::runtime_error("The daemon is not supported on Windows.");
+#else
+    struct stat created;
+    int listenFd = openSocket(socketPath, created);
+    std::cout << "Serving on " << socketPath << std::endl;
+    stopRequested = 0;
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+
+    for (int i = 0; i < (workerCount > 0 ? workerCount : 1); ++i)
+    {
+        DaemonWorker* worker = new DaemonWorker;
+        worker->thread = std::thread(runWorker, worker);
+        workers.push_back(worker);
+    }
+
+    std::list<DaemonConnection> connections;
+    auto lastFlush = std::chrono::steady_clock::now();
+    while (!stopRequested)
+    {
+        // Bookings only change the counters in memory; write them out in the background
+        if (std::chrono::steady_clock::now() - lastFlush >= std::chrono::milliseconds(CAPACITYFLUSHMS))
+        {
+            try
+            {
+                serviceFlushCapacity();
+            }
+            catch (const std::exception& e)
+            {
+                LOGWRITE(LOGERROR, "daemon.flushCapacity", {"error", e.what()});
+            }
+            lastFlush = std::chrono::steady_clock::now();
+        }
+        pollfd waiting{listenFd, POLLIN, 0};
+        if (poll(&waiting, 1, ACCEPTPOLLMS) <= 0)
+        {
+            continue;
+        }
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            continue;
+        }
+        reapConnections(connections);
+        connections.emplace_back();
+        DaemonConnection* connection = &connections.back();
+        connection->fd = fd;
+        connection->thread = std::thread(serveConnection, connection);
+    }
+
+    // Stop taking requests, let the ones in flight finish, then stop the workers
+    close(listenFd);
+    struct stat current;
+    if (stat(socketPath.c_str(), &current) == 0 && current.st_dev == created.st_dev &&
+        current.st_ino == created.st_ino)
+    {
+        // still ours: the path may since have been taken over by hand
+        unlink(socketPath.c_str());
+    }
+    for (DaemonConnection& connection : connections)
+    {
+        shutdown(connection.fd, SHUT_RD);
+    }
+    for (DaemonConnection& connection : connections)
+    {
+        connection.thread.join();
+        close(connection.fd);
+    }
+    for (DaemonWorker* worker : workers)
+    {
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->stopping = true;
+        }
+        worker->ready.notify_one();
+        worker->thread.join();
+        delete worker;
+    }
+    workers.clear();
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+#endif
+}
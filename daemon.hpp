@@ -0,0 +1,36 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: daemon.hpp
+*
+* Description: Header file of the Daemon module of the Ferry
+* Reservation System. The daemon keeps the storage modules open and
+* serves the requests of the Service module to any number of
+* terminals over a local (Unix domain) socket. A terminal sends one
+* request per line and reads one reply line per request, in order.
+*
+* Design Issues: Requests are handed to a fixed set of worker
+* threads by sailing, so all requests on one sailing run in the
+* order they arrived while requests on different sailings run and
+* wait for their commits side by side
+* Not available on Windows
+*/
+//============================================================
+#pragma once
+#include <string>
+
+//============================================================
+// Constants
+//------------------------------------------------------------
+const char DAEMONSOCKETNAME[] = "ferry.sock"; // default socket path
+const int DAEMONWORKERS = 4;                  // default number of worker threads
+
+//============================================================
+// Function daemonRun serves requests on the socket at socketPath
+// with the given number of worker threads until the process gets
+// SIGINT or SIGTERM. The storage modules must be open
+// Throws an exception if the socket cannot be created or another
+// daemon is serving on it
+//------------------------------------------------------------
+void daemonRun(const std::string& socketPath, int workers);
@@ -0,0 +1,256 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: exporter.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation of the Exporter module of the Ferry
+* Reservation System, see exporter.hpp.
+* Operation counts come from the Metrics module, file sizes from
+* metricsFile, remaining lengths from the sailing counters (see
+* sailingRemaining) and reservation counts from reservationCounts;
+* all of them are read without taking a lock that bookings use.
+*
+* Design Issues: A write failure is reported on std::cerr and the file
+* is tried again at the next interval
+*/
+//============================================================
+
+#include "exporter.hpp"
+#include "metrics.hpp"
+#include "reservation.hpp"
+#include "sailing.hpp"
+#include "sailingKey.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+//============================================================
+// Module scope static variables
+//------------------------------------------------------------
+static std::string exportFileName;
+static std::thread writer;                 // writes the file every interval
+static std::mutex writerMutex;
+static std::condition_variable writerCond; // wakes the writer to stop
+static bool stopping = false;              // under writerMutex
+static bool started = false;
+
+//============================================================
+// Function writeLabel writes name="value" with value escaped as the
+// text format requires
+//------------------------------------------------------------
+static void writeLabel(std::ostream& out, const char* name, const std::string& value)
+{
+    out << name << "=\"";
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out << '\\' << c;
+        }
+        else if (c == '\n')
+        {
+            out << "\\n";
+        }
+        else
+        {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+// Function writeFamily writes the HELP and TYPE lines of a metric
+//------------------------------------------------------------
+static void writeFamily(std::ostream& out, const char* name, const char* type, const char* help)
+{
+    out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+}
+
+// Function writeOperations writes one series per operation of the
+// value picked by value, labelled by module and function
+//------------------------------------------------------------
+template <typename Value>
+static void writeOperations(std::ostream& out, const std::vector<MetricsOperation*>& operations, const char* name,
+                            Value value)
+{
+    for (const MetricsOperation* op : operations)
+    {
+        std::string::size_type dot = op->name.find('.');
+        out << name << '{';
+        writeLabel(out, "module", dot == std::string::npos ? std::string() : op->name.substr(0, dot));
+        out << ',';
+        writeLabel(out, "function", dot == std::string::npos ? op->name : op->name.substr(dot + 1));
+        out << "} " << value(*op) << '\n';
+    }
+}
+
+//============================================================
+// Function exporterReport writes every counter to out in the
+// Prometheus text format
+//------------------------------------------------------------
+void exporterReport(std::ostream& out)
+{
+    std::vector<MetricsOperation*> operations = metricsOperations();
+    writeFamily(out, "ferry_operation_calls_total", "counter", "Completed calls of each operation.");
+    writeOperations(out, operations, "ferry_operation_calls_total", [](const MetricsOperation& op)
+    {
+        return metricsCalls(op);
+    });
+    writeFamily(out, "ferry_operation_errors_total", "counter", "Calls of each operation that ended in an error.");
+    writeOperations(out, operations, "ferry_operation_errors_total", [](const MetricsOperation& op)
+    {
+        return op.errors.load(std::memory_order_relaxed);
+    });
+    writeFamily(out, "ferry_operation_seconds_total", "counter", "Time spent in each operation.");
+    writeOperations(out, operations, "ferry_operation_seconds_total", [](const MetricsOperation& op)
+    {
+        return op.totalNs.load(std::memory_order_relaxed) / 1e9;
+    });
+
+    std::vector<MetricsFile*> files = metricsFiles();
+    const char* fileFamilies[3][2] = {{"ferry_file_bytes", "Size of each data file."},
+                                      {"ferry_file_records", "Live records in each data file."},
+                                      {"ferry_file_slots", "Records and tombstones in each data file."}};
+    for (int i = 0; i < 3; ++i)
+    {
+        writeFamily(out, fileFamilies[i][0], "gauge", fileFamilies[i][1]);
+        for (const MetricsFile* file : files)
+        {
+            out << fileFamilies[i][0] << '{';
+            writeLabel(out, "file", file->name);
+            out << "} ";
+            if (i == 0)
+            {
+                out << file->bytes.load(std::memory_order_relaxed);
+            }
+            else
+            {
+                out << (i == 1 ? file->records : file->slots).load(std::memory_order_relaxed);
+            }
+            out << '\n';
+        }
+    }
+
+    std::vector<Sailing> sailings;
+    sailingRemaining(sailings);
+    writeFamily(out, "ferry_sailing_low_remaining_meters", "gauge", "Low lane length left on each sailing.");
+    char sailingID[SAILINGIDSIZE];
+    for (const Sailing& s : sailings)
+    {
+        sailingKeyFormat(s.sailingID, sailingID);
+        out << "ferry_sailing_low_remaining_meters{";
+        writeLabel(out, "sailing", sailingID);
+        out << "} " << s.lowRemainingLength << '\n';
+    }
+    writeFamily(out, "ferry_sailing_high_remaining_meters", "gauge", "High lane length left on each sailing.");
+    for (const Sailing& s : sailings)
+    {
+        sailingKeyFormat(s.sailingID, sailingID);
+        out << "ferry_sailing_high_remaining_meters{";
+        writeLabel(out, "sailing", sailingID);
+        out << "} " << s.highRemainingLength << '\n';
+    }
+
+    int booked = 0;
+    int checkedIn = 0;
+    reservationCounts(booked, checkedIn);
+    writeFamily(out, "ferry_reservations", "gauge", "Reservations on all sailings.");
+    out << "ferry_reservations " << booked << '\n';
+    writeFamily(out, "ferry_reservations_checked_in", "gauge", "Reservations checked in.");
+    out << "ferry_reservations_checked_in " << checkedIn << '\n';
+}
+
+// Function exporterWrite writes the counters to fileName through a
+// temporary file renamed over it
+// Throws an exception if the file cannot be written
+//------------------------------------------------------------
+void exporterWrite(const std::string& fileName)
+{
+    std::string temporary = fileName + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        if (!out)
+        {
+            throw std::runtime_error("Cannot open " + temporary);
+        }
+        exporterReport(out);
+        out.close();
+        if (!out)
+        {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Cannot write " + temporary);
+        }
+    }
+    if (std::rename(temporary.c_str(), fileName.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Cannot rename " + temporary + " to " + fileName);
+    }
+}
+
+// Function writeReported writes the file, reporting any failure on
+// std::cerr
+//------------------------------------------------------------
+static void writeReported()
+{
+    try
+    {
+        exporterWrite(exportFileName);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "exporter: " << e.what() << '\n';
+    }
+}
+
+// Function exporterStart writes the counters to fileName now and then
+// every seconds seconds from a thread of its own
+// Must be called after the data files are opened
+//------------------------------------------------------------
+void exporterStart(const std::string& fileName, int seconds)
+{
+    exportFileName = fileName;
+    stopping = false;
+    started = true;
+    writeReported();
+    writer = std::thread([seconds]()
+    {
+        std::unique_lock<std::mutex> lock(writerMutex);
+        while (!writerCond.wait_for(lock, std::chrono::seconds(seconds), []() { return stopping; }))
+        {
+            lock.unlock();
+            writeReported();
+            lock.lock();
+        }
+    });
+}
+
+// Function exporterStop stops the thread, if exporterStart was called,
+// and writes the file a last time
+// Must be called before the data files are closed
+//------------------------------------------------------------
+void exporterStop()
+{
+    if (!started)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        stopping = true;
+    }
+    writerCond.notify_one();
+    writer.join();
+    writeReported();
+    started = false;
+}
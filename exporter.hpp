@@ -0,0 +1,62 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: exporter.hpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Header file of the Exporter module of the Ferry
+* Reservation System. Writes the system's counters as a Prometheus
+* text file, for the node exporter's textfile collector to scrape:
+* - ferry_operation_calls_total, _errors_total and _seconds_total for
+*   every instrumented operation, labelled by module and function
+* - ferry_file_bytes, ferry_file_records and ferry_file_slots for
+*   every data file
+* - ferry_sailing_low_remaining_meters and _high_remaining_meters for
+*   every sailing
+* - ferry_reservations and ferry_reservations_checked_in
+* Every value is a counter the modules keep up to date as they change,
+* so writing the file never scans a data file.
+* The file is written to <file>.tmp and renamed over <file>, so a
+* scrape never reads half a file.
+*
+* Design Issues: Operation counts need the metrics to be turned on,
+* see metricsEnable
+* In shared mode the counts are those this process has seen, and
+* there are no per-sailing lengths
+*/
+//============================================================
+#pragma once
+#include <ostream>
+#include <string>
+
+//============================================================
+// Constants
+//------------------------------------------------------------
+const int EXPORTERSECONDS = 15; // default time between writes
+
+//============================================================
+// Function exporterReport writes every counter to out in the
+// Prometheus text format
+//------------------------------------------------------------
+void exporterReport(std::ostream& out);
+
+// Function exporterWrite writes the counters to fileName through a
+// temporary file renamed over it
+// Throws an exception if the file cannot be written
+//------------------------------------------------------------
+void exporterWrite(const std::string& fileName);
+
+// Function exporterStart writes the counters to fileName now and then
+// every seconds seconds from a thread of its own
+// Must be called after the data files are opened
+//------------------------------------------------------------
+void exporterStart(const std::string& fileName, int seconds);
+
+// Function exporterStop stops the thread, if exporterStart was called,
+// and writes the file a last time
+// Must be called before the data files are closed
+//------------------------------------------------------------
+void exporterStop();
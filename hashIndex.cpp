@@ -0,0 +1,308 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: hashIndex.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation file of the HashIndex module of the
+* Ferry Reservation System. Keys are hashed with FNV-1a and stored
+* in a linear-probing table that is kept at most half full, so a
+* lookup touches one or two buckets on average.
+*
+* Design Issues: Table lives in memory; the owning storage module
+* either rebuilds it when its data file is opened or loads a copy
+* saved at the last close. A saved file is a small header followed
+* by the raw table, so loading it is one read
+*/
+//============================================================
+
+#include "hashIndex.hpp"
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+//============================================================
+// Module scope constants
+//------------------------------------------------------------
+static const int MINCAPACITY = 64; // smallest table that is allocated
+static const char INDEXMAGIC[4] = {'F', 'H', 'X', '2'}; // first bytes of a saved index
+
+//============================================================
+// Struct: HashIndexFileHeader
+// Purpose: First bytes of a saved index file
+//------------------------------------------------------------
+struct HashIndexFileHeader
+{
+    char magic[4];       // INDEXMAGIC
+    uint32_t generation; // generation of the data file, checked at load
+    uint64_t checksum;   // checksum of the data file, checked at load
+    uint32_t keySize;    // HASHKEYSIZE when saved
+    int32_t capacity;    // number of buckets that follow
+    int32_t count;       // number of keys stored
+    int32_t unused;      // keeps the header a whole number of words
+};
+
+//============================================================
+// Function hashKey returns the FNV-1a hash of a null terminated key
+//------------------------------------------------------------
+static uint32_t hashKey(const char key[])
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < HASHKEYSIZE && key[i] != '\0'; ++i)
+    {
+        hash ^= static_cast<unsigned char>(key[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Function keyEquals compares a stored key with a lookup key
+//------------------------------------------------------------
+static bool keyEquals(const HashIndexEntry& entry, const char key[])
+{
+    return std::strncmp(entry.key, key, HASHKEYSIZE - 1) == 0;
+}
+
+// Function emptyTable allocates capacity unused buckets
+//------------------------------------------------------------
+static void emptyTable(HashIndex& index, int capacity)
+{
+    HashIndexEntry unused;
+    std::memset(unused.key, 0, sizeof(unused.key));
+    unused.slot = HASHEMPTY;
+    index.table.assign(capacity, unused);
+    index.count = 0;
+}
+
+// Function placeEntry stores an entry known not to be in the table
+//------------------------------------------------------------
+static void placeEntry(HashIndex& index, const HashIndexEntry& entry)
+{
+    std::size_t mask = index.table.size() - 1;
+    std::size_t pos = hashKey(entry.key) & mask;
+    while (index.table[pos].slot != HASHEMPTY)
+    {
+        pos = (pos + 1) & mask;
+    }
+    index.table[pos] = entry;
+    index.count++;
+}
+
+// Function resizeTable re-inserts every key into capacity buckets
+//------------------------------------------------------------
+static void resizeTable(HashIndex& index, int capacity)
+{
+    std::vector<HashIndexEntry> old;
+    old.swap(index.table);
+    emptyTable(index, capacity);
+    for (const HashIndexEntry& entry : old)
+    {
+        if (entry.slot != HASHEMPTY)
+        {
+            placeEntry(index, entry);
+        }
+    }
+}
+
+// Function growTable doubles the capacity and re-inserts every key
+//------------------------------------------------------------
+static void growTable(HashIndex& index)
+{
+    resizeTable(index, static_cast<int>(index.table.size()) * 2);
+}
+
+// Function findBucket returns the bucket holding key, or -1
+//------------------------------------------------------------
+static long findBucket(const HashIndex& index, const char key[])
+{
+    if (index.table.empty())
+    {
+        return -1;
+    }
+    std::size_t mask = index.table.size() - 1;
+    std::size_t pos = hashKey(key) & mask;
+    while (index.table[pos].slot != HASHEMPTY)
+    {
+        if (keyEquals(index.table[pos], key))
+        {
+            return static_cast<long>(pos);
+        }
+        pos = (pos + 1) & mask;
+    }
+    return -1;
+}
+
+//============================================================
+// Function hashIndexClear removes every key and sizes the table
+// so that expected keys fit without growing
+//------------------------------------------------------------
+void hashIndexClear(HashIndex& index, int expected)
+{
+    int capacity = MINCAPACITY;
+    while (capacity < expected * 2)
+    {
+        capacity *= 2;
+    }
+    emptyTable(index, capacity);
+}
+
+// Function hashIndexReserve grows the table, keeping its keys, so that
+// expected keys fit without growing again
+//------------------------------------------------------------
+void hashIndexReserve(HashIndex& index, int expected)
+{
+    int capacity = index.table.empty() ? MINCAPACITY : static_cast<int>(index.table.size());
+    while (capacity < expected * 2)
+    {
+        capacity *= 2;
+    }
+    if (capacity != static_cast<int>(index.table.size()))
+    {
+        resizeTable(index, capacity);
+    }
+}
+
+// Function hashIndexInsert maps key to slot, replacing the slot
+// if the key is already present
+//------------------------------------------------------------
+void hashIndexInsert(HashIndex& index, const char key[], int slot)
+{
+    if (index.table.empty())
+    {
+        emptyTable(index, MINCAPACITY);
+    }
+    long bucket = findBucket(index, key);
+    if (bucket >= 0)
+    {
+        index.table[bucket].slot = slot;
+        return;
+    }
+    // Keep the load factor at or below one half
+    if ((index.count + 1) * 2 > static_cast<int>(index.table.size()))
+    {
+        growTable(index);
+    }
+    HashIndexEntry entry;
+    std::memset(entry.key, 0, sizeof(entry.key));
+    std::strncpy(entry.key, key, HASHKEYSIZE - 1);
+    entry.slot = slot;
+    placeEntry(index, entry);
+}
+
+// Function hashIndexFind returns the slot stored for key,
+// or HASHEMPTY if the key is not in the index
+//------------------------------------------------------------
+int hashIndexFind(const HashIndex& index, const char key[])
+{
+    long bucket = findBucket(index, key);
+    return bucket < 0 ? HASHEMPTY : index.table[bucket].slot;
+}
+
+// Function hashIndexErase removes key from the index
+// Returns true if the key was present
+//------------------------------------------------------------
+bool hashIndexErase(HashIndex& index, const char key[])
+{
+    long bucket = findBucket(index, key);
+    if (bucket < 0)
+    {
+        return false;
+    }
+    std::size_t mask = index.table.size() - 1;
+    std::size_t hole = static_cast<std::size_t>(bucket);
+    std::size_t next = (hole + 1) & mask;
+
+    // Backward-shift the rest of the probe run into the hole so that
+    // later lookups never stop early at an emptied bucket
+    while (index.table[next].slot != HASHEMPTY)
+    {
+        std::size_t home = hashKey(index.table[next].key) & mask;
+        bool movable = (hole <= next) ? (home <= hole || home > next)
+                                      : (home <= hole && home > next);
+        if (movable)
+        {
+            index.table[hole] = index.table[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    index.table[hole].slot = HASHEMPTY;
+    index.table[hole].key[0] = '\0';
+    index.count--;
+    return true;
+}
+
+// Function hashIndexSave writes the index to fileName with the
+// generation and checksum of the data file it indexes, replacing the
+// file only once it is completely written
+// Throws an exception if the file cannot be written
+//------------------------------------------------------------
+void hashIndexSave(const HashIndex& index, const std::string& fileName, uint32_t generation, uint64_t checksum)
+{
+    HashIndexFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, INDEXMAGIC, sizeof(header.magic));
+    header.generation = generation;
+    header.checksum = checksum;
+    header.keySize = HASHKEYSIZE;
+    header.capacity = static_cast<int32_t>(index.table.size());
+    header.count = index.count;
+
+    // Write a temporary file first so a crash never leaves half an index
+    std::string tempName = fileName + ".tmp";
+    {
+        std::ofstream out(tempName, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!index.table.empty())
+        {
+            out.write(reinterpret_cast<const char*>(index.table.data()),
+                      static_cast<std::streamsize>(index.table.size() * sizeof(HashIndexEntry)));
+        }
+        if (!out)
+        {
+            throw std::runtime_error("Unable to write index file " + tempName + ".");
+        }
+    }
+    if (std::rename(tempName.c_str(), fileName.c_str()) != 0)
+    {
+        throw std::runtime_error("Unable to replace index file " + fileName + ".");
+    }
+}
+
+// Function hashIndexLoad reads an index saved with hashIndexSave
+// Returns false and leaves the index empty if the file is missing,
+// damaged or was saved for another generation or checksum
+//------------------------------------------------------------
+bool hashIndexLoad(HashIndex& index, const std::string& fileName, uint32_t generation, uint64_t checksum)
+{
+    index.table.clear();
+    index.count = 0;
+    std::ifstream in(fileName, std::ios::binary);
+    HashIndexFileHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        return false;
+    }
+    bool powerOfTwo = header.capacity >= MINCAPACITY && (header.capacity & (header.capacity - 1)) == 0;
+    if (std::memcmp(header.magic, INDEXMAGIC, sizeof(header.magic)) != 0 || header.generation != generation ||
+        header.checksum != checksum ||
+        header.keySize != static_cast<uint32_t>(HASHKEYSIZE) || !powerOfTwo ||
+        header.count < 0 || header.count * 2 > header.capacity)
+    {
+        return false;
+    }
+    std::vector<HashIndexEntry> table(static_cast<std::size_t>(header.capacity));
+    if (!in.read(reinterpret_cast<char*>(table.data()),
+                 static_cast<std::streamsize>(table.size() * sizeof(HashIndexEntry))))
+    {
+        return false;
+    }
+    index.table.swap(table);
+    index.count = header.count;
+    return true;
+}
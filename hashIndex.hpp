@@ -0,0 +1,92 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: hashIndex.hpp
+*
+* Description: Header file of the HashIndex module of the Ferry
+* Reservation System. Provides an in-memory open-addressing hash
+* table that maps a short string key to the slot (record number)
+* of a fixed-length record in one of the data files.
+* The storage modules own their indexes and keep them up to date
+* whenever a record is written, moved or deleted.
+*
+* An index can be saved to a file and loaded back, so a module does
+* not have to scan its data file at every start.
+*
+* Design Issues: Linear probing with backward-shift deletion,
+* so no tombstones are left behind in the table
+* Keys longer than HASHKEYSIZE - 1 characters are truncated
+* A saved index carries the generation and checksum of the owner's
+* data file when it was saved; an index saved for other data is
+* rejected at load
+*/
+//============================================================
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//============================================================
+// Constants
+//------------------------------------------------------------
+const int HASHKEYSIZE = 24; // maximum key length, including the terminator
+const int HASHEMPTY = -1;   // slot value of an unused table entry
+
+//============================================================
+// Struct: HashIndexEntry
+// Purpose: One bucket of the table, holding a key and its record slot
+//------------------------------------------------------------
+struct HashIndexEntry
+{
+    char key[HASHKEYSIZE]; // null terminated key
+    int slot;              // record number in the data file, HASHEMPTY if unused
+};
+
+//============================================================
+// Struct: HashIndex
+// Purpose: Open-addressing table, capacity is always a power of two
+//------------------------------------------------------------
+struct HashIndex
+{
+    std::vector<HashIndexEntry> table; // buckets
+    int count = 0;                     // number of keys stored
+};
+
+//============================================================
+// Function hashIndexClear removes every key and sizes the table
+// so that expected keys fit without growing
+//------------------------------------------------------------
+void hashIndexClear(HashIndex& index, int expected);
+
+// Function hashIndexReserve grows the table, keeping its keys, so that
+// expected keys fit without growing again
+//------------------------------------------------------------
+void hashIndexReserve(HashIndex& index, int expected);
+// Function hashIndexInsert maps key to slot, replacing the slot
+// if the key is already present
+//------------------------------------------------------------
+void hashIndexInsert(HashIndex& index, const char key[], int slot);
+
+// Function hashIndexFind returns the slot stored for key,
+// or HASHEMPTY if the key is not in the index
+//------------------------------------------------------------
+int hashIndexFind(const HashIndex& index, const char key[]);
+
+// Function hashIndexErase removes key from the index
+// Returns true if the key was present
+//------------------------------------------------------------
+bool hashIndexErase(HashIndex& index, const char key[]);
+
+// Function hashIndexSave writes the index to fileName with the
+// generation and checksum of the data file it indexes, replacing the
+// file only once it is completely written
+// Throws an exception if the file cannot be written
+//------------------------------------------------------------
+void hashIndexSave(const HashIndex& index, const std::string& fileName, uint32_t generation, uint64_t checksum);
+
+// Function hashIndexLoad reads an index saved with hashIndexSave
+// Returns false and leaves the index empty if the file is missing,
+// damaged or was saved for another generation or checksum
+//------------------------------------------------------------
+bool hashIndexLoad(HashIndex& index, const std::string& fileName, uint32_t generation, uint64_t checksum);
@@ -0,0 +1,359 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: logger.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation of the Logger module of the Ferry
+* Reservation System, see logger.hpp.
+* The ring is a bounded queue of LOGRINGSIZE slots for many producers
+* and the one background thread. Each slot carries a sequence number:
+* a producer claims the next position with a compare-and-swap, copies
+* its record into the slot and then publishes it by advancing the
+* sequence; the background thread reads published slots in order and
+* hands each back by advancing the sequence a full turn. Producers
+* never wait for the background thread, nor it for them.
+*
+* Design Issues: Producers do not wake the background thread, which
+* sleeps LOGFLUSHMS between batches, so logging needs no system call
+*/
+//============================================================
+
+#include "logger.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+//============================================================
+// Struct: LogRecord
+// Purpose: One logged event as the producer left it
+//------------------------------------------------------------
+struct LogRecord
+{
+    uint64_t ns;           // system clock time, nanoseconds since the epoch
+    int level;
+    int thread;            // 1 for the first thread that logged, then 2, ...
+    const char* event;     // a string literal
+    int fieldCount;
+    LogField fields[LOGFIELDS];
+};
+
+// Struct: LogSlot
+// Purpose: One position of the ring; sequence is the position it next
+// accepts a record for, or that position plus one once the record is in
+//------------------------------------------------------------
+struct LogSlot
+{
+    std::atomic<uint64_t> sequence{0};
+    LogRecord record;
+};
+
+//============================================================
+// Module scope static variables
+//------------------------------------------------------------
+static const char* LEVELNAMES[4] = {"ERROR", "WARN", "INFO", "DEBUG"};
+static std::unique_ptr<LogSlot[]> ring;     // LOGRINGSIZE slots, made by logStart
+static std::atomic<uint64_t> ringHead{0};   // next position a producer claims
+static uint64_t ringTail = 0;               // next position the background thread reads
+static std::atomic<uint64_t> dropped{0};    // records that found the ring full
+static std::atomic<bool> running{false};    // records go through the ring
+static std::atomic<int> threadCount{0};
+static thread_local int logThread = 0;      // number of the calling thread, 0 until it logs
+static std::ofstream logFile;
+static std::ostream* logOut = &std::cerr;   // where the lines go
+static std::thread writer;                  // the background thread
+static std::mutex writerMutex;
+static std::condition_variable writerCond;  // wakes the background thread to stop
+static bool stopping = false;               // under writerMutex
+static std::time_t stampSecond = -1;        // second the cached date and time show
+static char stamp[24];                      // "YYYY-MM-DDTHH:MM:SS", see formatRecord
+
+//============================================================
+// Function LogField copies value, cut short to fit, as a text field
+//------------------------------------------------------------
+LogField::LogField(const char* name, const char* value) : key(name), kind(TEXT)
+{
+    if (value != nullptr)
+    {
+        std::size_t length = strnlen(value, LOGTEXTSIZE - 1);
+        std::memcpy(text, value, length);
+        text[length] = '\0';
+    }
+}
+
+// Function appendText appends text to line in double quotes, escaping
+// quotes, backslashes and line breaks
+//------------------------------------------------------------
+static void appendText(std::string& line, const char* text)
+{
+    line += '"';
+    for (;;)
+    {
+        std::size_t plain = std::strcspn(text, "\"\\\n");
+        line.append(text, plain);
+        text += plain;
+        if (*text == '\0')
+        {
+            break;
+        }
+        line += '\\';
+        line += *text == '\n' ? 'n' : *text;
+        text++;
+    }
+    line += '"';
+}
+
+// Function formatRecord appends the text line of r to line
+// The date and time are converted once a second; the background
+// thread formats every line, so this is where its time goes
+//------------------------------------------------------------
+static void formatRecord(std::string& line, const LogRecord& r)
+{
+    std::time_t seconds = static_cast<std::time_t>(r.ns / 1000000000);
+    if (seconds != stampSecond)
+    {
+        std::tm utc;
+#ifndef _WIN32
+        gmtime_r(&seconds, &utc);
+#else
+        gmtime_s(&utc, &seconds);
+#endif
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+        stampSecond = seconds;
+    }
+    char text[32];
+    unsigned micros = static_cast<unsigned>(r.ns % 1000000000 / 1000);
+    text[0] = '.';
+    for (int i = 6; i >= 1; --i)
+    {
+        text[i] = static_cast<char>('0' + micros % 10);
+        micros /= 10;
+    }
+    line += stamp;
+    line.append(text, 7);
+    line += "Z ";
+    line += LEVELNAMES[r.level];
+    line += " t";
+    line.append(text, std::to_chars(text, text + sizeof(text), r.thread).ptr);
+    line += ' ';
+    line += r.event;
+    for (int i = 0; i < r.fieldCount; ++i)
+    {
+        const LogField& field = r.fields[i];
+        line += ' ';
+        line += field.key;
+        line += '=';
+        if (field.kind == LogField::TEXT)
+        {
+            appendText(line, field.text);
+        }
+        else
+        {
+            // reals show six significant digits, as printf's %g does
+            std::to_chars_result end = field.kind == LogField::INTEGER ?
+                std::to_chars(text, text + sizeof(text), field.integer) :
+                std::to_chars(text, text + sizeof(text), field.real, std::chars_format::general, 6);
+            line.append(text, end.ptr);
+        }
+    }
+    line += '\n';
+}
+
+// Function fillRecord copies the event and its fields into r
+//------------------------------------------------------------
+static void fillRecord(LogRecord& r, int level, const char* event, std::initializer_list<LogField> fields)
+{
+    if (logThread == 0)
+    {
+        logThread = threadCount.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    r.ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    r.level = std::min(std::max(level, LOGERROR), LOGDEBUG);
+    r.thread = logThread;
+    r.event = event;
+    r.fieldCount = std::min(static_cast<int>(fields.size()), LOGFIELDS);
+    std::copy(fields.begin(), fields.begin() + r.fieldCount, r.fields);
+}
+
+// Function drainRing formats every published record into one batch and
+// writes it with a single write. Only the background thread calls it
+//------------------------------------------------------------
+static void drainRing()
+{
+    std::string batch;
+    batch.reserve(1 << 16);
+    for (;;)
+    {
+        LogSlot& slot = ring[ringTail & (LOGRINGSIZE - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != ringTail + 1)
+        {
+            break;
+        }
+        formatRecord(batch, slot.record);
+        slot.sequence.store(ringTail + LOGRINGSIZE, std::memory_order_release);
+        ringTail++;
+    }
+    uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (lost > 0)
+    {
+        LogRecord r;
+        fillRecord(r, LOGWARN, "logger.dropped", {{"records", static_cast<int64_t>(lost)}});
+        formatRecord(batch, r);
+    }
+    if (!batch.empty())
+    {
+        logOut->write(batch.data(), static_cast<std::streamsize>(batch.size()));
+        logOut->flush();
+    }
+}
+
+//============================================================
+// Function logWrite logs the event with its fields, see LOGWRITE
+// Fields past LOGFIELDS are left out
+//------------------------------------------------------------
+void logWrite(int level, const char* event, std::initializer_list<LogField> fields)
+{
+    if (!running.load(std::memory_order_acquire))
+    {
+        // no background thread: write the line now
+        LogRecord r;
+        fillRecord(r, level, event, fields);
+        std::string line;
+        formatRecord(line, r);
+        std::cerr.write(line.data(), static_cast<std::streamsize>(line.size()));
+        return;
+    }
+    uint64_t position = ringHead.load(std::memory_order_relaxed);
+    LogSlot* slot;
+    for (;;)
+    {
+        slot = &ring[position & (LOGRINGSIZE - 1)];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence == position)
+        {
+            if (ringHead.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (sequence < position)
+        {
+            // the slot still holds a record from a turn ago: the ring is full
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = ringHead.load(std::memory_order_relaxed);
+        }
+    }
+    fillRecord(slot->record, level, event, fields);
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+// Function logParseLevel converts "error", "warn", "info" or "debug"
+// to a level. Throws an exception for any other text
+//------------------------------------------------------------
+int logParseLevel(const std::string& text)
+{
+    for (int level = LOGERROR; level <= LOGDEBUG; ++level)
+    {
+        std::string name = LEVELNAMES[level];
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c)
+        {
+            return static_cast<char>(std::tolower(c));
+        });
+        if (text == name)
+        {
+            return level;
+        }
+    }
+    throw std::runtime_error("Unknown log level '" + text + "' (use error, warn, info or debug).");
+}
+
+// Function logStart writes records at or below level to fileName,
+// appending to it, or to std::cerr if fileName is empty, from a
+// background thread
+// Must be called before the threads that log are started, and after
+// metricsStart, whose signal the background thread must not take
+// Throws an exception if the file cannot be opened
+//------------------------------------------------------------
+void logStart(const std::string& fileName, int level)
+{
+    if (!fileName.empty())
+    {
+        logFile.open(fileName, std::ios::app);
+        if (!logFile)
+        {
+            throw std::runtime_error("Cannot open " + fileName);
+        }
+        logOut = &logFile;
+    }
+    ring.reset(new LogSlot[LOGRINGSIZE]);
+    for (uint64_t i = 0; i < LOGRINGSIZE; ++i)
+    {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    ringHead.store(0, std::memory_order_relaxed);
+    ringTail = 0;
+    logLevel = level;
+    stopping = false;
+    running.store(true, std::memory_order_release);
+    writer = std::thread([]()
+    {
+        std::unique_lock<std::mutex> lock(writerMutex);
+        for (;;)
+        {
+            bool last = stopping;
+            lock.unlock();
+            drainRing();
+            lock.lock();
+            if (last)
+            {
+                break;
+            }
+            writerCond.wait_for(lock, std::chrono::milliseconds(LOGFLUSHMS), []() { return stopping; });
+        }
+    });
+}
+
+// Function logStop writes every record still in the ring and stops the
+// background thread; later records are written to std::cerr at once
+// Must be called after the other threads have stopped
+//------------------------------------------------------------
+void logStop()
+{
+    if (!running.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        stopping = true;
+    }
+    writerCond.notify_one();
+    writer.join();
+    running.store(false, std::memory_order_release);
+    if (logFile.is_open())
+    {
+        logFile.close();
+    }
+    logOut = &std::cerr;
+    ring.reset();
+}
@@ -0,0 +1,127 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: logger.hpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Header file of the Logger module of the Ferry
+* Reservation System. A log record is an event name, a level and up
+* to LOGFIELDS named fields, each an integer, a real or a short text:
+*     LOGWRITE(LOGERROR, "reservationManager.accessSailingManagerUpdate",
+*              {"sailing", sailingID}, {"error", e.what()});
+* Once logStart is called, LOGWRITE copies the record into a ring
+* buffer shared by every thread, without a lock or a system call, and
+* a background thread formats the records as text lines
+*     2026-10-17T05:01:38.627481Z ERROR t1 reservationManager... sailing="..."
+* and writes all those waiting with one write every LOGFLUSHMS.
+* Before logStart and after logStop each record is written to
+* std::cerr at once, so tools and tests need not start the logger.
+* LOGWRITE costs one test when its level is turned off.
+*
+* Design Issues: A record that finds the ring full is dropped rather
+* than keeping a booking waiting; the number dropped is logged
+* Lines reach the file up to LOGFLUSHMS after they are logged, so an
+* error may show up after the next menu
+* Texts longer than LOGTEXTSIZE - 1 characters are cut short
+*/
+//============================================================
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+//============================================================
+// Constants
+//------------------------------------------------------------
+const int LOGERROR = 0;            // levels, most severe first
+const int LOGWARN = 1;
+const int LOGINFO = 2;
+const int LOGDEBUG = 3;
+const int LOGFIELDS = 4;           // fields per record
+const int LOGTEXTSIZE = 40;        // bytes of a text field, terminator included
+const uint64_t LOGRINGSIZE = 4096; // records in the ring, a power of two
+const int LOGFLUSHMS = 20;         // time between writes of the background thread
+
+//============================================================
+// Struct: LogField
+// Purpose: One named value of a log record, copied into the record so
+// it can be formatted after the caller has moved on
+//------------------------------------------------------------
+struct LogField
+{
+    enum Kind { INTEGER, REAL, TEXT };
+
+    const char* key = "";  // a string literal, which lives as long as the program
+    Kind kind = INTEGER;
+    int64_t integer = 0;
+    double real = 0.0;
+    char text[LOGTEXTSIZE]; // set for TEXT fields only
+
+    LogField() = default;
+    LogField(const char* name, int value) : key(name), kind(INTEGER), integer(value)
+    {
+    }
+    LogField(const char* name, int64_t value) : key(name), kind(INTEGER), integer(value)
+    {
+    }
+    LogField(const char* name, double value) : key(name), kind(REAL), real(value)
+    {
+    }
+    LogField(const char* name, const char* value);
+    LogField(const char* name, const std::string& value) : LogField(name, value.c_str())
+    {
+    }
+};
+
+//============================================================
+// Records at or below this level are written; defined here so that
+// testing it needs no call. Set by logStart
+//------------------------------------------------------------
+inline int logLevel = LOGINFO;
+
+// Function logEnabled returns true if records of level are written
+//------------------------------------------------------------
+inline bool logEnabled(int level)
+{
+    return level <= logLevel;
+}
+
+// Function logWrite logs the event with its fields, see LOGWRITE
+// Fields past LOGFIELDS are left out
+//------------------------------------------------------------
+void logWrite(int level, const char* event, std::initializer_list<LogField> fields);
+
+// Logs the event at level with the fields that follow, each written
+// as {"name", value}; the fields are not built if level is off
+#define LOGWRITE(level, event, ...) \
+    do \
+    { \
+        if (logEnabled(level)) \
+        { \
+            logWrite(level, event, {__VA_ARGS__}); \
+        } \
+    } while (0)
+
+//============================================================
+// Function logParseLevel converts "error", "warn", "info" or "debug"
+// to a level. Throws an exception for any other text
+//------------------------------------------------------------
+int logParseLevel(const std::string& text);
+
+// Function logStart writes records at or below level to fileName,
+// appending to it, or to std::cerr if fileName is empty, from a
+// background thread
+// Must be called before the threads that log are started, and after
+// metricsStart, whose signal the background thread must not take
+// Throws an exception if the file cannot be opened
+//------------------------------------------------------------
+void logStart(const std::string& fileName, int level);
+
+// Function logStop writes every record still in the ring and stops the
+// background thread; later records are written to std::cerr at once
+// Must be called after the other threads have stopped
+//------------------------------------------------------------
+void logStop();
@@ -20,6 +20,13 @@
 //================================================================
 
 #include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+#include <chrono>
+#include <fstream>
+#include <thread>
 #include "ui.hpp"
 #include "sailingManager.hpp"
 #include "reservationManager.hpp"
@@ -27,25 +34,368 @@
 #include "vessel.hpp"
 #include "sailing.hpp"
 #include "vehicle.hpp"
+#include "writeAheadLog.hpp"
+#include "mappedFile.hpp"
+#include "daemon.hpp"
+#include "exporter.hpp"
+#include "logger.hpp"
+#include "client.hpp"
+#include "service.hpp"
+#include "bulkImport.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 using std::endl; 
 using std::cout;
 
 //================================================================
+// Constants
+//----------------------------------------------------------------
+static const std::string WALFILENAME = "ferry.wal"; // write-ahead log shared by all data files
+static const int DEFAULTCOMMITMS = 10; // default group commit interval in milliseconds
+static const int BATCHCOMMITLINES = 512; // batch requests run before their commit is waited for
+static const std::string TRACEFILENAME = "ferry-trace.json"; // default file of --trace
+
+//================================================================
+// Module scope static variables
+//----------------------------------------------------------------
+static std::ostream* progressOut = &std::cout; // startup and shutdown lines; std::cerr in batch
+                                               // mode, where standard output holds only replies
+
+//================================================================
+// Struct: Options
+// Purpose: Settings taken from the command line
+//----------------------------------------------------------------
+struct Options
+{
+    WalDurability durability = WALGROUPCOMMIT; // when a change counts as committed
+    int commitIntervalMs = DEFAULTCOMMITMS;     // group commit / async flush interval
+    bool shared = false;                        // other processes use the same data files
+    std::string daemonSocket;                   // serve terminals on this socket, if set
+    int workers = DAEMONWORKERS;                // daemon worker threads
+    std::string connectSocket;                  // thin client of the daemon on this socket, if set
+    bool batch = false;                         // run requests from batchFile, no menus
+    std::string batchFile;                      // request file, standard input if empty
+    std::string importVehicles;                 // CSV files to import, if set
+    std::string importSailings;
+    std::string importReservations;
+    bool metrics = false;                       // report the metrics on SIGUSR1 and at shutdown
+    std::string metricsFile;                    // where to, std::cerr if empty
+    std::string traceFile;                      // write a Chrome trace here at exit, if set
+    std::string prometheusFile;                 // write the counters here for Prometheus, if set
+    int prometheusSeconds = EXPORTERSECONDS;    // time between writes of prometheusFile
+    std::string logFile;                        // append the log here, std::cerr if empty
+    int logLevel = LOGINFO;                     // most detailed level logged
+    bool logSet = false;                        // --log or --log-level was given
+};
+
+//================================================================
+
 
+// Function parseOptions reads the command line arguments
+// --durability=sync|group|async, --commit-interval=<ms>, --shared,
+// --daemon[=<socket>], --workers=<n>, --connect[=<socket>],
+// --batch[=<file>], --import-vehicles|sailings|reservations=<csv>,
+// --metrics[=<file>], --trace[=<file>], --prometheus=<file>,
+// --prometheus-interval=<seconds>, --log=<file> and --log-level=<level>
+// Throws an exception for an unknown, malformed or conflicting argument
+//----------------------------------------------------------------
+Options parseOptions(int argc, char* argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--durability=", 0) == 0)
+        {
+            options.durability = walParseDurability(arg.substr(13));
+        }
+        else if (arg.rfind("--commit-interval=", 0) == 0)
+        {
+            options.commitIntervalMs = std::stoi(arg.substr(18));
+        }
+        else if (arg == "--shared")
+        {
+            options.shared = true;
+        }
+        else if (arg == "--daemon" || arg.rfind("--daemon=", 0) == 0)
+        {
+            options.daemonSocket = arg.size() > 9 ? arg.substr(9) : DAEMONSOCKETNAME;
+        }
+        else if (arg.rfind("--workers=", 0) == 0)
+        {
+            options.workers = std::stoi(arg.substr(10));
+        }
+        else if (arg == "--connect" || arg.rfind("--connect=", 0) == 0)
+        {
+            options.connectSocket = arg.size() > 10 ? arg.substr(10) : DAEMONSOCKETNAME;
+        }
+        else if (arg == "--batch" || arg.rfind("--batch=", 0) == 0)
+        {
+            options.batch = true;
+            options.batchFile = arg.size() > 8 ? arg.substr(8) : "";
+        }
+        else if (arg.rfind("--import-vehicles=", 0) == 0)
+        {
+            options.importVehicles = arg.substr(18);
+        }
+        else if (arg.rfind("--import-sailings=", 0) == 0)
+        {
+            options.importSailings = arg.substr(18);
+        }
+        else if (arg.rfind("--import-reservations=", 0) == 0)
+        {
+            options.importReservations = arg.substr(22);
+        }
+        else if (arg == "--metrics" || arg.rfind("--metrics=", 0) == 0)
+        {
+            options.metrics = true;
+            options.metricsFile = arg.size() > 10 ? arg.substr(10) : "";
+        }
+        else if (arg == "--trace" || arg.rfind("--trace=", 0) == 0)
+        {
+            options.traceFile = arg.size() > 8 ? arg.substr(8) : TRACEFILENAME;
+        }
+        else if (arg.rfind("--prometheus=", 0) == 0)
+        {
+            options.prometheusFile = arg.substr(13);
+        }
+        else if (arg.rfind("--prometheus-interval=", 0) == 0)
+        {
+            options.prometheusSeconds = std::stoi(arg.substr(22));
+            if (options.prometheusSeconds < 1)
+            {
+                throw std::runtime_error("--prometheus-interval must be at least 1 second");
+            }
+        }
+        else if (arg.rfind("--log=", 0) == 0)
+        {
+            options.logFile = arg.substr(6);
+            options.logSet = true;
+        }
+        else if (arg.rfind("--log-level=", 0) == 0)
+        {
+            options.logLevel = logParseLevel(arg.substr(12));
+            options.logSet = true;
+        }
+        else
+        {
+            throw std::runtime_error("Unknown argument " + arg);
+        }
+    }
+    // The daemon is the only user of the data files; a client uses none
+    if (!options.daemonSocket.empty() && (options.shared || !options.connectSocket.empty()))
+    {
+        throw std::runtime_error("--daemon cannot be combined with --shared or --connect");
+    }
+    if (options.batch && (!options.daemonSocket.empty() || !options.connectSocket.empty()))
+    {
+        throw std::runtime_error("--batch cannot be combined with --daemon or --connect");
+    }
+    bool importing = !options.importVehicles.empty() || !options.importSailings.empty() ||
+                     !options.importReservations.empty();
+    if (importing && (options.batch || !options.daemonSocket.empty() || !options.connectSocket.empty()))
+    {
+        throw std::runtime_error("--import-... cannot be combined with --batch, --daemon or --connect");
+    }
+    if (options.metrics && !options.connectSocket.empty())
+    {
+        throw std::runtime_error("--metrics cannot be combined with --connect");
+    }
+    if (!options.prometheusFile.empty() && !options.connectSocket.empty())
+    {
+        throw std::runtime_error("--prometheus cannot be combined with --connect");
+    }
+    if (options.logSet && !options.connectSocket.empty())
+    {
+        throw std::runtime_error("--log and --log-level cannot be combined with --connect");
+    }
+    return options;
+}
+
+// Function elapsedMs returns the milliseconds passed since start
+//----------------------------------------------------------------
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Function logIsEmpty returns true if the write-ahead log file is
+// missing or holds no changes
+//----------------------------------------------------------------
+static bool logIsEmpty()
+{
+    std::ifstream log(WALFILENAME, std::ios::binary | std::ios::ate);
+    return !log || log.tellg() == 0;
+}
 
 // Function init initializes all the modules, excluding the UI module
+// The write-ahead log is opened first so the data files can be
+// brought up to date from it as they are opened. Each open loads its
+// data file into memory and builds the module's indexes; the time
+// taken by each is reported
+// In shared mode the log, which has a single writer, is not used and
+// every change is written through to the data file instead
+// Throws an exception if another process is using the data files in
+// the other mode, or without shared mode at all, or if shared mode is
+// asked for while the log still holds changes from a run that did not
+// shut down
 //----------------------------------------------------------------
- void init()
+ void init(const Options& options)
  {
-    std::cout << "Initiating program" << std::endl;
+    progressOut = options.batch ? &std::cerr : &std::cout;
+    *progressOut << "Initiating program" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    if (options.shared)
+    {
+        // keeps out a process using the log, whose private copies would undo our changes
+        walLock(WALFILENAME, false);
+        if (!logIsEmpty())
+        {
+            throw std::runtime_error(WALFILENAME + " holds unapplied changes; start once without --shared to recover them.");
+        }
+        mappedSetShared(true);
+    }
+    else
+    {
+        walOpen(WALFILENAME, options.durability, options.commitIntervalMs);
+    }
+    double walMs = elapsedMs(start);
+    auto step = std::chrono::steady_clock::now();
     vehicleOpen();
+    double vehicleMs = elapsedMs(step);
+    step = std::chrono::steady_clock::now();
     vesselOpen();
+    double vesselMs = elapsedMs(step);
+    step = std::chrono::steady_clock::now();
     reservationOpen();
+    double reservationMs = elapsedMs(step);
+    step = std::chrono::steady_clock::now();
     sailingOpen();
+    double sailingMs = elapsedMs(step);
+    step = std::chrono::steady_clock::now();
+    if (!options.shared)
+    {
+        // the space booked on each sailing may not have been flushed before a crash
+        serviceRestoreCapacity();
+    }
+    double capacityMs = elapsedMs(step);
+
+    *progressOut << std::fixed << std::setprecision(2)
+                 << "Startup took " << elapsedMs(start) << " ms (log " << walMs
+                 << ", vehicles " << vehicleMs << ", vessels " << vesselMs
+                 << ", reservations " << reservationMs << ", sailings " << sailingMs
+                 << ", capacity " << capacityMs << ")\n"
+                 << std::defaultfloat;
     return;
  }
 
 
+// Function writeCommitted waits for the commit of the batch requests
+// run so far, then writes their replies to standard output
+// Throws an exception if the log cannot be written
+//----------------------------------------------------------------
+static void writeCommitted(std::string& replies, uint64_t& commitLsn)
+{
+    if (commitLsn != 0)
+    {
+        walCommit(commitLsn);
+        commitLsn = 0;
+    }
+    std::cout.write(replies.data(), static_cast<std::streamsize>(replies.size()));
+    std::cout.flush();
+    replies.clear();
+}
+
+// Function runBatch runs the requests of the Service module read from
+// in, one per line and in order, without prompting. For each request
+// it writes the line number and the reply, "OK ..." or "ERR <reason>"
+// Blank lines and lines starting with # are skipped. Replies are
+// written BATCHCOMMITLINES at a time, once their changes are committed,
+// so a batch waits for the log once per group instead of per request
+// Returns the number of requests that failed
+// Throws an exception if the log cannot be written
+//----------------------------------------------------------------
+static int runBatch(std::istream& in)
+{
+    std::string line;
+    std::string replies;
+    uint64_t commitLsn = 0;
+    int lineNumber = 0;
+    int waiting = 0;
+    int failed = 0;
+    while (std::getline(in, line))
+    {
+        lineNumber++;
+        std::size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#')
+        {
+            continue;
+        }
+        uint64_t lsn;
+        std::string reply = serviceApply(line, lsn);
+        commitLsn = lsn > commitLsn ? lsn : commitLsn;
+        if (reply.rfind("ERR", 0) == 0)
+        {
+            failed++;
+        }
+        replies += std::to_string(lineNumber);
+        replies += ' ';
+        replies += reply;
+        replies += '\n';
+        if (++waiting == BATCHCOMMITLINES)
+        {
+            writeCommitted(replies, commitLsn);
+            waiting = 0;
+        }
+    }
+    writeCommitted(replies, commitLsn);
+    return failed;
+}
+
+// Function runImports imports the CSV files named on the command line,
+// vehicles and sailings before the reservations that refer to them,
+// and prints what became of each
+// Returns the number of lines that were not imported, not counting
+// records that were already stored
+// Throws an exception if a file cannot be read or written
+//----------------------------------------------------------------
+static int runImports(const Options& options)
+{
+    struct ImportStep
+    {
+        const std::string& fileName;
+        const char* what;
+        ImportResult (*run)(const std::string&, int);
+    };
+    const ImportStep steps[] = {
+        {options.importVehicles, "vehicles", importVehicles},
+        {options.importSailings, "sailings", importSailings},
+        {options.importReservations, "reservations", importReservations},
+    };
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int skipped = 0;
+    for (const ImportStep& step : steps)
+    {
+        if (step.fileName.empty())
+        {
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        ImportResult result = step.run(step.fileName, threads);
+        cout << "Imported " << result.imported << " of " << result.lines << ' ' << step.what
+             << " from " << step.fileName << " in " << std::fixed << std::setprecision(0)
+             << elapsedMs(start) << " ms (" << result.duplicates << " already stored, "
+             << result.invalid << " invalid";
+        if (result.full > 0)
+        {
+            cout << ", " << result.full << " on full sailings";
+        }
+        cout << ")\n";
+        skipped += result.invalid + result.full;
+    }
+    return skipped;
+}
+
 // Function startAccepting initializes the UI module
 //----------------------------------------------------------------
 void startAccepting()
@@ -57,25 +407,176 @@ void startAccepting()
 //----------------------------------------------------------------
 void shutdown()
 {
-    std::cout << "Shutting down program" << std::endl;
+    *progressOut << "Shutting down program" << std::endl;
+    // the exporter reads the sailing counters, which closing frees
+    exporterStop();
+    // Space booked on sailings is kept in memory; log it before the checkpoint
+    {
+        WalBatch batch;
+        sailingFlushCapacity();
+    }
+    // Checkpoint the log while the data files are still open
+    if (walIsOpen())
+    {
+        walClose();
+    }
     vehicleClose();
     vesselClose();
     reservationClose();
     sailingClose();
+    metricsStop();
+    traceStop();
+    logStop();
     return;
 }
 
 //----------------------------------------------------------------
 
-int main()
+int main(int argc, char* argv[])
 {
+    Options options;
+    try
+    {
+        options = parseOptions(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n'
+                  << "Usage: ferry [--durability=sync|group|async] [--commit-interval=<ms>] [--shared]\n"
+                  << "       ferry --daemon[=<socket>] [--workers=<n>] [--durability=...] [--commit-interval=<ms>]\n"
+                  << "       ferry --connect[=<socket>]\n"
+                  << "       ferry --batch[=<file>] [--durability=...] [--commit-interval=<ms>] [--shared]\n"
+                  << "       ferry [--import-vehicles=<csv>] [--import-sailings=<csv>] [--import-reservations=<csv>]\n"
+                  << "             [--durability=...] [--commit-interval=<ms>] [--shared]\n"
+                  << "       any form but --connect also takes --metrics[=<file>]\n"
+                  << "       any form also takes --trace[=<file>]\n"
+                  << "       any form but --connect also takes --prometheus=<file> [--prometheus-interval=<seconds>]\n"
+                  << "       and --log=<file> --log-level=error|warn|info|debug\n";
+        return 1;
+    }
+    // spans are recorded from the start, by every thread
+    if (!options.traceFile.empty())
+    {
+        traceStart(options.traceFile);
+    }
+    // a terminal of the daemon opens no data files of its own
+    if (!options.connectSocket.empty())
+    {
+        try
+        {
+            clientConnect(options.connectSocket);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+            traceStop();
+            return 1;
+        }
+        startAccepting();
+        clientClose();
+        traceStop();
+        return 0;
+    }
+    // start the metrics before init starts the log's threads, which
+    // must not take SIGUSR1
+    if (options.metrics)
+    {
+        metricsStart(options.metricsFile);
+    }
+    else if (!options.prometheusFile.empty())
+    {
+        metricsEnable(true); // the exporter writes the operation counts
+    }
+    // the log's thread must not take SIGUSR1 either, and must be running
+    // before init starts the threads that log
+    try
+    {
+        logStart(options.logFile, options.logLevel);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        metricsStop();
+        traceStop();
+        return 1;
+    }
     // initialize necessary modules
-    init();
-    // initialize UI module
-    startAccepting();
+    try
+    {
+        init(options);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        metricsStop();
+        traceStop();
+        logStop();
+        return 1;
+    }
+    if (!options.prometheusFile.empty())
+    {
+        exporterStart(options.prometheusFile, options.prometheusSeconds);
+    }
+    // run the imports or the batch, serve the terminals, or initialize UI module
+    int status = 0;
+    if (!options.importVehicles.empty() || !options.importSailings.empty() || !options.importReservations.empty())
+    {
+        try
+        {
+            status = runImports(options) > 0 ? 2 : 0;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+            status = 1;
+        }
+    }
+    else if (options.batch)
+    {
+        std::ios::sync_with_stdio(false);
+        std::ifstream file;
+        if (!options.batchFile.empty() && options.batchFile != "-")
+        {
+            file.open(options.batchFile);
+        }
+        try
+        {
+            if (!options.batchFile.empty() && options.batchFile != "-" && !file)
+            {
+                throw std::runtime_error("Cannot open " + options.batchFile);
+            }
+            int failed = runBatch(file.is_open() ? static_cast<std::istream&>(file) : std::cin);
+            if (failed > 0)
+            {
+                std::cerr << failed << " request(s) failed\n";
+                status = 2;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+            status = 1;
+        }
+    }
+    else if (!options.daemonSocket.empty())
+    {
+        try
+        {
+            daemonRun(options.daemonSocket, options.workers);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+            status = 1;
+        }
+    }
+    else
+    {
+        startAccepting();
+    }
     // shutdown all modules
     shutdown();
-    return 0;
+    return status;
 }      
 
 /*
@@ -0,0 +1,625 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: mappedFile.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation file of the MappedFile module of the
+* Ferry Reservation System. Each data file is mapped shared and
+* read/write; the mapping is always at least MAPCHUNK bytes and
+* doubles when an append no longer fits. The file itself is kept
+* at its exact data size so a crash never leaves garbage records.
+*
+* Shared mode takes fcntl record locks, which belong to the process:
+* nested locks of one range are counted here so that only the
+* outermost unlock releases it.
+* A private copy lives in a heap buffer with one dirty flag per
+* DIRTYPAGE bytes; mappedSync writes each run of dirty pages with one
+* write, sets the file size, then syncs the file once.
+*
+* Design Issues: Must be on a POSIX system for mmap; the _WIN32
+* build falls back to a heap buffer that is written back on sync
+* and does not support shared mode
+* Closing any descriptor of a file drops this process's locks on it,
+* so each data file is opened once
+* Every system call is counted by the Metrics module
+*/
+//============================================================
+
+#include "mappedFile.hpp"
+#include "metrics.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#ifdef _WIN32
+  #include <io.h>
+  #include <fcntl.h>
+  #include <sys/stat.h>
+#else
+  #include <unistd.h>
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+//============================================================
+// Module scope constants
+//------------------------------------------------------------
+static const std::size_t MAPCHUNK = 64 * 1024; // smallest mapping, in bytes
+static const std::size_t DIRTYPAGE = 4096;      // bytes of a private copy per dirty flag
+
+//============================================================
+// Module scope static variables
+//------------------------------------------------------------
+static bool sharedMode = false; // several processes use the same files
+
+//============================================================
+// Function chunkedCapacity returns the mapping size needed for size bytes
+//------------------------------------------------------------
+static std::size_t chunkedCapacity(std::size_t current, std::size_t size)
+{
+    std::size_t capacity = current < MAPCHUNK ? MAPCHUNK : current;
+    while (capacity < size)
+    {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+// Function allocateRegion grows the heap buffer that holds a private
+// copy, or stands in for a mapping, to capacity bytes; new bytes are zero
+//------------------------------------------------------------
+static void allocateRegion(MappedFile& file, std::size_t capacity)
+{
+    char* region = static_cast<char*>(std::realloc(file.base, capacity));
+    if (region == nullptr)
+    {
+        throw std::runtime_error("mappedFile: Cannot allocate buffer for " + file.name);
+    }
+    if (capacity > file.capacity)
+    {
+        std::memset(region + file.capacity, 0, capacity - file.capacity);
+    }
+    file.base = region;
+    file.capacity = capacity;
+}
+
+// Function freeRegion releases the heap buffer
+//------------------------------------------------------------
+static void freeRegion(MappedFile& file)
+{
+    std::free(file.base);
+    file.base = nullptr;
+    file.capacity = 0;
+}
+
+#ifdef _WIN32
+// Function mapRegion allocates the heap buffer standing in for a mapping
+//------------------------------------------------------------
+static void mapRegion(MappedFile& file, std::size_t capacity)
+{
+    allocateRegion(file, capacity);
+}
+
+// Function unmapRegion releases the heap buffer
+//------------------------------------------------------------
+static void unmapRegion(MappedFile& file)
+{
+    freeRegion(file);
+}
+#else
+// Function mapRegion maps capacity bytes of the file, replacing any
+// previous mapping; a private copy grows its heap buffer instead
+//------------------------------------------------------------
+static void mapRegion(MappedFile& file, std::size_t capacity)
+{
+    if (file.privateCopy)
+    {
+        allocateRegion(file, capacity);
+        return;
+    }
+    if (file.base != nullptr)
+    {
+        munmap(file.base, file.capacity);
+        metricsCountSyscalls();
+        file.base = nullptr;
+    }
+    void* region = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0);
+    metricsCountSyscalls();
+    if (region == MAP_FAILED)
+    {
+        file.capacity = 0;
+        throw std::runtime_error("mappedFile: Cannot map " + file.name);
+    }
+    file.base = static_cast<char*>(region);
+    file.capacity = capacity;
+}
+
+// Function unmapRegion removes the mapping, or frees a private copy
+//------------------------------------------------------------
+static void unmapRegion(MappedFile& file)
+{
+    if (file.privateCopy)
+    {
+        freeRegion(file);
+        return;
+    }
+    if (file.base != nullptr)
+    {
+        munmap(file.base, file.capacity);
+        metricsCountSyscalls();
+    }
+    file.base = nullptr;
+    file.capacity = 0;
+}
+#endif
+
+// Function loadRegion reads the whole file into the heap buffer
+// Throws an exception if the file cannot be read
+//------------------------------------------------------------
+static void loadRegion(MappedFile& file)
+{
+    std::size_t done = 0;
+    while (done < file.size)
+    {
+#ifdef _WIN32
+        int got = _read(file.fd, file.base + done, static_cast<unsigned>(file.size - done));
+#else
+        ssize_t got = ::pread(file.fd, file.base + done, file.size - done, static_cast<off_t>(done));
+#endif
+        metricsCountSyscalls();
+        if (got <= 0)
+        {
+            throw std::runtime_error("Error reading from file " + file.name + ".");
+        }
+        metricsCountRead(static_cast<uint64_t>(got));
+        done += static_cast<std::size_t>(got);
+    }
+}
+
+// Function writeRange writes the bytes of the heap buffer from first
+// up to last to the same place in the file
+// Throws an exception if the write fails
+//------------------------------------------------------------
+static void writeRange(MappedFile& file, std::size_t first, std::size_t last)
+{
+    while (first < last)
+    {
+#ifdef _WIN32
+        int written = _lseeki64(file.fd, static_cast<long long>(first), SEEK_SET) < 0 ? -1 :
+            _write(file.fd, file.base + first, static_cast<unsigned>(last - first));
+#else
+        ssize_t written = ::pwrite(file.fd, file.base + first, last - first, static_cast<off_t>(first));
+#endif
+        metricsCountSyscalls();
+        if (written <= 0)
+        {
+            throw std::runtime_error("mappedSync: Cannot write " + file.name);
+        }
+        metricsCountWritten(static_cast<uint64_t>(written));
+        first += static_cast<std::size_t>(written);
+    }
+}
+
+// Function writeBack writes every run of dirty pages of a private copy
+// and its size to the file, then syncs the file
+// Throws an exception if the file cannot be written
+//------------------------------------------------------------
+static void writeBack(MappedFile& file)
+{
+    std::size_t page = 0;
+    while (page < file.dirty.size())
+    {
+        if (!file.dirty[page])
+        {
+            page++;
+            continue;
+        }
+        std::size_t end = page;
+        while (end < file.dirty.size() && file.dirty[end])
+        {
+            end++;
+        }
+        std::size_t last = end * DIRTYPAGE < file.size ? end * DIRTYPAGE : file.size;
+        writeRange(file, page * DIRTYPAGE, last);
+        page = end;
+    }
+    metricsCountSyscalls(file.stored != file.size ? 2 : 1);
+#ifdef _WIN32
+    if ((file.stored != file.size && _chsize_s(file.fd, static_cast<long long>(file.size)) != 0) ||
+        _commit(file.fd) != 0)
+#else
+    if ((file.stored != file.size && ftruncate(file.fd, static_cast<off_t>(file.size)) != 0) ||
+        fdatasync(file.fd) != 0)
+#endif
+    {
+        throw std::runtime_error("mappedSync: Cannot flush " + file.name);
+    }
+    file.stored = file.size;
+    file.dirty.clear();
+}
+
+//============================================================
+// Function mappedOpen opens (creating if needed) and maps the file,
+// or reads it into a private copy if privateCopy is true
+// Throws an exception if the file cannot be opened or mapped
+//------------------------------------------------------------
+void mappedOpen(MappedFile& file, const std::string& name, bool privateCopy)
+{
+    if (file.fd >= 0)
+    {
+        throw std::runtime_error("File " + name + " is already open.");
+    }
+#ifdef _WIN32
+    int fd = _open(name.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int fd = ::open(name.c_str(), O_RDWR | O_CREAT, 0644);
+#endif
+    metricsCountSyscalls(2); // the open and the fstat below
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot open " + name + ".");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+        throw std::runtime_error("Cannot read size of " + name + ".");
+    }
+    file.name = name;
+    file.fd = fd;
+    file.size = static_cast<std::size_t>(info.st_size);
+    file.privateCopy = privateCopy;
+    file.stored = file.size;
+    file.dirty.clear();
+#ifdef _WIN32
+    bool load = true; // the heap buffer always stands in for the mapping
+#else
+    bool load = privateCopy;
+#endif
+    try
+    {
+        mapRegion(file, chunkedCapacity(0, file.size));
+        if (load)
+        {
+            loadRegion(file);
+        }
+    }
+    catch (const std::exception&)
+    {
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+        unmapRegion(file);
+        file.fd = -1;
+        file.privateCopy = false;
+        throw;
+    }
+}
+
+// Function mappedIsOpen returns true if the file is open
+//------------------------------------------------------------
+bool mappedIsOpen(const MappedFile& file)
+{
+    return file.fd >= 0;
+}
+
+// Function mappedResize sets the file size to newSize bytes,
+// growing the mapping in chunks when it no longer fits
+// Throws an exception if the file cannot be resized or remapped
+//------------------------------------------------------------
+void mappedResize(MappedFile& file, std::size_t newSize)
+{
+    if (file.fd < 0)
+    {
+        throw std::runtime_error("mappedResize: File not open.");
+    }
+    if (!file.privateCopy)
+    {
+        metricsCountSyscalls();
+#ifdef _WIN32
+        if (_chsize_s(file.fd, static_cast<long long>(newSize)) != 0)
+#else
+        if (ftruncate(file.fd, static_cast<off_t>(newSize)) != 0)
+#endif
+        {
+            throw std::runtime_error("mappedResize: Cannot resize " + file.name);
+        }
+    }
+    if (newSize > file.capacity)
+    {
+        mapRegion(file, chunkedCapacity(file.capacity, newSize));
+    }
+    else if (file.privateCopy && newSize < file.size)
+    {
+        // Bytes cut off read back as zero if the file grows again, as
+        // they would from the file
+        std::memset(file.base + newSize, 0, file.size - newSize);
+    }
+    file.size = newSize;
+}
+
+// Function mappedPreload reads the whole file into memory in one
+// sequential pass so later accesses do not fault pages in one by one
+// Returns the number of bytes loaded
+//------------------------------------------------------------
+std::size_t mappedPreload(MappedFile& file)
+{
+    if (file.fd < 0 || file.size == 0)
+    {
+        return 0;
+    }
+#ifndef _WIN32
+    if (file.privateCopy)
+    {
+        return file.size; // read in by mappedOpen
+    }
+    // Ask for readahead of the whole file, then touch every page in order
+    // so the reads are issued as one large sequential I/O
+    long pageSize = sysconf(_SC_PAGESIZE);
+    std::size_t step = pageSize > 0 ? static_cast<std::size_t>(pageSize) : 4096;
+    madvise(file.base, file.size, MADV_WILLNEED);
+    metricsCountSyscalls();
+    volatile char sink = 0;
+    for (std::size_t offset = 0; offset < file.size; offset += step)
+    {
+        sink = sink ^ file.base[offset];
+    }
+    (void)sink;
+#endif
+    // The heap buffer of the _WIN32 build is already filled by mappedOpen
+    return file.size;
+}
+
+// Function mappedTouch marks length bytes from offset as changed, so
+// that mappedSync writes them back; does nothing unless the file is
+// a private copy
+//------------------------------------------------------------
+void mappedTouch(MappedFile& file, std::size_t offset, std::size_t length)
+{
+    if (!file.privateCopy || length == 0)
+    {
+        return;
+    }
+    std::size_t last = (offset + length - 1) / DIRTYPAGE;
+    if (file.dirty.size() <= last)
+    {
+        file.dirty.resize(last + 1, false);
+    }
+    for (std::size_t page = offset / DIRTYPAGE; page <= last; ++page)
+    {
+        file.dirty[page] = true;
+    }
+}
+
+// Function mappedSync flushes modified pages to the file; a private
+// copy writes back its changed pages and its size
+// Throws an exception if the flush fails
+//------------------------------------------------------------
+void mappedSync(MappedFile& file)
+{
+    if (file.fd >= 0 && file.privateCopy)
+    {
+        writeBack(file);
+        return;
+    }
+    if (file.fd < 0 || file.size == 0)
+    {
+        return;
+    }
+    metricsCountSyscalls();
+#ifdef _WIN32
+    metricsCountWritten(file.size);
+    if (_lseeki64(file.fd, 0, SEEK_SET) != 0 ||
+        _write(file.fd, file.base, static_cast<unsigned>(file.size)) != static_cast<int>(file.size))
+#else
+    if (msync(file.base, file.size, MS_SYNC) != 0)
+#endif
+    {
+        throw std::runtime_error("mappedSync: Cannot flush " + file.name);
+    }
+}
+
+// Function mappedSyncRange flushes the pages holding length bytes
+// from offset to the file
+// Throws an exception if the flush fails
+//------------------------------------------------------------
+void mappedSyncRange(MappedFile& file, std::size_t offset, std::size_t length)
+{
+    if (file.fd < 0 || length == 0 || offset >= file.size)
+    {
+        return;
+    }
+#ifdef _WIN32
+    mappedSync(file);
+#else
+    if (file.privateCopy)
+    {
+        mappedSync(file);
+        return;
+    }
+    // msync needs a page aligned start
+    long pageSize = sysconf(_SC_PAGESIZE);
+    std::size_t page = pageSize > 0 ? static_cast<std::size_t>(pageSize) : 4096;
+    std::size_t start = offset - offset % page;
+    std::size_t end = offset + length < file.size ? offset + length : file.size;
+    metricsCountSyscalls();
+    if (msync(file.base + start, end - start, MS_SYNC) != 0)
+    {
+        throw std::runtime_error("mappedSyncRange: Cannot flush " + file.name);
+    }
+#endif
+}
+
+// Function mappedSetShared turns shared (multi-process) mode on or off
+// for every file opened afterwards
+// Throws an exception if shared mode is not supported
+//------------------------------------------------------------
+void mappedSetShared(bool shared)
+{
+#ifdef _WIN32
+    if (shared)
+    {
+        throw std::runtime_error("mappedFile: Shared mode needs fcntl record locks.");
+    }
+#endif
+    sharedMode = shared;
+}
+
+// Function mappedIsShared returns true in shared mode
+//------------------------------------------------------------
+bool mappedIsShared()
+{
+    return sharedMode;
+}
+
+#ifndef _WIN32
+// Function setRangeLock issues one fcntl lock request for the range,
+// waiting for conflicting locks and retrying if a signal interrupts it
+//------------------------------------------------------------
+static void setRangeLock(MappedFile& file, std::size_t offset, std::size_t length, short type)
+{
+    struct flock request;
+    std::memset(&request, 0, sizeof(request));
+    request.l_type = type;
+    request.l_whence = SEEK_SET;
+    request.l_start = static_cast<off_t>(offset);
+    request.l_len = static_cast<off_t>(length);
+    metricsCountSyscalls();
+    while (fcntl(file.fd, F_SETLKW, &request) != 0)
+    {
+        metricsCountSyscalls();
+        if (errno != EINTR)
+        {
+            throw std::runtime_error("mappedFile: Cannot lock " + file.name + ": " + std::strerror(errno));
+        }
+    }
+}
+#endif
+
+// Function mappedLock locks length bytes from offset for this process,
+// waiting while another process holds a conflicting lock. Does
+// nothing outside shared mode
+// Throws an exception if the lock cannot be taken
+//------------------------------------------------------------
+void mappedLock(MappedFile& file, std::size_t offset, std::size_t length, bool exclusive)
+{
+#ifndef _WIN32
+    if (!sharedMode || file.fd < 0)
+    {
+        return;
+    }
+    MappedLock& held = file.locks[offset];
+    if (held.count == 0 || (exclusive && !held.exclusive))
+    {
+        // First lock of the range, or a read lock turned into a write lock
+        try
+        {
+            setRangeLock(file, offset, length, exclusive ? F_WRLCK : F_RDLCK);
+        }
+        catch (const std::exception&)
+        {
+            if (held.count == 0)
+            {
+                file.locks.erase(offset);
+            }
+            throw;
+        }
+        held.exclusive = held.exclusive || exclusive;
+    }
+    held.count++;
+#else
+    (void)file;
+    (void)offset;
+    (void)length;
+    (void)exclusive;
+#endif
+}
+
+// Function mappedUnlock releases a lock taken with mappedLock
+//------------------------------------------------------------
+void mappedUnlock(MappedFile& file, std::size_t offset, std::size_t length)
+{
+#ifndef _WIN32
+    auto it = file.locks.find(offset);
+    if (it == file.locks.end())
+    {
+        return;
+    }
+    if (--it->second.count == 0)
+    {
+        file.locks.erase(it);
+        setRangeLock(file, offset, length, F_UNLCK);
+    }
+#else
+    (void)file;
+    (void)offset;
+    (void)length;
+#endif
+}
+
+// Function mappedRefresh reads the current size of the file, which
+// another process may have changed, and maps the new bytes
+// Throws an exception if the size cannot be read or the file remapped
+//------------------------------------------------------------
+void mappedRefresh(MappedFile& file)
+{
+#ifndef _WIN32
+    if (file.fd < 0 || file.privateCopy)
+    {
+        return;
+    }
+    struct stat info;
+    metricsCountSyscalls();
+    if (fstat(file.fd, &info) != 0)
+    {
+        throw std::runtime_error("Cannot read size of " + file.name + ".");
+    }
+    std::size_t newSize = static_cast<std::size_t>(info.st_size);
+    if (newSize > file.capacity)
+    {
+        mapRegion(file, chunkedCapacity(file.capacity, newSize));
+    }
+    file.size = newSize;
+#else
+    (void)file;
+#endif
+}
+
+// Function mappedClose unmaps and closes the file
+// Throws an exception if the file was already closed
+//------------------------------------------------------------
+void mappedClose(MappedFile& file)
+{
+    if (file.fd < 0)
+    {
+        throw std::runtime_error("File " + file.name + " was already closed.");
+    }
+#ifdef _WIN32
+    if (!file.privateCopy)
+    {
+        mappedSync(file);
+    }
+    _close(file.fd);
+#else
+    ::close(file.fd);
+#endif
+    metricsCountSyscalls();
+    unmapRegion(file);
+    file.fd = -1;
+    file.size = 0;
+    file.privateCopy = false;
+    file.dirty.clear();
+    file.locks.clear(); // closing the descriptor released them
+}
@@ -0,0 +1,142 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: mappedFile.hpp
+*
+* Description: Header file of the MappedFile module of the Ferry
+* Reservation System. Maps a data file of fixed-length binary
+* records into memory so that the storage modules can treat the
+* records as a typed array instead of issuing one read() or
+* write() call per record.
+* The mapping is grown in chunks, so appending a record only
+* extends the file and copies the bytes in.
+*
+* Design Issues: Pointers returned by mappedRecords are invalidated
+* whenever the file is resized past the mapped capacity
+* On systems without mmap the file is held in a heap buffer and
+* written back by mappedSync and mappedClose
+* In shared mode several processes map the same files; byte ranges
+* are locked with fcntl record locks and a process picks up growth
+* made by the others with mappedRefresh. Shared mode is POSIX only
+* A file opened as a private copy is read into a heap buffer instead:
+* changes, marked with mappedTouch, and resizes stay in memory until
+* mappedSync writes the changed pages back, so the file on disk only
+* changes when its owner says so (see RecordFile and the log)
+*/
+//============================================================
+#pragma once
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+//============================================================
+// Struct: MappedLock
+// Purpose: A byte-range lock held by this process, with a count so
+// that nested locks of the same range release it only once
+//------------------------------------------------------------
+struct MappedLock
+{
+    int count = 0;          // times the range has been locked
+    bool exclusive = false; // write lock if true, read lock otherwise
+};
+
+//============================================================
+// Struct: MappedFile
+// Purpose: State of one memory-mapped data file
+//------------------------------------------------------------
+struct MappedFile
+{
+    std::string name;         // name of the data file
+    int fd = -1;              // file descriptor, -1 if closed
+    char* base = nullptr;     // start of the mapping
+    std::size_t size = 0;     // bytes of record data in the file
+    std::size_t capacity = 0; // bytes currently mapped
+    std::map<std::size_t, MappedLock> locks; // held range locks, by offset
+    bool privateCopy = false; // changes stay in memory until mappedSync
+    std::vector<bool> dirty;  // pages of a private copy changed since the last mappedSync
+    std::size_t stored = 0;   // bytes in the file on disk, for a private copy
+};
+
+//============================================================
+// Function mappedOpen opens (creating if needed) and maps the file,
+// or reads it into a private copy if privateCopy is true
+// Throws an exception if the file cannot be opened or mapped
+//------------------------------------------------------------
+void mappedOpen(MappedFile& file, const std::string& name, bool privateCopy = false);
+
+// Function mappedIsOpen returns true if the file is open
+//------------------------------------------------------------
+bool mappedIsOpen(const MappedFile& file);
+
+// Function mappedResize sets the file size to newSize bytes,
+// growing the mapping in chunks when it no longer fits
+// Throws an exception if the file cannot be resized or remapped
+//------------------------------------------------------------
+void mappedResize(MappedFile& file, std::size_t newSize);
+
+// Function mappedPreload reads the whole file into memory in one
+// sequential pass so later accesses do not fault pages in one by one
+// Returns the number of bytes loaded
+//------------------------------------------------------------
+std::size_t mappedPreload(MappedFile& file);
+// Function mappedTouch marks length bytes from offset as changed, so
+// that mappedSync writes them back; does nothing unless the file is
+// a private copy
+//------------------------------------------------------------
+void mappedTouch(MappedFile& file, std::size_t offset, std::size_t length);
+// Function mappedSync flushes modified pages to the file; a private
+// copy writes back its changed pages and its size
+// Throws an exception if the flush fails
+//------------------------------------------------------------
+void mappedSync(MappedFile& file);
+// Function mappedSyncRange flushes the pages holding length bytes
+// from offset to the file
+// Throws an exception if the flush fails
+//------------------------------------------------------------
+void mappedSyncRange(MappedFile& file, std::size_t offset, std::size_t length);
+// Function mappedSetShared turns shared (multi-process) mode on or off
+// for every file opened afterwards
+// Throws an exception if shared mode is not supported
+//------------------------------------------------------------
+void mappedSetShared(bool shared);
+// Function mappedIsShared returns true in shared mode
+//------------------------------------------------------------
+bool mappedIsShared();
+// Function mappedLock locks length bytes from offset for this process,
+// waiting while another process holds a conflicting lock. Does
+// nothing outside shared mode
+// Throws an exception if the lock cannot be taken
+//------------------------------------------------------------
+void mappedLock(MappedFile& file, std::size_t offset, std::size_t length, bool exclusive);
+// Function mappedUnlock releases a lock taken with mappedLock
+//------------------------------------------------------------
+void mappedUnlock(MappedFile& file, std::size_t offset, std::size_t length);
+// Function mappedRefresh reads the current size of the file, which
+// another process may have changed, and maps the new bytes
+// Throws an exception if the size cannot be read or the file remapped
+//------------------------------------------------------------
+void mappedRefresh(MappedFile& file);
+
+// Function mappedClose unmaps and closes the file; changes to a
+// private copy that mappedSync has not written back are dropped
+// Throws an exception if the file was already closed
+//------------------------------------------------------------
+void mappedClose(MappedFile& file);
+
+// Function mappedRecords returns the mapping as an array of T
+//------------------------------------------------------------
+template <typename T>
+T* mappedRecords(const MappedFile& file)
+{
+    return reinterpret_cast<T*>(file.base);
+}
+
+// Function mappedCount returns the number of whole T records in the file
+//------------------------------------------------------------
+template <typename T>
+int mappedCount(const MappedFile& file)
+{
+    return static_cast<int>(file.size / sizeof(T));
+}
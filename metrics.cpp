@@ -0,0 +1,382 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: metrics.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation of the Metrics module of the Ferry
+* Reservation System, see metrics.hpp.
+* Operations are created once, by the first call of each instrumented
+* function, and never freed, so the references handed out stay valid.
+* Threads list their counters on their first count and fold them into
+* the retired totals when they end, so a report covers every thread
+* that ever counted, including the log's flush thread.
+* SIGUSR1 is answered by a thread waiting in sigwait(), so the report
+* is never written from a signal handler.
+*
+* Design Issues: SIGUSR1 must be blocked before the other threads are
+* started, since they inherit the signal mask; it is not watched on
+* _WIN32, where the report is only written at shutdown
+*/
+//============================================================
+
+#include "metrics.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+  #include <csignal>
+  #include <pthread.h>
+#endif
+
+//============================================================
+// Module scope static variables
+//------------------------------------------------------------
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<MetricsOperation>> operations; // in order of first call
+static std::vector<std::unique_ptr<MetricsFile>> files;          // in order of first open
+static std::vector<MetricsCounters*> threadCounters;              // threads still running
+static uint64_t retired[4] = {0, 0, 0, 0};                        // counts of threads that ended
+static std::string reportFileName;
+static bool started = false;
+#ifndef _WIN32
+static std::thread watcher;            // answers SIGUSR1
+static std::atomic<bool> watching{false};
+#endif
+
+//============================================================
+// Struct: ThreadGuard
+// Purpose: Folds a thread's counters into the retired totals and
+// unlists them when the thread ends
+//------------------------------------------------------------
+struct ThreadGuard
+{
+    ~ThreadGuard()
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        retired[0] += metricsThread.scanned.load(std::memory_order_relaxed);
+        retired[1] += metricsThread.bytesRead.load(std::memory_order_relaxed);
+        retired[2] += metricsThread.bytesWritten.load(std::memory_order_relaxed);
+        retired[3] += metricsThread.syscalls.load(std::memory_order_relaxed);
+        threadCounters.erase(std::remove(threadCounters.begin(), threadCounters.end(), &metricsThread),
+                             threadCounters.end());
+    }
+};
+
+//============================================================
+// Function bucketOf returns the histogram bucket of a latency: exact
+// below METRICSSUBBUCKETS ns, then METRICSSUBBUCKETS buckets for each
+// power of two
+//------------------------------------------------------------
+static int bucketOf(uint64_t ns)
+{
+    if (ns < static_cast<uint64_t>(METRICSSUBBUCKETS))
+    {
+        return static_cast<int>(ns);
+    }
+    int magnitude = 0; // index of the highest set bit
+    for (int step = 32; step > 0; step /= 2)
+    {
+        if ((ns >> (magnitude + step)) != 0)
+        {
+            magnitude += step;
+        }
+    }
+    if (magnitude >= METRICSMAGNITUDES)
+    {
+        return METRICSBUCKETS - 1;
+    }
+    int sub = static_cast<int>((ns >> (magnitude - 4)) & (METRICSSUBBUCKETS - 1));
+    return METRICSSUBBUCKETS * (magnitude - 3) + sub;
+}
+
+// Function bucketMiddle returns the latency in the middle of a bucket
+//------------------------------------------------------------
+static uint64_t bucketMiddle(int bucket)
+{
+    if (bucket < METRICSSUBBUCKETS)
+    {
+        return static_cast<uint64_t>(bucket);
+    }
+    int magnitude = bucket / METRICSSUBBUCKETS + 3;
+    uint64_t low = static_cast<uint64_t>(METRICSSUBBUCKETS + bucket % METRICSSUBBUCKETS) << (magnitude - 4);
+    return low + (uint64_t(1) << (magnitude - 4)) / 2;
+}
+
+// Function totals sums the counters of every thread, running or ended
+//------------------------------------------------------------
+static void totals(uint64_t sums[4])
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::copy(retired, retired + 4, sums);
+    for (const MetricsCounters* counters : threadCounters)
+    {
+        sums[0] += counters->scanned.load(std::memory_order_relaxed);
+        sums[1] += counters->bytesRead.load(std::memory_order_relaxed);
+        sums[2] += counters->bytesWritten.load(std::memory_order_relaxed);
+        sums[3] += counters->syscalls.load(std::memory_order_relaxed);
+    }
+}
+
+//============================================================
+// Function metricsRegisterThread lists the calling thread's counters
+// for reports; they are folded into the totals when the thread ends
+//------------------------------------------------------------
+void metricsRegisterThread()
+{
+    static thread_local ThreadGuard guard;
+    (void)guard;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (!metricsThread.registered)
+    {
+        threadCounters.push_back(&metricsThread);
+        metricsThread.registered = true;
+    }
+}
+
+// Function metricsEnable turns counting on or off; it must not change
+// while other threads count
+//------------------------------------------------------------
+void metricsEnable(bool enabled)
+{
+    metricsEnabled = enabled;
+}
+
+// Function metricsOperation returns the operation called name,
+// creating it on first use; the reference stays valid
+//------------------------------------------------------------
+MetricsOperation& metricsOperation(const char name[])
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& op : operations)
+    {
+        if (op->name == name)
+        {
+            return *op;
+        }
+    }
+    operations.push_back(std::unique_ptr<MetricsOperation>(new MetricsOperation));
+    operations.back()->name = name;
+    return *operations.back();
+}
+
+// Function metricsOperations returns every operation created so far,
+// in order of first call
+//------------------------------------------------------------
+std::vector<MetricsOperation*> metricsOperations()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::vector<MetricsOperation*> all;
+    for (const auto& op : operations)
+    {
+        all.push_back(op.get());
+    }
+    return all;
+}
+
+// Function metricsFile returns the sizes of the data file called name,
+// creating them on first use; the reference stays valid
+//------------------------------------------------------------
+MetricsFile& metricsFile(const char name[])
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& file : files)
+    {
+        if (file->name == name)
+        {
+            return *file;
+        }
+    }
+    files.push_back(std::unique_ptr<MetricsFile>(new MetricsFile));
+    files.back()->name = name;
+    return *files.back();
+}
+
+// Function metricsFiles returns the sizes of every data file opened so
+// far, in order of first open
+//------------------------------------------------------------
+std::vector<MetricsFile*> metricsFiles()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::vector<MetricsFile*> all;
+    for (const auto& file : files)
+    {
+        all.push_back(file.get());
+    }
+    return all;
+}
+
+// Function metricsRecord adds one call that took ns nanoseconds and
+// scanned, read, wrote and issued counts[0..3] records, bytes, bytes
+// and system calls to op
+//------------------------------------------------------------
+void metricsRecord(MetricsOperation& op, uint64_t ns, const uint64_t counts[4])
+{
+    op.totalNs.fetch_add(ns, std::memory_order_relaxed);
+    op.buckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t longest = op.maxNs.load(std::memory_order_relaxed);
+    while (ns > longest && !op.maxNs.compare_exchange_weak(longest, ns, std::memory_order_relaxed))
+    {
+    }
+    std::atomic<uint64_t>* sums[4] = {&op.scanned, &op.bytesRead, &op.bytesWritten, &op.syscalls};
+    for (int i = 0; i < 4; ++i)
+    {
+        if (counts[i] != 0)
+        {
+            sums[i]->fetch_add(counts[i], std::memory_order_relaxed);
+        }
+    }
+}
+
+// Function metricsCalls returns the number of calls recorded for op
+//------------------------------------------------------------
+uint64_t metricsCalls(const MetricsOperation& op)
+{
+    uint64_t calls = 0;
+    for (const auto& bucket : op.buckets)
+    {
+        calls += bucket.load(std::memory_order_relaxed);
+    }
+    return calls;
+}
+
+// Function metricsPercentile returns the latency in nanoseconds below
+// which the fraction p of the calls to op completed
+//------------------------------------------------------------
+uint64_t metricsPercentile(const MetricsOperation& op, double p)
+{
+    uint64_t calls = metricsCalls(op);
+    if (calls == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p * (calls - 1)) + 1;
+    if (rank >= calls)
+    {
+        return op.maxNs.load(std::memory_order_relaxed);
+    }
+    uint64_t seen = 0;
+    for (int b = 0; b < METRICSBUCKETS; ++b)
+    {
+        seen += op.buckets[b].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            return std::min(bucketMiddle(b), op.maxNs.load(std::memory_order_relaxed));
+        }
+    }
+    return op.maxNs.load(std::memory_order_relaxed);
+}
+
+// Function metricsReport writes a table of every operation called so
+// far, and the I/O totals of all threads, to out
+//------------------------------------------------------------
+void metricsReport(std::ostream& out)
+{
+    std::vector<MetricsOperation*> called;
+    for (MetricsOperation* op : metricsOperations())
+    {
+        if (metricsCalls(*op) > 0)
+        {
+            called.push_back(op);
+        }
+    }
+    std::sort(called.begin(), called.end(), [](const MetricsOperation* a, const MetricsOperation* b)
+    {
+        return a->name < b->name;
+    });
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::left << std::setw(46) << "Operation" << std::right << std::setw(10) << "calls" << std::setw(8) << "errors"
+        << std::setw(10) << "mean us" << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(12) << "max us"
+        << std::setw(12) << "scan/call" << std::setw(14) << "bytes read" << std::setw(14) << "bytes written"
+        << std::setw(10) << "syscalls" << '\n'
+        << std::fixed << std::setprecision(1);
+    for (const MetricsOperation* op : called)
+    {
+        uint64_t calls = metricsCalls(*op);
+        out << std::left << std::setw(46) << op->name << std::right << std::setw(10) << calls
+            << std::setw(8) << op->errors.load() << std::setw(10) << op->totalNs.load() / 1000.0 / calls << std::setw(10) << metricsPercentile(*op, 0.50) / 1000.0
+            << std::setw(10) << metricsPercentile(*op, 0.99) / 1000.0 << std::setw(12) << op->maxNs.load() / 1000.0
+            << std::setw(12) << static_cast<double>(op->scanned.load()) / calls << std::setw(14) << op->bytesRead.load() << std::setw(14)
+            << op->bytesWritten.load() << std::setw(10) << op->syscalls.load() << '\n';
+    }
+    uint64_t sums[4];
+    totals(sums);
+    out << "All threads: " << sums[0] << " records scanned, " << sums[1] << " bytes read, " << sums[2]
+        << " bytes written, " << sums[3] << " syscalls\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+// Function metricsWrite writes the report to fileName, or to std::cerr
+// if fileName is empty
+//------------------------------------------------------------
+void metricsWrite(const std::string& fileName)
+{
+    if (fileName.empty())
+    {
+        metricsReport(std::cerr);
+        return;
+    }
+    std::ofstream out(fileName, std::ios::trunc);
+    metricsReport(out);
+    if (!out)
+    {
+        std::cerr << "metrics: Cannot write " << fileName << '\n';
+    }
+}
+
+// Function metricsStart turns counting on, makes SIGUSR1 write the
+// report to fileName (see metricsWrite), and metricsStop write it once
+// more
+// Must be called before any other thread is started
+//------------------------------------------------------------
+void metricsStart(const std::string& fileName)
+{
+    metricsEnable(true);
+    reportFileName = fileName;
+    started = true;
+#ifndef _WIN32
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    watching = true;
+    watcher = std::thread([signals]()
+    {
+        int signal;
+        while (sigwait(&signals, &signal) == 0 && watching)
+        {
+            metricsWrite(reportFileName);
+        }
+    });
+#endif
+}
+
+// Function metricsStop writes the final report, if metricsStart was
+// called, and stops answering SIGUSR1
+//------------------------------------------------------------
+void metricsStop()
+{
+    if (!started)
+    {
+        return;
+    }
+#ifndef _WIN32
+    watching = false;
+    pthread_kill(watcher.native_handle(), SIGUSR1);
+    watcher.join();
+#endif
+    metricsWrite(reportFileName);
+    started = false;
+}
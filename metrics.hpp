@@ -0,0 +1,277 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: metrics.hpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Header file of the Metrics module of the Ferry
+* Reservation System. Counts, for every instrumented operation, its
+* calls, a latency histogram, and the records scanned, bytes read and
+* written and system calls issued while it ran, including those of
+* the operations it called.
+* A function is instrumented by putting METRICSSCOPE("module.name") as
+* its first statement. The storage layer reports what it does through
+* metricsCountScanned, metricsCountRead, metricsCountWritten and
+* metricsCountSyscalls, which only bump counters of the calling
+* thread; the operation's share is the difference between the counters
+* at its start and at its end.
+* Data files publish their size and record counts through metricsFile
+* whenever they change, so exporters never scan them.
+* The histogram has 16 buckets per power of two nanoseconds, so a
+* percentile is within about 6% of the true latency.
+* Nothing is counted until metricsEnable or metricsStart is called, so
+* a program run without metrics only pays one test per call.
+*
+* Design Issues: A report taken while operations run may mix counts
+* from before and after an operation completes
+* Latencies of the manager functions include the time spent waiting
+* for the user to answer their prompts
+*/
+//============================================================
+#pragma once
+#include "trace.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//============================================================
+// Constants
+//------------------------------------------------------------
+const int METRICSSUBBUCKETS = 16;  // histogram buckets per power of two
+const int METRICSMAGNITUDES = 44;  // latencies up to 2^44 ns (about 4.9 hours)
+const int METRICSBUCKETS = METRICSSUBBUCKETS * (METRICSMAGNITUDES - 3);
+
+//============================================================
+// Struct: MetricsCounters
+// Purpose: I/O done by one thread since it started. Only the owning
+// thread writes them; a report reads every thread's
+//------------------------------------------------------------
+struct MetricsCounters
+{
+    std::atomic<uint64_t> scanned;      // records examined
+    std::atomic<uint64_t> bytesRead;    // bytes copied out of files
+    std::atomic<uint64_t> bytesWritten; // bytes copied into files or written to the log
+    std::atomic<uint64_t> syscalls;     // system calls on files
+    bool registered;                    // listed for reports
+};
+
+// Struct: MetricsOperation
+// Purpose: Totals of one instrumented operation over all threads
+//------------------------------------------------------------
+struct MetricsOperation
+{
+    std::string name;
+    std::atomic<uint64_t> errors{0};    // calls ended by an exception
+    std::atomic<uint64_t> totalNs{0};
+    std::atomic<uint64_t> maxNs{0};
+    std::atomic<uint64_t> scanned{0};
+    std::atomic<uint64_t> bytesRead{0};
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> syscalls{0};
+    std::atomic<uint64_t> buckets[METRICSBUCKETS] = {}; // calls by latency
+};
+
+// Struct: MetricsFile
+// Purpose: Size of one data file, kept up to date by the file itself
+// on every change so it can be read from any thread without a lock
+//------------------------------------------------------------
+struct MetricsFile
+{
+    std::string name;
+    std::atomic<uint64_t> bytes{0};  // file size, header included
+    std::atomic<int64_t> records{0}; // live records
+    std::atomic<int64_t> slots{0};   // live records and tombstones
+};
+
+//============================================================
+// Counters of the calling thread, zero until its first count, and
+// whether anything is counted; defined here so that reaching them
+// needs no call
+//------------------------------------------------------------
+inline thread_local MetricsCounters metricsThread = {};
+inline bool metricsEnabled = false;
+
+// Function metricsEnable turns counting on or off; it must not change
+// while other threads count
+//------------------------------------------------------------
+void metricsEnable(bool enabled);
+
+// Function metricsRegisterThread lists the calling thread's counters
+// for reports; they are folded into the totals when the thread ends
+//------------------------------------------------------------
+void metricsRegisterThread();
+
+// Function metricsAdd adds n to a counter of the calling thread
+//------------------------------------------------------------
+inline void metricsAdd(std::atomic<uint64_t>& counter, uint64_t n)
+{
+    if (!metricsEnabled)
+    {
+        return;
+    }
+    if (!metricsThread.registered)
+    {
+        metricsRegisterThread();
+    }
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// Function metricsCountScanned counts records examined
+//------------------------------------------------------------
+inline void metricsCountScanned(uint64_t records)
+{
+    metricsAdd(metricsThread.scanned, records);
+}
+
+// Function metricsCountRead counts bytes copied out of a file
+//------------------------------------------------------------
+inline void metricsCountRead(uint64_t bytes)
+{
+    metricsAdd(metricsThread.bytesRead, bytes);
+}
+
+// Function metricsCountWritten counts bytes copied into a file
+//------------------------------------------------------------
+inline void metricsCountWritten(uint64_t bytes)
+{
+    metricsAdd(metricsThread.bytesWritten, bytes);
+}
+
+// Function metricsCountSyscalls counts system calls issued on files
+//------------------------------------------------------------
+inline void metricsCountSyscalls(uint64_t calls = 1)
+{
+    metricsAdd(metricsThread.syscalls, calls);
+}
+
+//============================================================
+// Function metricsOperation returns the operation called name,
+// creating it on first use; the reference stays valid
+//------------------------------------------------------------
+MetricsOperation& metricsOperation(const char name[]);
+
+// Function metricsOperations returns every operation created so far,
+// in order of first call
+//------------------------------------------------------------
+std::vector<MetricsOperation*> metricsOperations();
+
+// Function metricsFile returns the sizes of the data file called name,
+// creating them on first use; the reference stays valid
+//------------------------------------------------------------
+MetricsFile& metricsFile(const char name[]);
+
+// Function metricsFiles returns the sizes of every data file opened so
+// far, in order of first open
+//------------------------------------------------------------
+std::vector<MetricsFile*> metricsFiles();
+
+// Function metricsRecord adds one call that took ns nanoseconds and
+// scanned, read, wrote and issued counts[0..3] records, bytes, bytes
+// and system calls to op
+//------------------------------------------------------------
+void metricsRecord(MetricsOperation& op, uint64_t ns, const uint64_t counts[4]);
+
+// Function metricsCalls returns the number of calls recorded for op
+//------------------------------------------------------------
+uint64_t metricsCalls(const MetricsOperation& op);
+
+// Function metricsPercentile returns the latency in nanoseconds below
+// which the fraction p of the calls to op completed
+//------------------------------------------------------------
+uint64_t metricsPercentile(const MetricsOperation& op, double p);
+
+// Function metricsReport writes a table of every operation called so
+// far, and the I/O totals of all threads, to out
+//------------------------------------------------------------
+void metricsReport(std::ostream& out);
+
+// Function metricsWrite writes the report to fileName, or to std::cerr
+// if fileName is empty
+//------------------------------------------------------------
+void metricsWrite(const std::string& fileName);
+
+// Function metricsStart turns counting on, makes SIGUSR1 write the
+// report to fileName (see metricsWrite), and metricsStop write it once
+// more
+// Must be called before any other thread is started
+//------------------------------------------------------------
+void metricsStart(const std::string& fileName);
+
+// Function metricsStop writes the final report, if metricsStart was
+// called, and stops answering SIGUSR1
+//------------------------------------------------------------
+void metricsStop();
+
+//============================================================
+// Class: MetricsTimer
+// Purpose: Records one call of an operation when it goes out of scope,
+// and its span if tracing is on (see trace.hpp). A call left by an
+// exception is also counted as an error
+//------------------------------------------------------------
+class MetricsTimer
+{
+public:
+    explicit MetricsTimer(MetricsOperation& timed) : op(timed), active(metricsEnabled)
+    {
+        if (!active)
+        {
+            return;
+        }
+        if (!metricsThread.registered)
+        {
+            metricsRegisterThread();
+        }
+        start[0] = metricsThread.scanned.load(std::memory_order_relaxed);
+        start[1] = metricsThread.bytesRead.load(std::memory_order_relaxed);
+        start[2] = metricsThread.bytesWritten.load(std::memory_order_relaxed);
+        start[3] = metricsThread.syscalls.load(std::memory_order_relaxed);
+        exceptions = std::uncaught_exceptions();
+        began = std::chrono::steady_clock::now();
+    }
+
+    MetricsTimer(const MetricsTimer&) = delete;
+    MetricsTimer& operator=(const MetricsTimer&) = delete;
+
+    ~MetricsTimer()
+    {
+        if (!active)
+        {
+            return;
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - began);
+        uint64_t counts[4] = {metricsThread.scanned.load(std::memory_order_relaxed) - start[0],
+                              metricsThread.bytesRead.load(std::memory_order_relaxed) - start[1],
+                              metricsThread.bytesWritten.load(std::memory_order_relaxed) - start[2],
+                              metricsThread.syscalls.load(std::memory_order_relaxed) - start[3]};
+        metricsRecord(op, static_cast<uint64_t>(ns.count()), counts);
+        if (std::uncaught_exceptions() > exceptions)
+        {
+            op.errors.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (traceEnabled)
+        {
+            auto beganNs = std::chrono::duration_cast<std::chrono::nanoseconds>(began.time_since_epoch());
+            traceRecord(op.name.c_str(), static_cast<uint64_t>(beganNs.count()), static_cast<uint64_t>(ns.count()),
+                        counts);
+        }
+    }
+
+private:
+    MetricsOperation& op;
+    bool active;
+    uint64_t start[4];
+    int exceptions;        // exceptions already in flight at the start
+    std::chrono::steady_clock::time_point began;
+};
+
+// Instruments the enclosing function as the operation called name
+#define METRICSSCOPE(name) \
+    static MetricsOperation& metricsScopeOp = metricsOperation(name); \
+    MetricsTimer metricsScopeTimer(metricsScopeOp)
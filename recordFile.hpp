@@ -0,0 +1,971 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: recordFile.hpp
+*
+* Description: Header file of the RecordFile module of the Ferry
+* Reservation System. RecordFile<T> is the single implementation
+* of a data file of fixed-length T records, shared by the
+* Reservation, Sailing, Vessel and Vehicle storage modules.
+* Records live in a memory mapping of the file (see mappedFile.hpp),
+* so sequential reads walk the mapped block directly, appends are
+* batched into one resize per call, and any slot can be read or
+* written in constant time.
+* File format: a RecordFileHeader followed by slots. Each slot holds
+* a link word and one T record. The link word of a live record is
+* SLOTLIVE; a deleted record is a tombstone whose link word points to
+* the next free slot, so the free list is stored in the file itself
+* and survives a restart. Appends reuse free slots first.
+* Deleting a record is a single positioned write and never moves
+* other records. compact() moves live records from the end of the
+* file into free slots and truncates the file, a bounded number of
+* moves per call; the caller is told about every move so it can
+* update its indexes.
+* When the write-ahead log is open every change is logged before it
+* is applied, and changes left in the log are replayed at open. The
+* file is then held as a private copy (see mappedOpen): changes stay
+* in memory and reach the file only when a checkpoint or close writes
+* them back after the log holding them is durable, so a crash never
+* leaves a change on disk that the log cannot redo.
+* open() reads the whole file in once (see mappedPreload), so the
+* owning module's index build and later lookups run from memory.
+* Shared mode (see mappedSetShared) lets several processes use one
+* file. Reading or writing a record locks just that slot; appends and
+* deletes take a short exclusive lock on the header, which holds the
+* free list. Every append or delete bumps a generation counter in the
+* header, and refresh() tells the owning module when another process
+* has changed the file so it can rebuild its indexes. Each such change
+* is also written to a change log beside the file, <file>.changes, a
+* ring of the slots the last RECORDCHANGES generations changed, so
+* refreshChanges() can hand the owner just those slots, each with the
+* record it last saw there, and the owner updates its indexes in place.
+* Files never shrink in shared mode, because another process may still
+* be reading the truncated slots.
+*
+* Design Issues: T must be trivially copyable
+* References from at() are invalidated by appends
+* In shared mode lookups that go through an owner's index must hold
+* lockHeader() from refresh() until the slot is locked, and no slot
+* is locked without the header lock, so processes cannot deadlock
+* Files written before the header was added are converted at open;
+* an owner whose record layout changed since then passes the old
+* record size and a function converting one old record
+* Records examined, and bytes copied in and out, are reported to the
+* Metrics module, and so are the file's size and record count after
+* every change (see metricsFile)
+*/
+//============================================================
+#pragma once
+#include "mappedFile.hpp"
+#include "metrics.hpp"
+#include "writeAheadLog.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+//============================================================
+// Constants
+//------------------------------------------------------------
+const int32_t SLOTLIVE = -2;   // link word of a live record
+const int32_t SLOTNONE = -1;   // end of the free list
+const uint32_t RECORDFILEVERSION = 1;
+const uint32_t RECORDCHANGES = 1024; // entries of a change log, see RecordChange
+
+//============================================================
+// Struct: RecordFileHeader
+// Purpose: First bytes of every data file
+//------------------------------------------------------------
+struct RecordFileHeader
+{
+    char magic[4];       // "FRF1"
+    uint32_t version;    // RECORDFILEVERSION
+    uint32_t recordSize; // sizeof(T), checked at open
+    int32_t freeHead;    // first free slot, SLOTNONE if there is none
+    int32_t liveCount;   // number of live records
+    uint32_t generation; // bumped by every append, delete and compaction
+    int32_t reserved[2]; // always zero
+};
+
+// Struct: RecordChange
+// Purpose: One entry of the change log of a shared data file: the
+// slots changed by the append or delete that produced generation,
+// stored at entry generation % RECORDCHANGES
+//------------------------------------------------------------
+struct RecordChange
+{
+    uint32_t generation; // header generation after the change
+    int32_t slot;        // first slot changed
+    int32_t count;       // slots changed from slot on
+};
+
+//============================================================
+// Struct: RecordSlot
+// Purpose: One slot of a data file
+//------------------------------------------------------------
+template <typename T>
+struct RecordSlot
+{
+    int32_t link; // SLOTLIVE, or the next free slot of a tombstone
+    T record;     // the record, meaningless in a tombstone
+};
+
+//============================================================
+// Class: RecordLock
+// Purpose: Holds a byte-range lock of a data file until it goes out
+// of scope; does nothing outside shared mode
+//------------------------------------------------------------
+class RecordLock
+{
+public:
+    RecordLock(MappedFile& lockedFile, std::size_t lockOffset, std::size_t lockLength, bool exclusive)
+        : file(&lockedFile), offset(lockOffset), length(lockLength)
+    {
+        mappedLock(*file, offset, length, exclusive);
+    }
+
+    RecordLock(RecordLock&& other) noexcept : file(other.file), offset(other.offset), length(other.length)
+    {
+        other.file = nullptr;
+    }
+
+    RecordLock(const RecordLock&) = delete;
+    RecordLock& operator=(const RecordLock&) = delete;
+    RecordLock& operator=(RecordLock&&) = delete;
+
+    ~RecordLock()
+    {
+        if (file != nullptr)
+        {
+            try
+            {
+                mappedUnlock(*file, offset, length);
+            }
+            catch (const std::exception&)
+            {
+                // The lock goes away with the descriptor at worst
+            }
+        }
+    }
+
+private:
+    MappedFile* file;
+    std::size_t offset;
+    std::size_t length;
+};
+
+//============================================================
+// Class: RecordFile
+// Purpose: A data file of fixed-length binary T records
+//------------------------------------------------------------
+template <typename T>
+class RecordFile
+{
+    static_assert(std::is_trivially_copyable<T>::value, "RecordFile records must be trivially copyable");
+
+public:
+    // Converts one record of a file from before the header was added,
+    // legacySize bytes at old, into r; throws if it is not a valid record
+    typedef void (*LegacyConvert)(const char old[], T& r);
+
+    // Function RecordFile sets the name of the data file; it is not opened yet
+    // Records of a file without a header are taken to be T records
+    //--------------------------------------------------------
+    explicit RecordFile(const std::string& fileName) : name(fileName), tag(walFileTag(fileName))
+    {
+    }
+
+    // Function RecordFile sets the name of the data file, whose records
+    // had legacySize bytes before the header was added; convert turns
+    // one of those into a T record when such a file is opened
+    //--------------------------------------------------------
+    RecordFile(const std::string& fileName, std::size_t legacySize, LegacyConvert convert)
+        : name(fileName), tag(walFileTag(fileName)), legacySize(legacySize), legacyConvert(convert)
+    {
+    }
+
+    // Function open opens the data file, creating it if it does not exist
+    // Throws an exception if the file cannot be opened or has another format
+    //--------------------------------------------------------
+    void open()
+    {
+        mappedOpen(file, name, walIsOpen() && !mappedIsShared());
+        cursor = 0;
+        try
+        {
+            // Another process may be creating or converting the file too
+            RecordLock lock = lockHeader(true);
+            mappedRefresh(file);
+            prepareFormat();
+            seenGeneration = header()->generation;
+            if (mappedIsShared())
+            {
+                openChangeLog();
+            }
+        }
+        catch (const std::exception&)
+        {
+            if (mappedIsOpen(changeLog))
+            {
+                mappedClose(changeLog);
+            }
+            mappedClose(file);
+            throw;
+        }
+        if (walIsOpen())
+        {
+            // Bring the file up to date with changes still in the log
+            walReplay(tag, [this](int operation, uint64_t offset, const char* data, std::size_t size)
+            {
+                replay(operation, offset, data, size);
+            });
+            walRegister(tag, [this]()
+            {
+                mappedSync(file);
+            });
+        }
+        // Load the whole file now so index builds and lookups run from memory
+        mappedPreload(file);
+        seeAllSlots();
+        sizes = &metricsFile(name.c_str());
+        publishSizes();
+    }
+
+    // Function close closes the data file
+    // Throws an exception if the file was already closed
+    //--------------------------------------------------------
+    void close()
+    {
+        if (!isOpen())
+        {
+            throw std::runtime_error("File " + name + " was already closed.");
+        }
+        if (walIsOpen())
+        {
+            // Write the changes back once the log holds them durably, and
+            // before a checkpoint may empty the log of them
+            auto apply = walApplyLock();
+            walFlush();
+            mappedSync(file);
+            apply.unlock();
+            walUnregister(tag);
+        }
+        else if (file.privateCopy)
+        {
+            // The log was closed first; changes made since are written now
+            mappedSync(file);
+        }
+        if (mappedIsOpen(changeLog))
+        {
+            mappedClose(changeLog);
+        }
+        seenSlots.clear();
+        mappedClose(file);
+        publishSizes();
+    }
+
+    // Function isOpen returns true if the data file is open
+    //--------------------------------------------------------
+    bool isOpen() const
+    {
+        return mappedIsOpen(file);
+    }
+
+    // Function fileName returns the name of the data file
+    //--------------------------------------------------------
+    const std::string& fileName() const
+    {
+        return name;
+    }
+
+    // Function count returns the number of slots in the file,
+    // live records and tombstones together
+    //--------------------------------------------------------
+    int count() const
+    {
+        return file.size < sizeof(RecordFileHeader) ? 0 :
+            static_cast<int>((file.size - sizeof(RecordFileHeader)) / sizeof(RecordSlot<T>));
+    }
+
+    // Function lockHeader locks the file header, which every append and
+    // delete changes; hold it exclusive to make several changes as one
+    // step, or shared to keep slots from being reused while reading
+    //--------------------------------------------------------
+    RecordLock lockHeader(bool exclusive)
+    {
+        return RecordLock(file, 0, sizeof(RecordFileHeader), exclusive);
+    }
+
+    // Function lockSlot locks one slot, exclusive for a read-modify-write
+    // The header lock must already be held
+    //--------------------------------------------------------
+    RecordLock lockSlot(int slot, bool exclusive)
+    {
+        return RecordLock(file, slotOffset(slot), sizeof(RecordSlot<T>), exclusive);
+    }
+
+    // Function refresh picks up appends and deletes made by another
+    // process since this one last looked, mapping any new slots
+    // Returns true if the file changed, so the owner must rebuild its indexes
+    //--------------------------------------------------------
+    bool refresh()
+    {
+        if (!mappedIsShared() || !isOpen() || header()->generation == seenGeneration)
+        {
+            return false;
+        }
+        mappedRefresh(file);
+        seenGeneration = header()->generation;
+        seeAllSlots();
+        publishSizes();
+        return true;
+    }
+
+    // Function refreshChanges picks up appends and deletes made by another
+    // process like refresh, but calls changed(slot, before, after) for
+    // each slot they changed instead; before is the record this process
+    // last saw in the slot and after the one there now, either null if
+    // the slot held no live record
+    // Returns false, calling nothing, if the change log no longer holds
+    // every change, so the owner must rebuild its indexes
+    //--------------------------------------------------------
+    bool refreshChanges(const std::function<void(int slot, const T* before, const T* after)>& changed)
+    {
+        if (!mappedIsShared() || !isOpen() || header()->generation == seenGeneration)
+        {
+            return true;
+        }
+        mappedRefresh(file);
+        uint32_t current = header()->generation;
+        std::vector<int> touched;
+        bool logged = mappedIsOpen(changeLog) && current - seenGeneration <= RECORDCHANGES;
+        for (uint32_t g = seenGeneration + 1; logged && g != current + 1; ++g)
+        {
+            const RecordChange& change = changes()[g % RECORDCHANGES];
+            logged = change.generation == g && change.slot >= 0 && change.slot + change.count <= count();
+            for (int32_t i = 0; logged && i < change.count; ++i)
+            {
+                touched.push_back(change.slot + i);
+            }
+        }
+        seenGeneration = current;
+        publishSizes();
+        if (!logged)
+        {
+            seeAllSlots();
+            return false;
+        }
+
+        // A slot freed and reused meanwhile is reported once, as it is now
+        std::sort(touched.begin(), touched.end());
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+        growSeenSlots();
+        for (int slot : touched)
+        {
+            RecordSlot<T> before = seenSlots[slot];
+            seenSlots[slot] = slots()[slot];
+            changed(slot, before.link == SLOTLIVE ? &before.record : nullptr,
+                    seenSlots[slot].link == SLOTLIVE ? &seenSlots[slot].record : nullptr);
+        }
+        return true;
+    }
+
+    // Function generation returns the generation counter of the header,
+    // bumped by every append, delete and compaction
+    //--------------------------------------------------------
+    uint32_t generation() const
+    {
+        return isOpen() ? header()->generation : 0;
+    }
+
+    // Function checksum returns a checksum of every byte of the file,
+    // header included, so an owner can tell whether something it saved
+    // about the records still matches them. Reads the whole file
+    //--------------------------------------------------------
+    uint64_t checksum() const
+    {
+        // FNV-1a taken a word at a time, then over the bytes left over
+        uint64_t hash = 14695981039346656037ull;
+        std::size_t words = isOpen() ? file.size / sizeof(uint64_t) : 0;
+        for (std::size_t i = 0; i < words; ++i)
+        {
+            uint64_t word;
+            std::memcpy(&word, file.base + i * sizeof(uint64_t), sizeof(word));
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+        for (std::size_t i = words * sizeof(uint64_t); isOpen() && i < file.size; ++i)
+        {
+            hash = (hash ^ static_cast<unsigned char>(file.base[i])) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Function liveCount returns the number of live records
+    //--------------------------------------------------------
+    int liveCount() const
+    {
+        return isOpen() ? header()->liveCount : 0;
+    }
+
+    // Function isLive returns true if slot holds a live record
+    //--------------------------------------------------------
+    bool isLive(int slot) const
+    {
+        return slot >= 0 && slot < count() && slots()[slot].link == SLOTLIVE;
+    }
+
+    // Function at returns the record in slot without copying it
+    // The slot must exist; use isLive to skip tombstones when scanning
+    //--------------------------------------------------------
+    const T& at(int slot) const
+    {
+        metricsCountScanned(1);
+        return slots()[slot].record;
+    }
+
+    // Function reset moves the getNext position to the first record
+    // Throws an exception if the file is not open
+    //--------------------------------------------------------
+    void reset()
+    {
+        requireOpen();
+        cursor = 0;
+    }
+
+    // Function getNext copies the next live record into r
+    // Returns false, leaving r unchanged, once every record has been read
+    // Throws an exception if the file is not open
+    //--------------------------------------------------------
+    bool getNext(T& r)
+    {
+        requireOpen();
+        int total = count();
+        const RecordSlot<T>* all = slots();
+        int first = cursor;
+        while (cursor < total && all[cursor].link != SLOTLIVE)
+        {
+            cursor++;
+        }
+        if (cursor >= total)
+        {
+            metricsCountScanned(cursor - first);
+            return false;
+        }
+        r = all[cursor++].record;
+        metricsCountScanned(cursor - first);
+        metricsCountRead(sizeof(T));
+        return true;
+    }
+
+    // Function append stores r in a free slot, or after the last slot
+    // if there is none. Returns the slot it was written to
+    // Throws an exception if the file cannot be extended
+    //--------------------------------------------------------
+    int append(const T& r)
+    {
+        int slot;
+        appendBatch(&r, 1, &slot);
+        return slot;
+    }
+
+    // Function appendBatch stores n records, filling free slots first and
+    // then extending the file with a single resize. The slot of each
+    // record is stored in slotsOut if it is not null
+    // Throws an exception if the file cannot be extended
+    //--------------------------------------------------------
+    void appendBatch(const T batch[], int n, int slotsOut[] = nullptr)
+    {
+        requireOpen();
+        RecordLock lock = lockHeader(true);
+        uint32_t before = beginChange();
+        auto apply = walApplyLock();
+        uint64_t lsn = 0;
+        int i = 0;
+
+        // Reuse tombstones from the free list
+        RecordSlot<T> fresh;
+        fresh.link = SLOTLIVE;
+        for (; i < n && header()->freeHead != SLOTNONE; ++i)
+        {
+            int slot = header()->freeHead;
+            RecordFileHeader updated = *header();
+            updated.freeHead = slots()[slot].link;
+            updated.liveCount++;
+            updated.generation++;
+            fresh.record = batch[i];
+            writeBytes(slotOffset(slot), &fresh, sizeof(fresh));
+            lsn = writeBytes(0, &updated, sizeof(updated));
+            noteChange(updated.generation, slot, 1);
+            if (slotsOut != nullptr)
+            {
+                slotsOut[i] = slot;
+            }
+        }
+
+        // Append the rest after the last slot
+        if (i < n)
+        {
+            int first = count();
+            int rest = n - i;
+            std::vector<RecordSlot<T>> tail(rest);
+            for (int j = 0; j < rest; ++j)
+            {
+                tail[j].link = SLOTLIVE;
+                tail[j].record = batch[i + j];
+                if (slotsOut != nullptr)
+                {
+                    slotsOut[i + j] = first + j;
+                }
+            }
+            mappedResize(file, slotOffset(first + rest));
+            writeBytes(slotOffset(first), tail.data(), tail.size() * sizeof(RecordSlot<T>));
+            RecordFileHeader updated = *header();
+            updated.liveCount += rest;
+            updated.generation++;
+            lsn = writeBytes(0, &updated, sizeof(updated));
+            noteChange(updated.generation, first, rest);
+        }
+        endChange(before);
+        apply.unlock();
+        commit(lsn);
+    }
+
+    // Function readAt copies the record stored in slot into r
+    // Throws an exception if the slot does not hold a live record
+    //--------------------------------------------------------
+    void readAt(int slot, T& r)
+    {
+        RecordLock lock = lockSlot(slot, false);
+        requireSlot(slot);
+        r = slots()[slot].record;
+        metricsCountScanned(1);
+        metricsCountRead(sizeof(T));
+    }
+
+    // Function writeAt overwrites the record stored in slot with r
+    // Throws an exception if the slot does not hold a live record
+    //--------------------------------------------------------
+    void writeAt(int slot, const T& r)
+    {
+        RecordLock lock = lockSlot(slot, true);
+        requireSlot(slot);
+        auto apply = walApplyLock();
+        uint64_t lsn = writeBytes(slotOffset(slot) + offsetof(RecordSlot<T>, record), &r, sizeof(T));
+        seeSlots(slot, 1);
+        apply.unlock();
+        commit(lsn);
+    }
+
+    // Function removeAt turns the record in slot into a tombstone and puts
+    // the slot on the free list; no other record moves
+    // Throws an exception if the slot does not hold a live record
+    //--------------------------------------------------------
+    void removeAt(int slot)
+    {
+        RecordLock lock = lockHeader(true);
+        uint32_t before = beginChange();
+        RecordLock slotLock = lockSlot(slot, true);
+        requireSlot(slot);
+        auto apply = walApplyLock();
+        RecordFileHeader updated = *header();
+        int32_t link = updated.freeHead;
+        updated.freeHead = slot;
+        updated.liveCount--;
+        updated.generation++;
+        writeBytes(slotOffset(slot), &link, sizeof(link));
+        uint64_t lsn = writeBytes(0, &updated, sizeof(updated));
+        noteChange(updated.generation, slot, 1);
+        endChange(before);
+        apply.unlock();
+        commit(lsn);
+    }
+
+    // Function deadCount returns the number of tombstones in the file
+    //--------------------------------------------------------
+    int deadCount() const
+    {
+        return count() - liveCount();
+    }
+
+    // Function compact moves at most maxMoves live records from the end of
+    // the file into the lowest free slots, then truncates the tombstones
+    // left at the end. moved(from, to) is called for every record moved
+    // Does nothing in shared mode, where free slots are only reused
+    // Returns the number of tombstones still in the file
+    // Throws an exception if the file cannot be resized
+    //--------------------------------------------------------
+    int compact(int maxMoves, const std::function<void(int from, int to)>& moved)
+    {
+        requireOpen();
+        if (mappedIsShared())
+        {
+            return deadCount();
+        }
+        uint32_t before = beginChange();
+        auto apply = walApplyLock();
+        int hole = 0;
+        int tail = count() - 1;
+        int moves = 0;
+        uint64_t lsn = 0;
+
+        // Two pointers: the lowest tombstone takes the highest live record
+        while (true)
+        {
+            while (tail >= 0 && slots()[tail].link != SLOTLIVE)
+            {
+                tail--;
+            }
+            while (hole < tail && slots()[hole].link == SLOTLIVE)
+            {
+                hole++;
+            }
+            if (hole >= tail || moves >= maxMoves)
+            {
+                break;
+            }
+            RecordSlot<T> live = slots()[tail];
+            writeBytes(slotOffset(hole), &live, sizeof(live));
+            int32_t dead = SLOTNONE;
+            writeBytes(slotOffset(tail), &dead, sizeof(dead));
+            if (moved)
+            {
+                moved(tail, hole);
+            }
+            moves++;
+        }
+
+        // Cut off trailing tombstones and rebuild the free list from the rest
+        int keep = count();
+        while (keep > 0 && slots()[keep - 1].link != SLOTLIVE)
+        {
+            keep--;
+        }
+        if (keep < count())
+        {
+            lsn = walIsOpen() ? walLogTruncate(tag, slotOffset(keep)) : 0;
+            mappedResize(file, slotOffset(keep));
+        }
+        RecordFileHeader updated = *header();
+        updated.freeHead = SLOTNONE;
+        updated.generation++;
+        for (int slot = keep - 1; slot >= 0; --slot)
+        {
+            if (slots()[slot].link != SLOTLIVE)
+            {
+                int32_t link = updated.freeHead;
+                writeBytes(slotOffset(slot), &link, sizeof(link));
+                updated.freeHead = slot;
+            }
+        }
+        lsn = writeBytes(0, &updated, sizeof(updated));
+        if (cursor > keep)
+        {
+            cursor = keep;
+        }
+        endChange(before);
+        apply.unlock();
+        commit(lsn);
+        return deadCount();
+    }
+
+    // Function sync flushes every modified record to disk
+    // Throws an exception if the flush fails
+    //--------------------------------------------------------
+    void sync()
+    {
+        requireOpen();
+        auto apply = walApplyLock();
+        if (walIsOpen())
+        {
+            walFlush();
+        }
+        mappedSync(file);
+    }
+
+private:
+    // Function header returns the header at the start of the mapping
+    //--------------------------------------------------------
+    RecordFileHeader* header() const
+    {
+        return reinterpret_cast<RecordFileHeader*>(file.base);
+    }
+
+    // Function slots returns the slots that follow the header
+    //--------------------------------------------------------
+    RecordSlot<T>* slots() const
+    {
+        return reinterpret_cast<RecordSlot<T>*>(file.base + sizeof(RecordFileHeader));
+    }
+
+    // Function slotOffset returns the byte offset of slot in the file
+    //--------------------------------------------------------
+    static std::size_t slotOffset(int slot)
+    {
+        return sizeof(RecordFileHeader) + static_cast<std::size_t>(slot) * sizeof(RecordSlot<T>);
+    }
+
+    // Function changes returns the entries of the change log
+    //--------------------------------------------------------
+    RecordChange* changes() const
+    {
+        return reinterpret_cast<RecordChange*>(changeLog.base);
+    }
+
+    // Function openChangeLog opens the change log beside the file in shared
+    // mode, creating it if this is the first process to use the file
+    // The header lock must be held exclusively
+    //--------------------------------------------------------
+    void openChangeLog()
+    {
+        mappedOpen(changeLog, name + ".changes");
+        if (changeLog.size != RECORDCHANGES * sizeof(RecordChange))
+        {
+            // new, or left by another build: entries of generation 0 match no change
+            mappedResize(changeLog, 0);
+            mappedResize(changeLog, RECORDCHANGES * sizeof(RecordChange));
+        }
+    }
+
+    // Function noteChange logs that the change that produced generation
+    // changed count slots from slot, for the other processes, and records
+    // them as seen by this one. Does nothing outside shared mode
+    //--------------------------------------------------------
+    void noteChange(uint32_t generation, int slot, int count)
+    {
+        if (!mappedIsOpen(changeLog))
+        {
+            return;
+        }
+        RecordChange change{generation, slot, count};
+        changes()[generation % RECORDCHANGES] = change;
+        seeSlots(slot, count);
+    }
+
+    // Function growSeenSlots adds a tombstone to the records seen for every
+    // slot mapped since they were last taken
+    //--------------------------------------------------------
+    void growSeenSlots()
+    {
+        RecordSlot<T> dead;
+        std::memset(static_cast<void*>(&dead), 0, sizeof(dead));
+        dead.link = SLOTNONE;
+        seenSlots.resize(static_cast<std::size_t>(count()), dead);
+    }
+
+    // Function seeSlots takes count slots from slot as the records this
+    // process has seen, after a change it made itself. Shared mode only
+    //--------------------------------------------------------
+    void seeSlots(int slot, int count)
+    {
+        if (!mappedIsShared())
+        {
+            return;
+        }
+        growSeenSlots();
+        std::memcpy(static_cast<void*>(seenSlots.data() + slot), slots() + slot,
+                    static_cast<std::size_t>(count) * sizeof(RecordSlot<T>));
+    }
+
+    // Function seeAllSlots takes every slot as seen. Shared mode only
+    //--------------------------------------------------------
+    void seeAllSlots()
+    {
+        if (mappedIsShared())
+        {
+            seenSlots.assign(slots(), slots() + count());
+        }
+    }
+
+    // Function writeBytes logs and then copies size bytes into the file at offset
+    // Returns the log sequence number, or 0 if the log is not open
+    //--------------------------------------------------------
+    uint64_t writeBytes(std::size_t offset, const void* data, std::size_t size)
+    {
+        uint64_t lsn = walIsOpen() ? walLogWrite(tag, offset, data, size) : 0;
+        std::memcpy(file.base + offset, data, size);
+        mappedTouch(file, offset, size);
+        metricsCountWritten(size);
+        if (dirtyEnd == 0 || offset < dirtyBegin)
+        {
+            dirtyBegin = offset;
+        }
+        if (offset + size > dirtyEnd)
+        {
+            dirtyEnd = offset + size;
+        }
+        return lsn;
+    }
+
+    // Function commit waits until the change lsn is committed; without
+    // the log, shared mode writes the changed pages through instead
+    //--------------------------------------------------------
+    void commit(uint64_t lsn)
+    {
+        if (lsn != 0)
+        {
+            walCommit(lsn);
+        }
+        else if (mappedIsShared() && dirtyEnd != 0)
+        {
+            mappedSyncRange(file, dirtyBegin, dirtyEnd - dirtyBegin);
+        }
+        dirtyBegin = 0;
+        dirtyEnd = 0;
+    }
+
+    // Function beginChange makes sure every slot added by another process
+    // is mapped before this one changes the file
+    // Returns the generation the change starts from
+    //--------------------------------------------------------
+    uint32_t beginChange()
+    {
+        if (mappedIsShared())
+        {
+            mappedRefresh(file);
+        }
+        return header()->generation;
+    }
+
+    // Function endChange marks the file as seen after a change made by
+    // this process, unless another process had changed it before that
+    // the owner has not picked up yet
+    //--------------------------------------------------------
+    void endChange(uint32_t before)
+    {
+        if (seenGeneration == before)
+        {
+            seenGeneration = header()->generation;
+        }
+        publishSizes();
+    }
+
+    // Function publishSizes stores the file's size and record counts
+    // where other threads can read them, see metricsFile
+    //--------------------------------------------------------
+    void publishSizes()
+    {
+        if (sizes != nullptr)
+        {
+            sizes->bytes.store(isOpen() ? file.size : 0, std::memory_order_relaxed);
+            sizes->records.store(liveCount(), std::memory_order_relaxed);
+            sizes->slots.store(count(), std::memory_order_relaxed);
+        }
+    }
+
+    // Function prepareFormat writes the header of a new file, converts a
+    // file of bare records from before the header was added, and checks
+    // that an existing file holds records of this size
+    // Throws an exception if the file has another format
+    //--------------------------------------------------------
+    void prepareFormat()
+    {
+        bool hasHeader = file.size >= sizeof(RecordFileHeader) && std::memcmp(header()->magic, "FRF1", 4) == 0;
+        if (!hasHeader)
+        {
+            // Old files are plain arrays of records: rebuild them with a header
+            std::size_t oldSize = legacyConvert != nullptr ? legacySize : sizeof(T);
+            if (file.size % oldSize != 0)
+            {
+                throw std::runtime_error("File " + name + " has an unknown format: " + std::to_string(file.size) +
+                                         " bytes is not a whole number of " + std::to_string(oldSize) +
+                                         "-byte records.");
+            }
+            std::vector<T> old(file.size / oldSize);
+            if (legacyConvert == nullptr && !old.empty())
+            {
+                std::memcpy(static_cast<void*>(old.data()), file.base, file.size);
+            }
+            for (std::size_t i = 0; legacyConvert != nullptr && i < old.size(); ++i)
+            {
+                try
+                {
+                    legacyConvert(file.base + i * oldSize, old[i]);
+                }
+                catch (const std::exception& e)
+                {
+                    throw std::runtime_error("File " + name + " has an unknown format: record " + std::to_string(i) +
+                                             ": " + e.what());
+                }
+            }
+            mappedResize(file, slotOffset(static_cast<int>(old.size())));
+            RecordFileHeader fresh;
+            std::memset(&fresh, 0, sizeof(fresh));
+            std::memcpy(fresh.magic, "FRF1", 4);
+            fresh.version = RECORDFILEVERSION;
+            fresh.recordSize = sizeof(T);
+            fresh.freeHead = SLOTNONE;
+            fresh.liveCount = static_cast<int32_t>(old.size());
+            *header() = fresh;
+            for (std::size_t i = 0; i < old.size(); ++i)
+            {
+                slots()[i].link = SLOTLIVE;
+                slots()[i].record = old[i];
+            }
+            mappedTouch(file, 0, file.size);
+            mappedSync(file);
+        }
+        if (header()->recordSize != sizeof(T) || header()->version != RECORDFILEVERSION)
+        {
+            throw std::runtime_error("File " + name + " holds records of another size or version.");
+        }
+    }
+
+    // Function replay re-applies one logged change to the mapped file
+    //--------------------------------------------------------
+    void replay(int operation, uint64_t offset, const char* data, std::size_t size)
+    {
+        if (operation == WALWRITE)
+        {
+            if (offset + size > file.size)
+            {
+                mappedResize(file, static_cast<std::size_t>(offset + size));
+            }
+            std::memcpy(file.base + offset, data, size);
+            mappedTouch(file, offset, size);
+        }
+        else if (operation == WALTRUNCATE && offset <= file.size)
+        {
+            mappedResize(file, static_cast<std::size_t>(offset));
+        }
+    }
+
+    // Function requireOpen throws an exception if the file is not open
+    //--------------------------------------------------------
+    void requireOpen() const
+    {
+        if (!isOpen())
+        {
+            throw std::runtime_error("File " + name + " is not open.");
+        }
+    }
+
+    // Function requireSlot throws an exception if slot is not a live record
+    //--------------------------------------------------------
+    void requireSlot(int slot) const
+    {
+        requireOpen();
+        if (!isLive(slot))
+        {
+            throw std::runtime_error("Record " + std::to_string(slot) + " does not exist in " + name + ".");
+        }
+    }
+
+    std::string name; // name of the data file
+    uint32_t tag;     // identifies the file in the write-ahead log
+    MappedFile file;  // memory mapping of the data file
+    int cursor = 0;   // slot of the next record returned by getNext
+    uint32_t seenGeneration = 0; // header generation the owner's indexes match
+    std::size_t dirtyBegin = 0;  // bytes changed since the last commit
+    std::size_t dirtyEnd = 0;
+    MetricsFile* sizes = nullptr; // published size and counts, set at open
+    std::size_t legacySize = sizeof(T);     // record size before the header was added
+    LegacyConvert legacyConvert = nullptr;  // converts those records, null if T is unchanged
+    MappedFile changeLog;                   // <name>.changes, open in shared mode only
+    std::vector<RecordSlot<T>> seenSlots;   // slots as the owner last saw them, shared mode only
+};
@@ -17,243 +17,507 @@
 * Should call the init() function before any
 * operations
 * 
-* Design Issues: Using linear search for all traversal and deletions
-* Must be on a system able to use fstream
+* Design Issues: Point lookups and deletions go through an in-memory
+* hash index on (sailingID, vehicleLicence), and per-sailing work goes
+* through a sailingID -> slots index; both are rebuilt at open
+* Deletions leave tombstones that later writes reuse; compaction runs
+* in steps once half the file is tombstones
+* In shared mode each call locks the file header, updates the indexes
+* for the slots another process changed since the last call (see
+* RecordFile::refreshChanges), and locks only the slots it touches;
+* bookings on different sailings only meet at the header
+* Storage is a RecordFile<Reservation>, see recordFile.hpp; a file
+* from before the header was added is converted at open
 * Fixed-length records may waste space
 */
 //================================================================
 
 #include "reservation.hpp"
-#include <fstream>
+#include "hashIndex.hpp"
+#include "metrics.hpp"
+#include "recordFile.hpp"
+#include "writeAheadLog.hpp"
 #include <stdexcept>
 #include <cstring>
 #include <cctype>
 #include <cstdio>
-#ifdef _WIN32
-  #include <io.h>      
-#else
-  #include <unistd.h>  
-  #include <fcntl.h>
-#endif
-
-static std::fstream reservationFile;
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
 static const std::string RESERVATIONFILENAME = "reservations.dat";
+
+// Struct: LegacyReservation
+// Purpose: A reservation as written before the file had a header, with
+// the sailing ID as 9 characters and no terminator
+//----------------------------------------------------------------
+struct LegacyReservation
+{
+    char sailingID[9];
+    char vehicleLicence[10];
+    unsigned char onBoard;
+    unsigned char isLRL;
+};
+static_assert(sizeof(LegacyReservation) == 21, "reservations were 21 bytes before the header was added");
+
+// Function convertLegacyReservation converts one such reservation
+// Throws an exception if its sailing ID is not in the form ttt-dd-hh
+//----------------------------------------------------------------
+static void convertLegacyReservation(const char old[], Reservation& r)
+{
+    LegacyReservation legacy;
+    std::memcpy(&legacy, old, sizeof(legacy));
+    char sailingID[SAILINGIDSIZE] = {};
+    std::memcpy(sailingID, legacy.sailingID, sizeof(legacy.sailingID));
+    r.sailingID = sailingKeyEncode(sailingID);
+    std::memcpy(r.vehicleLicence, legacy.vehicleLicence, sizeof(r.vehicleLicence));
+    r.onBoard = legacy.onBoard != 0;
+    r.isLRL = legacy.isLRL != 0;
+}
+
+static RecordFile<Reservation> reservationFile(RESERVATIONFILENAME, sizeof(LegacyReservation),
+                                               convertLegacyReservation);
+static HashIndex reservationIndex; // (sailingID, vehicleLicence) -> record slot
+static std::unordered_map<SailingKey, std::vector<int>> sailingSlots; // sailingID -> record slots
+static std::atomic<int> bookedCount{0};    // reservations, readable from any thread
+static std::atomic<int> checkedInCount{0}; // reservations checked in, likewise
+static const int COMPACTMINDEAD = 64; // tombstones needed before compaction is scheduled
+static const int COMPACTSTEP = 1024;  // records moved per scheduled compaction step
 //================================================================
 
-// Function creates and opens reservation file.
-// Throw an exception if it cannot be opened.
+// Function unlinkSailingSlot removes slot from the list of its sailing
 //----------------------------------------------------------------
-void reservationOpen()
+static void unlinkSailingSlot(SailingKey sailingID, int slot)
+{
+    auto it = sailingSlots.find(sailingID);
+    if (it == sailingSlots.end())
+    {
+        return;
+    }
+    std::vector<int>& slots = it->second;
+    slots.erase(std::remove(slots.begin(), slots.end(), slot), slots.end());
+    if (slots.empty())
+    {
+        sailingSlots.erase(it);
+    }
+}
+
+// Function makeReservationKey builds the composite index key: the
+// packed sailingID as 8 hex digits followed by the vehicleLicence,
+// bounded by the record field size
+//----------------------------------------------------------------
+static void makeReservationKey(SailingKey sailingID, const char vehicleLicence[], char key[])
+{
+    static const char HEXDIGITS[] = "0123456789abcdef";
+    for (int i = 7; i >= 0; --i)
+    {
+        key[i] = HEXDIGITS[sailingID & 0xf];
+        sailingID >>= 4;
+    }
+    std::size_t licenceLen = strnlen(vehicleLicence, sizeof(Reservation::vehicleLicence));
+    std::memcpy(key + 8, vehicleLicence, licenceLen);
+    key[8 + licenceLen] = '\0';
+}
+
+// Function reindexMovedReservation points both indexes at slot to for
+// the record that used to be stored in slot from
+//----------------------------------------------------------------
+static void reindexMovedReservation(int from, int to)
+{
+    Reservation moved;
+    reservationFile.readAt(to, moved);
+
+    char movedKey[HASHKEYSIZE];
+    makeReservationKey(moved.sailingID, moved.vehicleLicence, movedKey);
+    hashIndexInsert(reservationIndex, movedKey, to);
+    std::vector<int>& slots = sailingSlots[moved.sailingID];
+    std::replace(slots.begin(), slots.end(), from, to);
+}
+
+// Function scheduleCompaction runs one compaction step once at least
+// half of the slots in the file are tombstones
+//----------------------------------------------------------------
+static void scheduleCompaction()
+{
+    int dead = reservationFile.deadCount();
+    if (dead >= COMPACTMINDEAD && dead >= reservationFile.liveCount())
+    {
+        reservationCompact(COMPACTSTEP);
+    }
+}
+
+// Function buildReservationIndex scans the file once and records the
+// slot of every reservation in the hash index and the per-sailing index
+//----------------------------------------------------------------
+static void buildReservationIndex()
 {
+    int total = reservationFile.count();
+    int checkedIn = 0;
+    hashIndexClear(reservationIndex, reservationFile.liveCount());
+    sailingSlots.clear();
 
-     // Try to open the reservation file without overwriting the contents
-    reservationFile.open(RESERVATIONFILENAME, std::ios::in | std::ios::out | std::ios::binary | std::ios::app);
-    if (!reservationFile.is_open())
+    char key[HASHKEYSIZE];
+    for (int slot = 0; slot < total; ++slot)
     {
-        // Try to create a reservation file if it does not exist
-        reservationFile.clear();
-        reservationFile.open(RESERVATIONFILENAME, std::ios::out | std::ios::binary);
-        
-        if (!reservationFile.is_open())
+        if (!reservationFile.isLive(slot))
         {
-            // Throw an exception if the file cannot be created
-            throw std::runtime_error("Cannot create " + RESERVATIONFILENAME + ".");
+            continue;
         }
-        reservationFile.close();
+        const Reservation& r = reservationFile.at(slot);
+        makeReservationKey(r.sailingID, r.vehicleLicence, key);
+        hashIndexInsert(reservationIndex, key, slot);
+        sailingSlots[r.sailingID].push_back(slot);
+        checkedIn += r.onBoard ? 1 : 0;
+    }
+    bookedCount.store(reservationFile.liveCount(), std::memory_order_relaxed);
+    checkedInCount.store(checkedIn, std::memory_order_relaxed);
+}
 
-        // Try to now re-open the file for reading and writing
-        reservationFile.open(RESERVATIONFILENAME, std::ios::in | std::ios::out | std::ios::binary | std::ios::app);
-        if (!reservationFile.is_open())
+// Function reindexChangedReservation takes the reservation another
+// process removed from slot out of both indexes and the counts, and
+// puts the one it stored there in; either may be null
+//----------------------------------------------------------------
+static void reindexChangedReservation(int slot, const Reservation* before, const Reservation* after)
+{
+    char key[HASHKEYSIZE];
+    if (before != nullptr)
+    {
+        makeReservationKey(before->sailingID, before->vehicleLicence, key);
+        if (hashIndexFind(reservationIndex, key) == slot)
         {
-            // Throw an exception if the file cannot be opened
-            throw std::runtime_error("Cannot open " + RESERVATIONFILENAME + ".");
-        } 
+            hashIndexErase(reservationIndex, key);
+        }
+        unlinkSailingSlot(before->sailingID, slot);
+        bookedCount.fetch_sub(1, std::memory_order_relaxed);
+        checkedInCount.fetch_sub(before->onBoard ? 1 : 0, std::memory_order_relaxed);
+    }
+    if (after != nullptr)
+    {
+        makeReservationKey(after->sailingID, after->vehicleLicence, key);
+        hashIndexInsert(reservationIndex, key, slot);
+        sailingSlots[after->sailingID].push_back(slot);
+        bookedCount.fetch_add(1, std::memory_order_relaxed);
+        checkedInCount.fetch_add(after->onBoard ? 1 : 0, std::memory_order_relaxed);
+    }
+}
+
+// Function refreshIndexes brings both indexes up to date with the
+// reservations another process added or deleted since this one last
+// looked (shared mode), slot by slot, or rebuilds them if there were
+// more changes than the file's change log holds
+// The header lock must be held
+//----------------------------------------------------------------
+static void refreshIndexes()
+{
+    if (!reservationFile.refreshChanges(reindexChangedReservation))
+    {
+        buildReservationIndex();
     }
 }
 
+// Function creates and opens reservation file.
+// Throw an exception if it cannot be opened.
+//----------------------------------------------------------------
+void reservationOpen()
+{
+    METRICSSCOPE("reservation.reservationOpen");
+    // Open the reservation file without overwriting the contents,
+    // creating it if it does not exist. Throws if it cannot be opened
+    reservationFile.open();
+
+    // Index every existing reservation for constant time lookups
+    buildReservationIndex();
+}
+
 // Function resets to the beginning of the list.
 // Throw an exception if it cannot be opened.
 //----------------------------------------------------------------
 void reservationReset()
 {
-    if (!reservationFile.is_open())
-    {
-        // Throw an exception if the file could not be opened
-        throw std::runtime_error("File " + RESERVATIONFILENAME + "is not open.");
-    }
-    reservationFile.clear();
-    reservationFile.seekg(0, std::ios::beg); // Set get position to the start of the file
+    METRICSSCOPE("reservation.reservationReset");
+    // Set get position to the start of the file
+    RecordLock lock = reservationFile.lockHeader(false);
+    refreshIndexes();
+    reservationFile.reset();
 }
 
 // Function getNextReservation returns a line from the data
 // Returns a boolean if the data is successfully read
 // Throws an exception if there is an error with reading the files
 //----------------------------------------------------------------
-bool getNextReservation(Reservation r)
+bool getNextReservation(Reservation& r)
+{
+    METRICSSCOPE("reservation.getNextReservation");
+    // Copy the next reservation out of the file, false at end of file
+    return reservationFile.getNext(r);
+}
+// Function writeReservation writes to reservation file
+// Throws an exception if it fails or if the vehicle is already
+// booked on the same sailing
+//----------------------------------------------------------------
+void writeReservation(const Reservation& r)
 {
-    if (!reservationFile.is_open())
+    METRICSSCOPE("reservation.writeReservation");
+    RecordLock lock = reservationFile.lockHeader(true);
+    refreshIndexes();
+    char key[HASHKEYSIZE];
+    makeReservationKey(r.sailingID, r.vehicleLicence, key);
+    if (hashIndexFind(reservationIndex, key) != HASHEMPTY)
     {
-        // Throw an exception if the file is not open
-        throw std::runtime_error("File " + RESERVATIONFILENAME + "is not open.");
+        char text[SAILINGIDSIZE];
+        sailingKeyFormat(r.sailingID, text);
+        throw std::runtime_error(std::string("writeReservation: Reservation ") + text + "|" +
+                                 std::string(r.vehicleLicence, strnlen(r.vehicleLicence, sizeof(r.vehicleLicence))) +
+                                 " already exists.");
     }
 
-    // Read information of the next reservation object in the file
-    reservationFile.read(reinterpret_cast<char *>(&r), sizeof(Reservation));
+    // Write the reservation at the end of the file and index its slot
+    int slot = reservationFile.append(r);
+    hashIndexInsert(reservationIndex, key, slot);
+    sailingSlots[r.sailingID].push_back(slot);
+    bookedCount.fetch_add(1, std::memory_order_relaxed);
+    checkedInCount.fetch_add(r.onBoard ? 1 : 0, std::memory_order_relaxed);
+}
 
-    if (reservationFile.eof())
+// Function writeReservations writes a batch of reservations at the end
+// of the reservation file with one append, then indexes them
+// Throws an exception, writing nothing, if a vehicle is already booked
+// on the same sailing or appears twice for it in the batch
+//----------------------------------------------------------------
+void writeReservations(const std::vector<Reservation>& reservations)
+{
+    METRICSSCOPE("reservation.writeReservations");
+    if (reservations.empty())
     {
-        // Return false if there is no more data to read
-        return false;
+        return;
     }
-
-    if (!reservationFile)
+    RecordLock lock = reservationFile.lockHeader(true);
+    refreshIndexes();
+    int n = static_cast<int>(reservations.size());
+    HashIndex batchKeys; // reservations seen earlier in the batch
+    hashIndexClear(batchKeys, n);
+    char key[HASHKEYSIZE];
+    for (int i = 0; i < n; ++i)
     {
-        // Throw an exception if the file could not be read from
-        throw std::runtime_error("Error reading from file " + RESERVATIONFILENAME + ".");
+        const Reservation& r = reservations[i];
+        makeReservationKey(r.sailingID, r.vehicleLicence, key);
+        if (hashIndexFind(reservationIndex, key) != HASHEMPTY || hashIndexFind(batchKeys, key) != HASHEMPTY)
+        {
+            char text[SAILINGIDSIZE];
+            sailingKeyFormat(r.sailingID, text);
+            throw std::runtime_error(std::string("writeReservations: Reservation ") + text + "|" +
+                                     std::string(r.vehicleLicence, strnlen(r.vehicleLicence, sizeof(r.vehicleLicence))) +
+                                     " already exists.");
+        }
+        hashIndexInsert(batchKeys, key, i);
     }
 
-    return true;
-
+    std::vector<int> slots(reservations.size());
+    reservationFile.appendBatch(reservations.data(), n, slots.data());
+    hashIndexReserve(reservationIndex, reservationIndex.count + n);
+    for (int i = 0; i < n; ++i)
+    {
+        const Reservation& r = reservations[i];
+        makeReservationKey(r.sailingID, r.vehicleLicence, key);
+        hashIndexInsert(reservationIndex, key, slots[i]);
+        sailingSlots[r.sailingID].push_back(slots[i]);
+        checkedInCount.fetch_add(r.onBoard ? 1 : 0, std::memory_order_relaxed);
+    }
+    bookedCount.fetch_add(n, std::memory_order_relaxed);
 }
-// Function writeReservation writes to reservation file
-// Throws an exception if it fails
-// Returns true if more reservations exist, false if we've shown all
+
+// Function findReservation looks up the reservation with the provided
+// sailingID and vehicleLicence through the hash index
+// Returns its slot and copies the record into r, or -1 if not found
 //----------------------------------------------------------------
-void writeReservation(const Reservation& r)
+int findReservation(SailingKey sailingID, const char vehicleLicence[], Reservation& r)
 {
-//throw exception if file not opened
-   if (!reservationFile.is_open())
+    METRICSSCOPE("reservation.findReservation");
+    if (!reservationFile.isOpen())
     {
-        // Throw an exception if the file is not open
         throw std::runtime_error("File " + RESERVATIONFILENAME + "is not open.");
     }
-    // Write information of the reservation object at the end 
-    reservationFile.clear();
-    reservationFile.seekp(0, std::ios::end); // Move to the end of the file
-    reservationFile.write(reinterpret_cast<const char *>(&r), sizeof(Reservation));
-    
-    if (!reservationFile)
+    RecordLock lock = reservationFile.lockHeader(false);
+    refreshIndexes();
+    char key[HASHKEYSIZE];
+    makeReservationKey(sailingID, vehicleLicence, key);
+    int slot = hashIndexFind(reservationIndex, key);
+    if (slot == HASHEMPTY)
     {
-        // Throw an exception if the file could not be written to
-        throw std::runtime_error("Error writing to file " + RESERVATIONFILENAME + ".");
+        return -1;
     }
+    reservationFile.readAt(slot, r);
+    return slot;
 }
 
-// Function closes reservation file
+// Function updateReservation overwrites the reservation stored in slot
+// The sailingID and vehicleLicence of the record must not change
+// Throws an exception if the slot is invalid or the write fails
 //----------------------------------------------------------------
-void reservationClose()
+void updateReservation(int slot, const Reservation& r)
 {
-
-     if (reservationFile.is_open())
+    METRICSSCOPE("reservation.updateReservation");
+    if (!reservationFile.isOpen())
     {
-        reservationFile.close();
+        throw std::runtime_error("File " + RESERVATIONFILENAME + "is not open.");
     }
-    else
+    RecordLock lock = reservationFile.lockHeader(false);
+    refreshIndexes();
+    char key[HASHKEYSIZE];
+    makeReservationKey(r.sailingID, r.vehicleLicence, key);
+    if (slot < 0 || hashIndexFind(reservationIndex, key) != slot)
     {
-        // Throw an exception if the file was already closed
-        throw std::runtime_error("File " + RESERVATIONFILENAME + "was already closed.");
+        throw std::runtime_error("updateReservation: Record does not match slot.");
     }
+    bool wasOnBoard = reservationFile.at(slot).onBoard;
+    reservationFile.writeAt(slot, r);
+    checkedInCount.fetch_add((r.onBoard ? 1 : 0) - (wasOnBoard ? 1 : 0), std::memory_order_relaxed);
+}
+
+// Function closes reservation file
+//----------------------------------------------------------------
+void reservationClose()
+{
+    METRICSSCOPE("reservation.reservationClose");
+    reservationFile.close();
+    bookedCount.store(0, std::memory_order_relaxed);
+    checkedInCount.store(0, std::memory_order_relaxed);
 }
 
 // Function deleteReservation deletes a reservation with the provided
 // sailingID and vehicleLicence. Throws an exception if the record is not found.
 //----------------------------------------------------------------
-void deleteReservation(char sailingID[], char vehicleLicence[])
+void deleteReservation(SailingKey sailingID, const char vehicleLicence[])
 {
-    if (!reservationFile.is_open()) 
+    METRICSSCOPE("reservation.deleteReservation");
+    if (!reservationFile.isOpen()) 
     {
         throw std::runtime_error("deleteReservation: File not open.");
     }
+    RecordLock lock = reservationFile.lockHeader(true);
+    refreshIndexes();
     
-    // Get total records
-    reservationFile.clear();
-    reservationFile.seekg(0, std::ios::end);
-    std::streampos size = reservationFile.tellg();
-    int total = static_cast<int>(size / sizeof(Reservation));
-    if (total == 0)
+    if (reservationFile.liveCount() == 0)
     {
         throw std::runtime_error("deleteReservation: No records to delete");
     }
 
     // Find target index (checking BOTH sailingID AND vehicleLicence)
-    reservationFile.seekg(0, std::ios::beg);
-    int target = -1;
-    Reservation temp;
-    Reservation lastRecord;
-    
-    for (int i = 0; i < total; ++i) 
-    {
-        reservationFile.read(reinterpret_cast<char*>(&temp), sizeof(Reservation));
-        if (std::strncmp(temp.sailingID, sailingID, sizeof(temp.sailingID)) == 0 &&
-            std::strncmp(temp.vehicleLicence, vehicleLicence, sizeof(temp.vehicleLicence)) == 0) {
-            target = i;
-            break;
-        }
-    }
+    char key[HASHKEYSIZE];
+    makeReservationKey(sailingID, vehicleLicence, key);
+    int target = hashIndexFind(reservationIndex, key);
     
     if (target < 0) 
     {
+        char text[SAILINGIDSIZE];
+        sailingKeyFormat(sailingID, text);
         throw std::runtime_error(std::string("deleteReservation: Reservation with sailingID '") + 
-                               sailingID + "' and vehicleLicence '" + vehicleLicence + "' not found");
+                               text + "' and vehicleLicence '" + vehicleLicence + "' not found");
     }
 
-    // Get last record
-    reservationFile.seekg((total - 1) * sizeof(Reservation), std::ios::beg);
-    reservationFile.read(reinterpret_cast<char*>(&lastRecord), sizeof(Reservation));
-    if (reservationFile.fail()) 
+    // Drop the target from both indexes and leave a tombstone in its slot
+    hashIndexErase(reservationIndex, key);
+    unlinkSailingSlot(sailingID, target);
+    bool wasOnBoard = reservationFile.at(target).onBoard;
+    reservationFile.removeAt(target);
+    bookedCount.fetch_sub(1, std::memory_order_relaxed);
+    checkedInCount.fetch_sub(wasOnBoard ? 1 : 0, std::memory_order_relaxed);
+    scheduleCompaction();
+}
+
+// Function countReservations returns the number of reservations
+// booked on the provided sailing
+//----------------------------------------------------------------
+int countReservations(SailingKey sailingID)
+{
+    METRICSSCOPE("reservation.countReservations");
+    RecordLock lock = reservationFile.lockHeader(false);
+    refreshIndexes();
+    auto it = sailingSlots.find(sailingID);
+    return it == sailingSlots.end() ? 0 : static_cast<int>(it->second.size());
+}
+
+// Function getSailingReservations copies every reservation booked on
+// the provided sailing into out. Returns the number copied
+//----------------------------------------------------------------
+int getSailingReservations(SailingKey sailingID, std::vector<Reservation>& out)
+{
+    METRICSSCOPE("reservation.getSailingReservations");
+    if (!reservationFile.isOpen())
+    {
+        throw std::runtime_error("File " + RESERVATIONFILENAME + "is not open.");
+    }
+    RecordLock lock = reservationFile.lockHeader(false);
+    refreshIndexes();
+    out.clear();
+    auto it = sailingSlots.find(sailingID);
+    if (it == sailingSlots.end())
     {
-        throw std::runtime_error("deleteReservation: Failed reading last record");
+        return 0;
     }
-
-    // Overwrite target slot with last record
-    reservationFile.seekp(target * sizeof(Reservation), std::ios::beg);
-    reservationFile.write(reinterpret_cast<const char*>(&lastRecord), sizeof(Reservation));
-    if (reservationFile.fail()) 
+    out.resize(it->second.size());
+    for (std::size_t i = 0; i < it->second.size(); ++i)
     {
-        throw std::runtime_error("deleteReservation: Overwrite failed");
+        reservationFile.readAt(it->second[i], out[i]);
     }
+    return static_cast<int>(out.size());
+}
 
-    // Truncate file (platform-specific)
-#ifdef _WIN32
+// Function deleteSailingReservations deletes every reservation booked
+// on the provided sailing, leaving tombstones that later writes reuse
+// and scheduled compaction steps reclaim, as deleteReservation does
+// Returns the number of reservations removed
+//----------------------------------------------------------------
+int deleteSailingReservations(SailingKey sailingID)
+{
+    METRICSSCOPE("reservation.deleteSailingReservations");
+    if (!reservationFile.isOpen())
     {
-        reservationFile.flush();
-        reservationFile.close();
-        FILE* f = std::fopen(RESERVATIONFILENAME.c_str(), "r+b");
-        if (!f) 
-        {
-            throw std::runtime_error("deleteReservation: file open failed");
-        }
-        int fd = _fileno(f);
-        long newSize = static_cast<long>((total - 1) * sizeof(Reservation));
-        if (_chsize_s(fd, newSize) != 0) 
-        {
-            std::fclose(f);
-            throw std::runtime_error("deleteReservation: truncate failed");
-        }
-        std::fclose(f);
+        throw std::runtime_error("deleteSailingReservations: File not open.");
     }
-#else
+    RecordLock lock = reservationFile.lockHeader(true);
+    refreshIndexes();
+    auto it = sailingSlots.find(sailingID);
+    if (it == sailingSlots.end())
     {
-        reservationFile.close();
-        int fd = ::open(RESERVATIONFILENAME.c_str(), O_RDWR);
-        if (fd < 0) 
-        {
-            throw std::runtime_error("deleteReservation: open failed");
-        }
-        off_t newSize = static_cast<off_t>((total - 1) * sizeof(Reservation));
-        if (ftruncate(fd, newSize) != 0) 
-        {
-            ::close(fd);
-            throw std::runtime_error("deleteReservation: truncate failed");
-        }
-        ::close(fd);
+        return 0;
     }
-#endif
+    std::vector<int> slots;
+    slots.swap(it->second);
+    sailingSlots.erase(it);
 
-    // Reopen file
-    reservationFile.open(RESERVATIONFILENAME,
-                       std::ios::in | std::ios::out | std::ios::binary);
-    if (!reservationFile.is_open()) {
-        throw std::runtime_error("deleteReservation: re-open failed");
+    WalBatch batch; // commit the tombstones together
+    char key[HASHKEYSIZE];
+    for (int slot : slots)
+    {
+        const Reservation& r = reservationFile.at(slot);
+        makeReservationKey(r.sailingID, r.vehicleLicence, key);
+        hashIndexErase(reservationIndex, key);
+        checkedInCount.fetch_sub(r.onBoard ? 1 : 0, std::memory_order_relaxed);
+        reservationFile.removeAt(slot);
     }
-}
\ No newline at end of file
+    bookedCount.fetch_sub(static_cast<int>(slots.size()), std::memory_order_relaxed);
+    scheduleCompaction(); // at most COMPACTSTEP moves, like any other delete
+    return static_cast<int>(slots.size());
+}
+
+// Function reservationCompact moves at most maxMoves reservations from
+// the end of the file into free slots and truncates the file
+// Returns the number of tombstones left in the file
+//----------------------------------------------------------------
+int reservationCompact(int maxMoves)
+{
+    METRICSSCOPE("reservation.reservationCompact");
+    return reservationFile.compact(maxMoves, reindexMovedReservation);
+}
+
+// Function reservationCounts copies the number of reservations, and of
+// those checked in, into booked and checkedIn. The counts are kept up
+// to date by every change, so any thread may call it without a lock
+//----------------------------------------------------------------
+void reservationCounts(int& booked, int& checkedIn)
+{
+    booked = bookedCount.load(std::memory_order_relaxed);
+    checkedIn = checkedInCount.load(std::memory_order_relaxed);
+}
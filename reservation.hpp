@@ -15,15 +15,19 @@
 * Should call the init() function before any
 * operations
 * 
-* Design Issues: Using linear search for all traversal and deletions
-* Must be on a system able to use fstream
+* Design Issues: Point lookups and deletions use a hash index on
+* (sailingID, vehicleLicence); per-sailing counts, listings and bulk
+* deletions use a sailingID -> slots index
+* Storage is a RecordFile<Reservation>, see recordFile.hpp
 * Fixed-length records may waste space
 */
 //================================================================
 
 #pragma once
+#include "sailingKey.hpp"
 #include <iostream>
 #include <string>
+#include <vector>
 using std::endl; 
 using std::cout;
 using std::string;
@@ -35,7 +39,7 @@ using std::string;
 struct Reservation
 {
 
-char sailingID[9]; // 9 digit sailing id
+SailingKey sailingID; // Packed ttt-dd-hh sailing ID, see sailingKey.hpp
 char vehicleLicence[10]; // Unique vehicle licence, consisting of 6-10 characters
 bool onBoard; // Specifies if a reservation has checked in
 bool isLRL; // Specifies which section of the sailing the vehicle is to be parked
@@ -57,13 +61,33 @@ void reservationReset();
 // Returns a boolean if the data is successfully read
 // Throws an exception if there is an error with reading the files
 //----------------------------------------------------------------
-bool getNextReservation(Reservation r);
+bool getNextReservation(Reservation& r);
 
 // Function writeReservation writes to reservation file
-// Throws an exception if it fails
+// Throws an exception if it fails or if the vehicle is already
+// booked on the same sailing
 //----------------------------------------------------------------
 void writeReservation(const Reservation& r);
 
+// Function writeReservations writes a batch of reservations with one
+// append
+// Throws an exception, writing nothing, if a vehicle is already booked
+// on the same sailing or appears twice for it in the batch
+//----------------------------------------------------------------
+void writeReservations(const std::vector<Reservation>& reservations);
+
+// Function findReservation looks up the reservation with the provided
+// sailingID and vehicleLicence through the hash index
+// Returns its slot and copies the record into r, or -1 if not found
+//----------------------------------------------------------------
+int findReservation(SailingKey sailingID, const char vehicleLicence[], Reservation& r);
+
+// Function updateReservation overwrites the reservation stored in slot
+// The sailingID and vehicleLicence of the record must not change
+// Throws an exception if the slot is invalid or the write fails
+//----------------------------------------------------------------
+void updateReservation(int slot, const Reservation& r);
+
 
 // Function closes reservation file
 //----------------------------------------------------------------
@@ -72,4 +96,33 @@ void reservationClose();
 // Function deleteReservation deletes a reservation with the provided
 // sailingID and vehicleLicence. Throws an exception if the record is not found.
 //----------------------------------------------------------------
-void deleteReservation(char sailingID[], char vehicleLicence[]);
\ No newline at end of file
+void deleteReservation(SailingKey sailingID, const char vehicleLicence[]);
+
+// Function countReservations returns the number of reservations
+// booked on the provided sailing
+//----------------------------------------------------------------
+int countReservations(SailingKey sailingID);
+
+// Function getSailingReservations copies every reservation booked on
+// the provided sailing into out. Returns the number copied
+//----------------------------------------------------------------
+int getSailingReservations(SailingKey sailingID, std::vector<Reservation>& out);
+
+// Function deleteSailingReservations deletes every reservation booked
+// on the provided sailing, leaving tombstones that later writes reuse
+// and scheduled compaction steps reclaim, as deleteReservation does
+// Returns the number of reservations removed
+//----------------------------------------------------------------
+int deleteSailingReservations(SailingKey sailingID);
+
+// Function reservationCompact moves at most maxMoves reservations from
+// the end of the file into free slots and truncates the file
+// Returns the number of tombstones left in the file
+//----------------------------------------------------------------
+int reservationCompact(int maxMoves);
+
+// Function reservationCounts copies the number of reservations, and of
+// those checked in, into booked and checkedIn. The counts are kept up
+// to date by every change, so any thread may call it without a lock
+//----------------------------------------------------------------
+void reservationCounts(int& booked, int& checkedIn);
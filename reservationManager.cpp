@@ -11,16 +11,20 @@
 * Reservation System, being the module that manages sailing, vehicle, and
 * reservation module functions
 * 
-* Design Issues: Using linear search for all traversal and deletions
+* Design Issues: Check-in and single deletions use the reservation
+* hash index; per-sailing counts and bulk deletions use the sailing index
 */
 //================================================================
 #include "reservationManager.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
 #include "vehicle.hpp"
 #include "reservation.hpp"
 #include "sailingManager.hpp"
 #include <cstring>
 #include <cctype>
 #include <cstdio>
+#include <stdexcept>
 #include <vector>
 #ifdef _WIN32
   #include <io.h>      
@@ -34,6 +38,7 @@
 //----------------------------------------------------------------
 void accessSailingManagerUpdate(char sailingID[])
 {
+    METRICSSCOPE("reservationManager.accessSailingManagerUpdate");
     try
     {
         // First verify the sailing exists
@@ -51,7 +56,7 @@ void accessSailingManagerUpdate(char sailingID[])
     }
     catch (const std::exception& e)
     {
-        std::cerr << "Error updating sailing: " << e.what() << std::endl;
+        LOGWRITE(LOGERROR, "reservationManager.accessSailingManagerUpdate", {"sailing", sailingID}, {"error", e.what()});
         throw; // Re-throw for calling function to handle
     }
 }
@@ -60,6 +65,7 @@ void accessSailingManagerUpdate(char sailingID[])
 //----------------------------------------------------------------
 void accessSailingManagerQuery(char sailingID[])
 {
+    METRICSSCOPE("reservationManager.accessSailingManagerQuery");
     try
     {
         // Verify sailing exists
@@ -70,17 +76,17 @@ void accessSailingManagerQuery(char sailingID[])
             
             // Show reservation count
             int reservations = viewReservations(sailingID);
-            std::cout << "Total reservations: " << reservations << std::endl;
+            std::cout << "Total reservations: " << reservations << '\n';
             
             // Show vessel capacity
             char* vessel = getVessel(); // Gets vessel for this sailing
             int capacity = getVesselLength(vessel);
-            std::cout << "Vessel capacity: " << capacity << " meters" << std::endl;
+            std::cout << "Vessel capacity: " << capacity << " meters\n";
         }
     }
     catch (const std::exception& e)
     {
-        std::cerr << "Error querying sailing: " << e.what() << std::endl;
+        LOGWRITE(LOGERROR, "reservationManager.accessSailingManagerQuery", {"sailing", sailingID}, {"error", e.what()});
         throw; // Re-throw for calling function to handle
     }
 }
@@ -89,18 +95,10 @@ void accessSailingManagerQuery(char sailingID[])
 //----------------------------------------------------------------
 void vehicleCheck(char vehicleLicence[])
 {
-    //check if vehicle exists
-    bool vehicleExists = false;
+    METRICSSCOPE("reservationManager.vehicleCheck");
+    //check if vehicle exists through the licence index
     Vehicle v;
-    //resets vehicle to start of list
-    vehicleReset();
-    //find the vehicle
-    while (getNextVehicle(v)) {
-        if (strcmp(v.vehicleLicence, vehicleLicence) == 0) {
-            vehicleExists = true;
-            break;
-        }
-    }
+    bool vehicleExists = findVehicle(vehicleLicence, v) >= 0;
     if (!vehicleExists) {
         // Vehicle doesn't exist - create new record
         Vehicle newVehicle;
@@ -152,11 +150,11 @@ void vehicleCheck(char vehicleLicence[])
         // Write the new vehicle to file
         writeVehicle(newVehicle);
         
-        std::cout << "New vehicle record created." << std::endl;
+        std::cout << "New vehicle record created.\n";
     }
     else
     {
-        std::cout << "Vehicle found in system." << std::endl;
+        std::cout << "Vehicle found in system.\n";
     }
 
 }
@@ -164,6 +162,7 @@ void vehicleCheck(char vehicleLicence[])
 // with the corresponding licence plate on the specified sailing
 //----------------------------------------------------------------
 void createReservation(char sailingID[], char vehicleLicence[]){
+    METRICSSCOPE("reservationManager.createReservation");
     char phoneNumber[14];
     float vehicleLength, vehicleHeight;
 
@@ -227,70 +226,14 @@ void createReservation(char sailingID[], char vehicleLicence[]){
     }
     cout << "Valid height\n";
 
+    SailingKey newKey = SAILINGKEYNONE;
     while(true)
     {
         cout << "Enter the Sailing ID (Format: ttt-dd-hh):\n";
         std::cin >> sailingID;
         
-        // Check length first (should be exactly 9 characters: 3 + 1 + 2 + 1 + 2)
-        if(strlen(sailingID) != 9)
-        {
-            cout << "Error: ID must be exactly 9 characters (Format: ttt-dd-hh)\n";
-            continue;
-        }
-        
-        // Check format ttt-dd-hh
-        bool valid = true;
-        
-        // Check first 3 characters are letters
-        for(int i = 0; i < 3; i++)
-        {
-            if(!isalpha(sailingID[i]))
-            {
-                valid = false;
-                break;
-            }
-        }
-        
-        // Check 4th character is dash
-        if(valid && sailingID[3] != '-')
-        {
-            valid = false;
-        }
-        
-        // Check positions 5-6 are digits (index 4-5)
-        if(valid)
-        {
-            for(int i = 4; i < 6; i++)
-            {
-                if(!isdigit(sailingID[i]))
-                {
-                    valid = false;
-                    break;
-                }
-            }
-        }
-        
-        // Check 7th character is dash
-        if(valid && sailingID[6] != '-')
-        {
-            valid = false;
-        }
-        
-        // Check positions 8-9 are digits (index 7-8)
-        if(valid)
-        {
-            for(int i = 7; i < 9; i++)
-            {
-                if(!isdigit(sailingID[i]))
-                {
-                    valid = false;
-                    break;
-                }
-            }
-        }
-        
-        if(valid)
+        // The sailing ID must have the form ttt-dd-hh: 3 letters, day and hour
+        if(sailingKeyParse(sailingID, newKey))
         {
             break; // Valid format
         } else
@@ -301,8 +244,7 @@ void createReservation(char sailingID[], char vehicleLicence[]){
     // Create new reservation 
     Reservation newRes;
 
-    strncpy(newRes.sailingID, sailingID, sizeof(newRes.sailingID) - 1);
-    newRes.sailingID[sizeof(newRes.sailingID) - 1] = '\0'; 
+    newRes.sailingID = newKey;
 
     strncpy(newRes.vehicleLicence, vehicleLicence, sizeof(newRes.vehicleLicence) - 1);
     newRes.vehicleLicence[sizeof(newRes.vehicleLicence) - 1] = '\0';  
@@ -310,8 +252,17 @@ void createReservation(char sailingID[], char vehicleLicence[]){
     newRes.onBoard = false;
     newRes.isLRL = false;
 
+    // Reject a second booking of the same vehicle on the same sailing
+    Reservation existing;
+    if (findReservation(newRes.sailingID, newRes.vehicleLicence, existing) >= 0)
+    {
+        throw std::runtime_error(std::string("Reservation for ") + newRes.vehicleLicence + " already exists.");
+    }
+
     // Add to file
     writeReservation(newRes);  
+    LOGWRITE(LOGDEBUG, "reservationManager.createReservation", {"sailing", sailingID}, {"vehicle", vehicleLicence},
+             {"length", static_cast<double>(vehicleLength)});
 }
 // Function deleteReservations with parameters sailingID, vehicleLicence
 // deletes a reservation on the specified sailing
@@ -319,82 +270,46 @@ void createReservation(char sailingID[], char vehicleLicence[]){
 //----------------------------------------------------------------
 void deleteReservations(char sailingID[], char vehicleLicence[])
 {
-    deleteReservation(sailingID, vehicleLicence);
+    METRICSSCOPE("reservationManager.deleteReservations[vehicle]");
+    deleteReservation(sailingKeyEncode(sailingID), vehicleLicence);
 }
 // Function deleteReservations with single parameter sailingID
 // deletes all reservations on the specified sailing
+// Returns the number of reservations removed
 //----------------------------------------------------------------
-void deleteReservations(char sailingID[])
+int deleteReservations(char sailingID[])
 {
-    std::vector<Reservation> all;
-    reservationReset();
-    Reservation r;
-    
-    // Read all reservations
-    while (getNextReservation(r))
-    {
-        all.push_back(r);
-    }
-    reservationClose();
-
-    bool found = false;
-    std::vector<Reservation> remaining;  // Will store reservations to keep
-    
-    // Filter out reservations to delete
-    for (auto& rec : all)
-    {
-        if (std::strcmp(rec.sailingID, sailingID) == 0)
-        {
-            found = true;  // Mark that we found at least one matching reservation
-        } else
-        {
-            remaining.push_back(rec);  // Keep reservations that don't match
-        }
-    }
-
-    if (!found)
+    METRICSSCOPE("reservationManager.deleteReservations[sailing]");
+    // Only the slots of this sailing are cleared, the file is compacted once
+    int removed = deleteSailingReservations(sailingKeyEncode(sailingID));
+    if (removed == 0)
     {
         throw std::runtime_error(std::string("Reservation: ") + sailingID + " not found.");
     }
-
-    // Recreate the file with only non-matching reservations
-    std::remove("reservation.dat");
-    reservationOpen();
-    for (auto& rec : remaining)
-    {
-        writeReservation(rec);
-    }
-    reservationClose();
+    return removed;
 }
-int viewReservations(char sailingID[]) {
-
-    reservationReset();
-    Reservation r;
-    int count = 0;
-    while (getNextReservation(r)) {
-        if (strncmp(r.sailingID, sailingID, sizeof(r.sailingID)) == 0) {
-            count++;
-        }
-    }
-
-    return count;
+// Function viewReservations returns the number of reservations for a sailing
+//----------------------------------------------------------------
+int viewReservations(char sailingID[])
+{
+    METRICSSCOPE("reservationManager.viewReservations");
+    return countReservations(sailingKeyEncode(sailingID));
 }
 // Function checkIn() sets the status of specified reservation as checked in
 //----------------------------------------------------------------
 float checkIn(char sailingID[], char vehicleLicence[])
 {
+    METRICSSCOPE("reservationManager.checkIn");
     float fare = 0;
-    //loops through the file, if it matches, return true, else it will automatically be false
+    // Look up the reservation through the index and mark it as on board
     Reservation r;
-    reservationReset();
-    while (getNextReservation(r))
+    int slot = findReservation(sailingKeyEncode(sailingID), vehicleLicence, r);
+    if (slot < 0)
     {
-        if (strcmp(r.sailingID, sailingID) == 0 && strcmp(r.vehicleLicence, vehicleLicence) == 0)
-        {
-            r.onBoard = true;
-            break;
-        }
+        throw std::runtime_error("Reservation not found for check in.");
     }
+    r.onBoard = true;
+    updateReservation(slot, r);
     if(r.isLRL == true){
         fare = 14;
         return fare;
@@ -424,6 +339,4 @@ float checkIn(char sailingID[], char vehicleLicence[])
                 fare = (length * 2) + (height * 3);
                 return fare;
     }
-    throw std::runtime_error("Reservation not found for check in.");
-    return 0; //unreachable
 }
@@ -44,8 +44,9 @@ void createReservation(char sailingID[], char vehicleLicence[]);
 void deleteReservations(char sailingID[], char vehicleLicence[]);
 // Function deleteReservations with single parameter sailingID
 // deletes all reservations on the specified sailing
+// Returns the number of reservations removed
 //----------------------------------------------------------------
-void deleteReservations(char sailingID[]);
+int deleteReservations(char sailingID[]);
 // Function viewReservations returns the number of reservations for a sailing
 int viewReservations(char sailingID[]);
 // Function checkIn() sets the status of specified reservation as checked in
@@ -15,70 +15,419 @@
  * Should close and open the file once
  * Should call the init() function before any
  * operations
- * Design Issues: Using linear locate sailing records
- * Must be on a system able to use fstream
+ * Design Issues: Sailings are located by binary search in a table of
+ * (sailing key, slot) pairs sorted by key, built at open and kept
+ * sorted on every insert, delete and compaction move. Keys sort by
+ * terminal, day and hour, so a terminal's day is one contiguous range
+ * In shared mode each call locks the file header and refreshes the
+ * table if another process changed the file; updates lock only the
+ * record they change, see modifySailing
+ * The remaining lengths of every sailing are also kept in memory as
+ * fixed-point counters, one cache line each, that bookings change
+ * with a compare-and-swap and no lock; see reserveSailingSpace.
+ * Reads see the counters, and sailingFlushCapacity writes the ones
+ * that changed back to the file. In shared mode the file is the only
+ * copy and bookings lock the record instead
+ * A crash can lose counters flushed after the reservations they
+ * follow were committed, or the other way round, so at open the
+ * caller puts each sailing's lengths right from its reservations
+ * with sailingRestoreCapacity; the lengths of a sailing always add
+ * up to its vessel's, and the high one is what is booked on it
+ * Listings and reports read a snapshot: an immutable copy of every
+ * sailing, shared by readers until a sailing changes, so they never
+ * use the file's read position and writers never wait for them
+ * Storage is a RecordFile<Sailing>, see recordFile.hpp; a file from
+ * before the header was added is converted at open
  * Fixed-length records may waste space
  */
 
 //================================================================
 #include "sailing.hpp"
-#include <fstream>
+#include "metrics.hpp"
+#include "recordFile.hpp"
+#include "mappedFile.hpp"
 #include <stdexcept>
 #include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <cstdio>
-#ifdef _WIN32
-	#include <io.h>      
-#else
-	#include <unistd.h>  
-	#include <fcntl.h>
-#endif
-static std::fstream sailingFile;
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+//================================================================
+// Struct: SailingSpace
+// Purpose: Remaining lengths of one sailing in centimetres, low lane in
+// the upper and high lane in the lower half of one word so a single
+// compare-and-swap changes both. A cache line each, so bookings on
+// different sailings do not contend
+//----------------------------------------------------------------
+struct alignas(64) SailingSpace
+{
+	std::atomic<uint64_t> lengths{0};     // packed low and high remaining length
+	std::atomic<uint32_t> changes{0};     // bumped after every change of lengths
+	std::atomic<bool> deleted{false};     // the sailing has been deleted
+	uint32_t flushed = 0;                 // changes already written to the file
+	SailingKey sailingID = SAILINGKEYNONE;
+};
+
+// Struct: SpaceTable
+// Purpose: Open addressing table of SailingSpace pointers by sailingID
+// Lookups read it without a lock; it is replaced, never changed in
+// place, when it grows
+//----------------------------------------------------------------
+struct SpaceTable
+{
+	std::size_t size;                                       // power of two
+	std::unique_ptr<std::atomic<SailingSpace*>[]> entries;  // null if free
+};
+
+// Struct: LegacySailing
+// Purpose: A sailing as written before the file had a header, with the
+// sailing ID as text
+//----------------------------------------------------------------
+struct LegacySailing
+{
+	char sailingID[SAILINGIDSIZE];
+	char vesselName[26];
+	float lowRemainingLength;
+	float highRemainingLength;
+};
+static_assert(sizeof(LegacySailing) == 44, "sailings were 44 bytes before the header was added");
+
+// Function convertLegacySailing converts one such sailing
+// Throws an exception if its sailing ID is not in the form ttt-dd-hh
+//----------------------------------------------------------------
+static void convertLegacySailing(const char old[], Sailing& s)
+{
+	LegacySailing legacy;
+	std::memcpy(&legacy, old, sizeof(legacy));
+	legacy.sailingID[SAILINGIDSIZE - 1] = '\0';
+	s.sailingID = sailingKeyEncode(legacy.sailingID);
+	std::memcpy(s.vesselName, legacy.vesselName, sizeof(s.vesselName));
+	s.vesselName[sizeof(s.vesselName) - 1] = '\0';
+	s.lowRemainingLength = legacy.lowRemainingLength;
+	s.highRemainingLength = legacy.highRemainingLength;
+}
+
 static const std::string sailingFileName = "sailings.dat";
+static RecordFile<Sailing> sailingFile(sailingFileName, sizeof(LegacySailing), convertLegacySailing);
+static const int COMPACTMINDEAD = 64; // tombstones needed before compaction is scheduled
+static const int COMPACTSTEP = 1024;  // records moved per scheduled compaction step
+static std::vector<std::pair<SailingKey, int>> sailingIndex; // (sailingID, slot) sorted by sailingID
+static const std::size_t SPACETABLEMIN = 64;  // smallest capacity table
+static const float CENTIMETRES = 100.0f;      // fixed-point scale of the counters
+static std::deque<SailingSpace> spaces;       // counters, never moved while open
+static std::atomic<SpaceTable*> spaceTable{nullptr}; // table used by lookups
+static std::vector<std::unique_ptr<SpaceTable>> spaceTables; // current and replaced tables
+static std::size_t spaceUsed = 0;              // entries in the current table
+static std::atomic<uint64_t> sailingVersion{1}; // bumped by every change to a record
+static std::mutex snapshotMutex;               // one snapshot is built at a time
+static SailingSnapshot snapshot;               // latest snapshot, under snapshotMutex
+static uint64_t snapshotVersion = 0;           // sailingVersion it was taken at
+static uint64_t snapshotChanges = 0;           // spaceChanges it was taken at
 
 //================================================================
 
-// Function open creates and opens the Sailing file
-// Throws an exception if the file cannot be opened
+// Function lowerEntry returns the first index entry whose key is not
+// less than sailingID
 //----------------------------------------------------------------
-void sailingOpen()
+static std::vector<std::pair<SailingKey, int>>::iterator lowerEntry(SailingKey sailingID)
+{
+	return std::lower_bound(sailingIndex.begin(), sailingIndex.end(), std::make_pair(sailingID, -1));
+}
+
+// Function findSailingSlot returns the slot of the sailing with the
+// provided sailingID, or -1 if there is none
+//----------------------------------------------------------------
+static int findSailingSlot(SailingKey sailingID)
+{
+	auto it = lowerEntry(sailingID);
+	return (it != sailingIndex.end() && it->first == sailingID) ? it->second : -1;
+}
+
+// Function reindexMovedSailing points the index entry of the sailing
+// moved by compaction from slot from to slot to
+//----------------------------------------------------------------
+static void reindexMovedSailing(int from, int to)
+{
+	auto it = lowerEntry(sailingFile.at(to).sailingID);
+	if (it != sailingIndex.end() && it->second == from)
+	{
+		it->second = to;
+	}
+}
+
+// Function packLengths returns the counter word of the remaining lengths
+//----------------------------------------------------------------
+static uint64_t packLengths(float low, float high)
+{
+	uint32_t lowCm = static_cast<uint32_t>(static_cast<int32_t>(std::lround(low * CENTIMETRES)));
+	uint32_t highCm = static_cast<uint32_t>(static_cast<int32_t>(std::lround(high * CENTIMETRES)));
+	return (static_cast<uint64_t>(lowCm) << 32) | highCm;
+}
+
+// Function lowCentimetres returns the low remaining length of a counter word
+//----------------------------------------------------------------
+static int32_t lowCentimetres(uint64_t lengths)
+{
+	return static_cast<int32_t>(static_cast<uint32_t>(lengths >> 32));
+}
+
+// Function highCentimetres returns the high remaining length of a counter word
+//----------------------------------------------------------------
+static int32_t highCentimetres(uint64_t lengths)
+{
+	return static_cast<int32_t>(static_cast<uint32_t>(lengths));
+}
+
+// Function spaceHome returns the first table position to probe for sailingID
+//----------------------------------------------------------------
+static std::size_t spaceHome(SailingKey sailingID, std::size_t size)
+{
+	// sailings differ mostly in their high bits, mix them down
+	return static_cast<std::size_t>((sailingID * 0x9E3779B97F4A7C15ull) >> 32) & (size - 1);
+}
+
+// Function findSpace returns the counters of a sailing, or nullptr if
+// there are none. Safe to call while another thread adds sailings
+//----------------------------------------------------------------
+static SailingSpace* findSpace(SailingKey sailingID)
+{
+	SpaceTable* table = spaceTable.load(std::memory_order_acquire);
+	if (table == nullptr)
+	{
+		return nullptr;
+	}
+	for (std::size_t i = spaceHome(sailingID, table->size);; i = (i + 1) & (table->size - 1))
+	{
+		SailingSpace* space = table->entries[i].load(std::memory_order_acquire);
+		if (space == nullptr)
+		{
+			return nullptr;
+		}
+		if (space->sailingID == sailingID && !space->deleted.load(std::memory_order_acquire))
+		{
+			return space;
+		}
+	}
+}
+
+// Function placeSpace stores space in the first free position of table
+//----------------------------------------------------------------
+static void placeSpace(SpaceTable& table, SailingSpace* space)
+{
+	std::size_t i = spaceHome(space->sailingID, table.size);
+	while (table.entries[i].load(std::memory_order_relaxed) != nullptr)
+	{
+		i = (i + 1) & (table.size - 1);
+	}
+	table.entries[i].store(space, std::memory_order_release);
+}
+
+// Function newSpaceTable publishes an empty table big enough for
+// twice the live sailings plus one, holding every live counter
+// The replaced table stays allocated for lookups still reading it
+//----------------------------------------------------------------
+static void newSpaceTable()
 {
-	// Try to open the sailing file without overwriting the contents
-	sailingFile.open(sailingFileName, std::ios::in | std::ios::out | std::ios::binary);
-	if (!sailingFile.is_open())
+	std::size_t size = SPACETABLEMIN;
+	while (size < (sailingIndex.size() + 1) * 2)
+	{
+		size *= 2;
+	}
+	std::unique_ptr<SpaceTable> table(new SpaceTable);
+	table->size = size;
+	table->entries.reset(new std::atomic<SailingSpace*>[size]);
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		table->entries[i].store(nullptr, std::memory_order_relaxed);
+	}
+	spaceUsed = 0;
+	for (SailingSpace& space : spaces)
 	{
-		// Try to create a sailing file if it does not exist
-		sailingFile.clear();
-		sailingFile.open(sailingFileName, std::ios::out | std::ios::binary);
-		
-		if (!sailingFile.is_open())
+		if (!space.deleted.load(std::memory_order_relaxed))
 		{
-			// Throw an exception if the file cannot be created
-			throw std::runtime_error("Cannot create " + sailingFileName);
+			placeSpace(*table, &space);
+			spaceUsed++;
 		}
-		sailingFile.close();
+	}
+	spaceTable.store(table.get(), std::memory_order_release);
+	spaceTables.push_back(std::move(table));
+}
 
-		// Try to now re-open the file for reading and writing
-		sailingFile.open(sailingFileName, std::ios::in | std::ios::out | std::ios::binary);
-		if (!sailingFile.is_open())
+// Function addSpace adds the counters of a new sailing
+// Only one thread may add or delete sailings at a time
+//----------------------------------------------------------------
+static void addSpace(const Sailing& s)
+{
+	spaces.emplace_back();
+	SailingSpace& space = spaces.back();
+	space.sailingID = s.sailingID;
+	space.lengths.store(packLengths(s.lowRemainingLength, s.highRemainingLength), std::memory_order_relaxed);
+	SpaceTable* table = spaceTable.load(std::memory_order_relaxed);
+	if (table == nullptr || (spaceUsed + 1) * 2 > table->size)
+	{
+		newSpaceTable(); // includes the new counters
+		return;
+	}
+	placeSpace(*table, &space);
+	spaceUsed++;
+}
+
+// Function showSpace copies the counters of the sailing into s
+//----------------------------------------------------------------
+static void showSpace(Sailing& s)
+{
+	SailingSpace* space = findSpace(s.sailingID);
+	if (space != nullptr)
+	{
+		uint64_t lengths = space->lengths.load(std::memory_order_acquire);
+		s.lowRemainingLength = lowCentimetres(lengths) / CENTIMETRES;
+		s.highRemainingLength = highCentimetres(lengths) / CENTIMETRES;
+	}
+}
+
+// Function moveSpace moves length centimetres of the sailing's low
+// remaining length to its high remaining length with a compare-and-swap
+// (a negative length moves it back). Returns false, changing nothing,
+// if checkLow is set and the low lanes have less than length left
+//----------------------------------------------------------------
+static bool moveSpace(SailingSpace& space, int32_t length, bool checkLow)
+{
+	uint64_t current = space.lengths.load(std::memory_order_relaxed);
+	uint64_t next;
+	do
+	{
+		int32_t low = lowCentimetres(current);
+		if (checkLow && low < length)
 		{
-			// Throw an exception if the file cannot be opened
-			throw std::runtime_error("Cannot open " + sailingFileName);
-		} 
+			return false;
+		}
+		next = (static_cast<uint64_t>(static_cast<uint32_t>(low - length)) << 32) |
+		       static_cast<uint32_t>(highCentimetres(current) + length);
 	}
+	while (!space.lengths.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+	space.changes.fetch_add(1, std::memory_order_release);
+	return true;
+}
+
+// Function clearSpaces removes every counter
+// No other thread may be using the sailing module
+//----------------------------------------------------------------
+static void clearSpaces()
+{
+	spaceTable.store(nullptr, std::memory_order_release);
+	spaceTables.clear();
+	spaces.clear();
+	spaceUsed = 0;
+}
+
+// Function spaceChanges returns the number of changes made to all the
+// counters so far; each counter keeps its own count so bookings on
+// different sailings do not share a cache line
+//----------------------------------------------------------------
+static uint64_t spaceChanges()
+{
+	uint64_t total = 0;
+	for (const SailingSpace& space : spaces)
+	{
+		total += space.changes.load(std::memory_order_acquire);
+	}
+	return total;
+}
+
+// Function changedSailings invalidates the snapshot after a change to
+// a record or the index
+//----------------------------------------------------------------
+static void changedSailings()
+{
+	sailingVersion.fetch_add(1, std::memory_order_release);
+}
+
+// Function buildSpaces makes counters for every indexed sailing, or
+// none in shared mode, where other processes change the records
+//----------------------------------------------------------------
+static void buildSpaces()
+{
+	clearSpaces();
+	if (mappedIsShared())
+	{
+		return;
+	}
+	for (const auto& entry : sailingIndex)
+	{
+		const Sailing& s = sailingFile.at(entry.second);
+		spaces.emplace_back();
+		spaces.back().sailingID = s.sailingID;
+		spaces.back().lengths.store(packLengths(s.lowRemainingLength, s.highRemainingLength), std::memory_order_relaxed);
+	}
+	newSpaceTable();
+}
+
+// Function buildSailingIndex scans the file once and sorts its keys
+//----------------------------------------------------------------
+static void buildSailingIndex()
+{
+	sailingIndex.clear();
+	sailingIndex.reserve(sailingFile.liveCount());
+	for (int slot = 0; slot < sailingFile.count(); ++slot)
+	{
+		if (sailingFile.isLive(slot))
+		{
+			sailingIndex.emplace_back(sailingFile.at(slot).sailingID, slot);
+		}
+	}
+	std::sort(sailingIndex.begin(), sailingIndex.end());
+	buildSpaces();
+	changedSailings();
+}
+
+// Function refreshIndex rebuilds the sorted table if another process
+// has added or deleted sailings since it was built (shared mode)
+// The header lock must be held
+//----------------------------------------------------------------
+static void refreshIndex()
+{
+	if (sailingFile.refresh())
+	{
+		buildSailingIndex();
+	}
+}
+
+// Function open creates and opens the Sailing file
+// Throws an exception if the file cannot be opened
+//----------------------------------------------------------------
+void sailingOpen()
+{
+	METRICSSCOPE("sailing.sailingOpen");
+	// Open the sailing file without overwriting the contents,
+	// creating it if it does not exist
+	sailingFile.open();
+	buildSailingIndex();
 }
 
 // Function close closes the Sailing file
 //----------------------------------------------------------------
 void sailingClose()
 {
-	if (!sailingFile.is_open())
+	METRICSSCOPE("sailing.sailingClose");
+	if (sailingFile.isOpen())
 	{
-		throw std::runtime_error("Close: " + sailingFileName + " File not open.");
+		sailingFlushCapacity();
 	}
 	sailingFile.close();
+	clearSpaces();
+	std::lock_guard<std::mutex> guard(snapshotMutex);
+	snapshot = nullptr;
 }
 
 // Function reset seeks to the beginning of the Sailing file
@@ -86,13 +435,10 @@ void sailingClose()
 //----------------------------------------------------------------
 void sailingReset()
 {
-	if (!sailingFile.is_open())
-	{
-		throw std::runtime_error("Reset: " + sailingFileName + " File not open.");
-	}
-	sailingFile.clear();
-	sailingFile.seekg(0, std::ios::beg); // Set get position to the start of the file
-	sailingFile.seekp(0, std::ios::beg); // Set put position to the start of the file
+	METRICSSCOPE("sailing.sailingReset");
+	RecordLock lock = sailingFile.lockHeader(false);
+	refreshIndex();
+	sailingFile.reset();
 }
 
 // Function getNextSailing obtains a line from the Sailing file
@@ -101,167 +447,480 @@ void sailingReset()
 //----------------------------------------------------------------
 bool getNextSailing(Sailing& s)
 {
-	if (!sailingFile.is_open())
+	METRICSSCOPE("sailing.getNextSailing");
+	if (!sailingFile.getNext(s))
 	{
-		throw std::runtime_error("getNextSailing: File not open.");
-	}
-	sailingFile.read(reinterpret_cast<char*>(&s), sizeof(Sailing));
-	if (static_cast<std::size_t>(sailingFile.gcount()) < sizeof(Sailing))
-	{
-		// if it reaches end of file or partial, then reset the flags 
-		sailingFile.clear();
 		return false;
 	}
+	showSpace(s);
 	return true;
 }
 
 // Function writeSailing writes a sailing record to the Sailing file
-// Throws an exception if the write operation fails
+// Throws an exception if the write operation fails or if a sailing
+// with the same sailingID already exists
 //----------------------------------------------------------------
 void writeSailing(const Sailing& s)
 {
-	if (!sailingFile.is_open())
+	METRICSSCOPE("sailing.writeSailing");
+	RecordLock lock = sailingFile.lockHeader(true);
+	refreshIndex();
+	auto it = lowerEntry(s.sailingID);
+	if (it != sailingIndex.end() && it->first == s.sailingID)
 	{
-		throw std::runtime_error("writeSailing: File not open.");
+		char text[SAILINGIDSIZE];
+		sailingKeyFormat(s.sailingID, text);
+		throw std::runtime_error(std::string("writeSailing: '") + text + "' already exists");
 	}
-	sailingFile.write(reinterpret_cast<const char*>(&s), sizeof(Sailing));
-	if (sailingFile.fail() || sailingFile.bad())
+	int slot = sailingFile.append(s);
+	sailingIndex.insert(it, std::make_pair(s.sailingID, slot));
+	if (!mappedIsShared())
 	{
-		throw std::runtime_error("writeSailing: Failed to write record");
+		addSpace(s);
 	}
-	sailingFile.flush();
+	changedSailings();
 }
 
-// Function checkSailingExists checks if a sailing with the provided
-// sailingID exists. Returns sailingID, otherwise throws exception.
+// Function writeSailings writes a batch of sailings at the end of the
+// Sailing file with one append, then sorts the index once
+// Throws an exception, writing nothing, if a sailingID already exists
+// or appears twice in the batch
 //----------------------------------------------------------------
-int checkSailingExists(const char sailingID[])
+void writeSailings(const std::vector<Sailing>& sailings)
 {
-	sailingReset();
-	Sailing temp;
-	int index = 0;
-	while (getNextSailing(temp))
+	METRICSSCOPE("sailing.writeSailings");
+	if (sailings.empty())
+	{
+		return;
+	}
+	RecordLock lock = sailingFile.lockHeader(true);
+	refreshIndex();
+	std::vector<SailingKey> keys;
+	keys.reserve(sailings.size());
+	for (const Sailing& s : sailings)
+	{
+		keys.push_back(s.sailingID);
+	}
+	std::sort(keys.begin(), keys.end());
+	for (std::size_t i = 0; i < keys.size(); ++i)
+	{
+		auto it = lowerEntry(keys[i]);
+		if ((i > 0 && keys[i - 1] == keys[i]) || (it != sailingIndex.end() && it->first == keys[i]))
+		{
+			char text[SAILINGIDSIZE];
+			sailingKeyFormat(keys[i], text);
+			throw std::runtime_error(std::string("writeSailings: '") + text + "' already exists");
+		}
+	}
+
+	int n = static_cast<int>(sailings.size());
+	std::vector<int> slots(sailings.size());
+	sailingFile.appendBatch(sailings.data(), n, slots.data());
+	sailingIndex.reserve(sailingIndex.size() + sailings.size());
+	for (int i = 0; i < n; ++i)
 	{
-		if (std::strncmp(temp.sailingID,sailingID,sizeof(temp.sailingID)) == 0)
+		sailingIndex.emplace_back(sailings[i].sailingID, slots[i]);
+		if (!mappedIsShared())
 		{
-			return index;
+			addSpace(sailings[i]);
 		}
-	index++;
 	}
-	throw std::runtime_error("checkSailingExists: ID not found");
+	std::sort(sailingIndex.begin(), sailingIndex.end());
+	changedSailings();
 }
 
-// Function deleteSailing deletes a sailing record with the provided
-// sailingID. Throws an exception if the record is not found.
+// Function getSailingRange copies every sailing whose sailingID lies
+// between first and last, inclusive, into out in sailingID order
+// Returns the number copied
 //----------------------------------------------------------------
-void deleteSailing(const char sailingID[])
+int getSailingRange(SailingKey first, SailingKey last, std::vector<Sailing>& out)
 {
-	if (!sailingFile.is_open())
+	METRICSSCOPE("sailing.getSailingRange");
+	if (!sailingFile.isOpen())
 	{
-		throw std::runtime_error("deleteSailing: File not open.");
+		throw std::runtime_error("getSailingRange: File not open.");
 	}
-	//total record
-	sailingFile.clear();
-	sailingFile.seekg(0, std::ios::end);
-	std::streampos size = sailingFile.tellg();
-	int total = static_cast<int>(size / sizeof(Sailing));
-	if (total == 0)
+	RecordLock lock = sailingFile.lockHeader(false);
+	refreshIndex();
+	out.clear();
+	for (auto it = lowerEntry(first); it != sailingIndex.end() && it->first <= last; ++it)
 	{
-		throw std::runtime_error("deleteSailing: No records to delete");
+		Sailing s;
+		sailingFile.readAt(it->second, s);
+		showSpace(s);
+		out.push_back(s);
 	}
+	return static_cast<int>(out.size());
+}
+
+// Function getTerminalDaySailings copies every sailing leaving the
+// terminal (see sailingKeyTerminal) on day into out, by hour
+// Returns the number copied
+//----------------------------------------------------------------
+int getTerminalDaySailings(SailingKey terminal, int day, std::vector<Sailing>& out)
+{
+	METRICSSCOPE("sailing.getTerminalDaySailings");
+	return getSailingRange(sailingKeyMake(terminal, day, 0), sailingKeyMake(terminal, day, SAILINGFIELDMAX), out);
+}
 
-	// FInd target index
-	sailingFile.seekg(0, std::ios::beg);
-	int target = -1;
-	Sailing temp;
-	Sailing lastRecord;
-	for (int i = 0; i < total; ++i)
+// Function readSailingAt copies the sailing record stored in slot into s
+// Throws an exception if the slot does not exist
+//----------------------------------------------------------------
+void readSailingAt(int slot, Sailing& s)
+{
+	METRICSSCOPE("sailing.readSailingAt");
+	RecordLock lock = sailingFile.lockHeader(false);
+	sailingFile.readAt(slot, s);
+	showSpace(s);
+}
+
+// Function writeSailingAt overwrites the sailing record stored in slot
+// with a single positioned write. The sailingID must not change
+// Throws an exception if the slot does not exist
+//----------------------------------------------------------------
+void writeSailingAt(int slot, const Sailing& s)
+{
+	METRICSSCOPE("sailing.writeSailingAt");
+	RecordLock lock = sailingFile.lockHeader(false);
+	RecordLock slotLock = sailingFile.lockSlot(slot, true);
+	Sailing current;
+	sailingFile.readAt(slot, current);
+	if (current.sailingID != s.sailingID)
 	{
-		sailingFile.read(reinterpret_cast<char*>(&temp), sizeof(Sailing));
-		if (std::strncmp(temp.sailingID, sailingID, sizeof(temp.sailingID)) == 0)
+		throw std::runtime_error("writeSailingAt: Record does not match slot.");
+	}
+	sailingFile.writeAt(slot, s);
+	changedSailings();
+}
+
+// Function modifySailing reads the sailing with the provided sailingID,
+// lets change modify it and writes it back, holding the record lock
+// throughout so another process cannot update it in between. If change
+// throws, nothing is written. The sailingID must not change
+// Throws an exception if the record is not found
+//----------------------------------------------------------------
+void modifySailing(SailingKey sailingID, const std::function<void(Sailing&)>& change)
+{
+	METRICSSCOPE("sailing.modifySailing");
+	if (!sailingFile.isOpen())
+	{
+		throw std::runtime_error("modifySailing: File not open.");
+	}
+	RecordLock lock = sailingFile.lockHeader(false);
+	refreshIndex();
+	int slot = findSailingSlot(sailingID);
+	if (slot < 0)
+	{
+		throw std::runtime_error("modifySailing: ID not found");
+	}
+	RecordLock slotLock = sailingFile.lockSlot(slot, true);
+	Sailing s;
+	sailingFile.readAt(slot, s);
+	showSpace(s);
+	Sailing before = s;
+	change(s);
+	if (s.sailingID != sailingID)
+	{
+		throw std::runtime_error("modifySailing: The sailing ID cannot be changed.");
+	}
+	// Lengths changed here go through the counters too, keeping bookings made meanwhile
+	SailingSpace* space = findSpace(sailingID);
+	if (space != nullptr && (s.lowRemainingLength != before.lowRemainingLength ||
+	                         s.highRemainingLength != before.highRemainingLength))
+	{
+		uint64_t current = space->lengths.load(std::memory_order_relaxed);
+		uint64_t next;
+		do
 		{
-			target = i;
-			break;
+			float low = lowCentimetres(current) / CENTIMETRES + s.lowRemainingLength - before.lowRemainingLength;
+			float high = highCentimetres(current) / CENTIMETRES + s.highRemainingLength - before.highRemainingLength;
+			next = packLengths(low, high);
 		}
+		while (!space->lengths.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+		space->changes.fetch_add(1, std::memory_order_release);
 	}
-	sailingFile.seekg((total - 1) * sizeof(Sailing), std::ios::beg);
-	sailingFile.read(reinterpret_cast<char*>(&lastRecord), sizeof(Sailing));
+	sailingFile.writeAt(slot, s);
+	changedSailings();
+}
 
-	if (target < 0)
+// Function reserveSailingSpace takes length meters of the low remaining
+// length of a sailing and adds it to its high remaining length
+// Returns false, changing nothing, if less than length is left
+// Takes no lock: bookings on the same sailing race on a compare-and-swap
+// of its counters, which are written to the file by sailingFlushCapacity
+// Throws an exception if the sailing is not found
+//----------------------------------------------------------------
+bool reserveSailingSpace(SailingKey sailingID, float length)
+{
+	METRICSSCOPE("sailing.reserveSailingSpace");
+	if (mappedIsShared())
 	{
-		throw std::runtime_error(std::string("deleteSailing: '") + sailingID + "' not found");
+		// the record is the only copy; change it under its lock
+		bool reserved = false;
+		modifySailing(sailingID, [length, &reserved](Sailing& s)
+		{
+			if (s.lowRemainingLength >= length)
+			{
+				s.lowRemainingLength -= length;
+				s.highRemainingLength += length;
+				reserved = true;
+			}
+		});
+		return reserved;
 	}
-
-	// read record
-	if (sailingFile.fail())
+	SailingSpace* space = findSpace(sailingID);
+	if (space == nullptr)
 	{
-		throw std::runtime_error("deleteSailing: Failed reading last record");
+		throw std::runtime_error("reserveSailingSpace: ID not found");
 	}
+	return moveSpace(*space, static_cast<int32_t>(std::lround(length * CENTIMETRES)), true);
+}
 
-	// overwirte target slot
-	sailingFile.seekp(target * sizeof(Sailing), std::ios::beg);
-	sailingFile.write(reinterpret_cast<const char*>(&lastRecord), sizeof(Sailing));
-	if (sailingFile.fail())
+// Function releaseSailingSpace gives back length meters taken by
+// reserveSailingSpace. Takes no lock, like reserveSailingSpace
+// Throws an exception if the sailing is not found
+//----------------------------------------------------------------
+void releaseSailingSpace(SailingKey sailingID, float length)
+{
+	METRICSSCOPE("sailing.releaseSailingSpace");
+	if (mappedIsShared())
+	{
+		modifySailing(sailingID, [length](Sailing& s)
+		{
+			s.lowRemainingLength += length;
+			s.highRemainingLength -= length;
+		});
+		return;
+	}
+	SailingSpace* space = findSpace(sailingID);
+	if (space == nullptr)
 	{
-		throw std::runtime_error("deleteSailing: Overwrite failed");
+		throw std::runtime_error("releaseSailingSpace: ID not found");
 	}
+	moveSpace(*space, -static_cast<int32_t>(std::lround(length * CENTIMETRES)), false);
+}
 
-//Truncate 
-#ifdef _WIN32
-    {
-        // flush and close c++ stream
-        sailingFile.flush();
-        sailingFile.close();
-
-        // open FILE*
-        FILE* f = std::fopen(sailingFileName.c_str(), "r+b");
-        if (!f)
+// Function sailingFlushCapacity writes the remaining lengths changed
+// since the last flush back to the sailing records
+// Returns the number of records written
+//----------------------------------------------------------------
+int sailingFlushCapacity()
+{
+	METRICSSCOPE("sailing.sailingFlushCapacity");
+	if (!sailingFile.isOpen())
+	{
+		throw std::runtime_error("sailingFlushCapacity: File not open.");
+	}
+	int written = 0;
+	for (SailingSpace& space : spaces)
+	{
+		// read the change count first: a change made meanwhile is written next time
+		uint32_t changes = space.changes.load(std::memory_order_acquire);
+		if (changes == space.flushed || space.deleted.load(std::memory_order_relaxed))
 		{
-            throw std::runtime_error("deleteSailing: fopen failed");
-        }
-        int fd = _fileno(f);
-
-        // trunctate
-        long newSize = static_cast<long>((total - 1) * sizeof(Sailing));
-        if (_chsize_s(fd, newSize) != 0)
+			continue;
+		}
+		int slot = findSailingSlot(space.sailingID);
+		if (slot >= 0)
 		{
-            std::fclose(f);
-            throw std::runtime_error("deleteSailing: truncate failed");
-        }
-        std::fclose(f);
+			uint64_t lengths = space.lengths.load(std::memory_order_acquire);
+			Sailing s;
+			sailingFile.readAt(slot, s);
+			s.lowRemainingLength = lowCentimetres(lengths) / CENTIMETRES;
+			s.highRemainingLength = highCentimetres(lengths) / CENTIMETRES;
+			sailingFile.writeAt(slot, s);
+			written++;
+		}
+		space.flushed = changes;
+	}
+	return written;
+}
 
-        sailingFile.open(sailingFileName, std::ios::in | std::ios::out | std::ios::binary);
-        if (!sailingFile.is_open()) 
+// Function sailingRestoreCapacity sets the remaining lengths of every
+// sailing from the lengths booked on it, see sailing.hpp
+// Returns the number of records written
+//----------------------------------------------------------------
+int sailingRestoreCapacity(std::vector<std::pair<SailingKey, float>>& booked)
+{
+	METRICSSCOPE("sailing.sailingRestoreCapacity");
+	if (!sailingFile.isOpen())
+	{
+		throw std::runtime_error("sailingRestoreCapacity: File not open.");
+	}
+	RecordLock lock = sailingFile.lockHeader(true);
+	refreshIndex();
+	std::sort(booked.begin(), booked.end());
+	// both are in sailingID order: one pass sums each sailing's bookings
+	int written = 0;
+	std::size_t next = 0;
+	for (const auto& entry : sailingIndex)
+	{
+		while (next < booked.size() && booked[next].first < entry.first)
+		{
+			next++; // reservation on a sailing that no longer exists
+		}
+		int64_t bookedCm = 0;
+		for (; next < booked.size() && booked[next].first == entry.first; ++next)
 		{
-            throw std::runtime_error("deleteSailing: re-open failed");
-        }
-    }
-#else
-    {
-        // close c++ stream
-        sailingFile.close();
-
-        // open file descriptor 
-        int fd = ::open(sailingFileName.c_str(), O_RDWR);
-        if (fd < 0)
+			bookedCm += std::lround(booked[next].second * CENTIMETRES);
+		}
+		Sailing s;
+		sailingFile.readAt(entry.second, s);
+		uint64_t lengths = packLengths(s.lowRemainingLength, s.highRemainingLength);
+		int64_t totalCm = static_cast<int64_t>(lowCentimetres(lengths)) + highCentimetres(lengths);
+		if (highCentimetres(lengths) == bookedCm)
 		{
-            throw std::runtime_error("deleteSailing: open failed");
-        }
+			continue;
+		}
+		s.lowRemainingLength = static_cast<float>(totalCm - bookedCm) / CENTIMETRES;
+		s.highRemainingLength = static_cast<float>(bookedCm) / CENTIMETRES;
+		sailingFile.writeAt(entry.second, s);
+		written++;
+	}
+	if (written > 0)
+	{
+		buildSpaces();
+		changedSailings();
+	}
+	return written;
+}
 
-        // truncation
-        off_t newSize = static_cast<off_t>((total - 1) * sizeof(Sailing));
-        if (ftruncate(fd, newSize) != 0)
-		{
-            close(fd);
-            throw std::runtime_error("deleteSailing: truncate failed");
-        }
-        close(fd);
+// Function sailingSnapshot returns every sailing in sailingID order as
+// it was when the snapshot was taken. The copy never changes, so it
+// can be read for as long as needed while sailings are added, changed
+// and booked; callers share it until a sailing changes
+// Throws an exception if the file is not open
+//----------------------------------------------------------------
+SailingSnapshot sailingSnapshot()
+{
+	METRICSSCOPE("sailing.sailingSnapshot");
+	if (!sailingFile.isOpen())
+	{
+		throw std::runtime_error("sailingSnapshot: File not open.");
+	}
+	RecordLock lock = sailingFile.lockHeader(false);
+	refreshIndex();
+	std::lock_guard<std::mutex> guard(snapshotMutex);
+	// versions first: a booking made while copying shows up as a change next time
+	uint64_t version = sailingVersion.load(std::memory_order_acquire);
+	uint64_t changes = spaceChanges();
+	// other processes change records without telling this one
+	if (snapshot != nullptr && version == snapshotVersion && changes == snapshotChanges && !mappedIsShared())
+	{
+		return snapshot;
+	}
+	std::shared_ptr<std::vector<Sailing>> copy = std::make_shared<std::vector<Sailing>>();
+	copy->reserve(sailingIndex.size());
+	for (const auto& entry : sailingIndex)
+	{
+		Sailing s;
+		sailingFile.readAt(entry.second, s);
+		showSpace(s);
+		copy->push_back(s);
+	}
+	snapshot = copy;
+	snapshotVersion = version;
+	snapshotChanges = changes;
+	return snapshot;
+}
 
-        sailingFile.open(sailingFileName, std::ios::in | std::ios::out | std::ios::binary);
-        if (!sailingFile.is_open())
+// Function sailingRemaining copies the sailingID and remaining lengths
+// of every sailing into out in sailingID order, leaving vesselName
+// empty. Reads only the in-memory counters, without a lock, so any
+// thread may call it while sailings are added and booked, though not
+// while the file is closed. Returns the number copied, none in shared
+// mode, where there are no counters
+//----------------------------------------------------------------
+int sailingRemaining(std::vector<Sailing>& out)
+{
+	out.clear();
+	SpaceTable* table = spaceTable.load(std::memory_order_acquire);
+	if (table == nullptr)
+	{
+		return 0;
+	}
+	for (std::size_t i = 0; i < table->size; ++i)
+	{
+		SailingSpace* space = table->entries[i].load(std::memory_order_acquire);
+		if (space == nullptr || space->deleted.load(std::memory_order_acquire))
 		{
-            throw std::runtime_error("deleteSailing: re-open failed");
-        }
-    }
-#endif
+			continue;
+		}
+		uint64_t lengths = space->lengths.load(std::memory_order_acquire);
+		Sailing s;
+		std::memset(&s, 0, sizeof(s));
+		s.sailingID = space->sailingID;
+		s.lowRemainingLength = lowCentimetres(lengths) / CENTIMETRES;
+		s.highRemainingLength = highCentimetres(lengths) / CENTIMETRES;
+		out.push_back(s);
+	}
+	std::sort(out.begin(), out.end(), [](const Sailing& a, const Sailing& b)
+	{
+		return a.sailingID < b.sailingID;
+	});
+	return static_cast<int>(out.size());
+}
+
+// Function checkSailingExists checks if a sailing with the provided
+// sailingID exists. Returns sailingID, otherwise throws exception.
+//----------------------------------------------------------------
+int checkSailingExists(SailingKey sailingID)
+{
+	METRICSSCOPE("sailing.checkSailingExists");
+	if (!sailingFile.isOpen())
+	{
+		throw std::runtime_error("checkSailingExists: File not open.");
+	}
+	RecordLock lock = sailingFile.lockHeader(false);
+	refreshIndex();
+	int index = findSailingSlot(sailingID);
+	if (index < 0)
+	{
+		throw std::runtime_error("checkSailingExists: ID not found");
+	}
+	return index;
+}
+
+// Function deleteSailing deletes a sailing record with the provided
+// sailingID. Throws an exception if the record is not found.
+//----------------------------------------------------------------
+void deleteSailing(SailingKey sailingID)
+{
+	METRICSSCOPE("sailing.deleteSailing");
+	if (!sailingFile.isOpen())
+	{
+		throw std::runtime_error("deleteSailing: File not open.");
+	}
+	RecordLock lock = sailingFile.lockHeader(true);
+	refreshIndex();
+	int target = findSailingSlot(sailingID);
+	if (target < 0)
+	{
+		char text[SAILINGIDSIZE];
+		sailingKeyFormat(sailingID, text);
+		throw std::runtime_error(std::string("deleteSailing: '") + text + "' not found");
+	}
+	// leave a tombstone; compact once half the file is tombstones
+	sailingIndex.erase(lowerEntry(sailingID));
+	SailingSpace* space = findSpace(sailingID);
+	if (space != nullptr)
+	{
+		space->deleted.store(true, std::memory_order_release);
+	}
+	sailingFile.removeAt(target);
+	changedSailings();
+	if (sailingFile.deadCount() >= COMPACTMINDEAD && sailingFile.deadCount() >= sailingFile.liveCount())
+	{
+		sailingCompact(COMPACTSTEP);
+	}
+}
+
+// Function sailingCompact moves at most maxMoves sailings from the end
+// of the file into free slots and truncates the file
+// Returns the number of tombstones left in the file
+//----------------------------------------------------------------
+int sailingCompact(int maxMoves)
+{
+	METRICSSCOPE("sailing.sailingCompact");
+	return sailingFile.compact(maxMoves, reindexMovedSailing);
 }
\ No newline at end of file
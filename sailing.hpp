@@ -12,8 +12,13 @@
  */
 //================================================================
 #pragma once 
+#include "sailingKey.hpp"
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 using std::string;
 //================================================================
 // Struct: Sailing
@@ -21,11 +26,13 @@ using std::string;
 //----------------------------------------------------------------
 struct Sailing
 {
-  char sailingID[10]; // Sailing ID consisting of 9 characters
+  SailingKey sailingID; // Packed ttt-dd-hh sailing ID, see sailingKey.hpp
   char vesselName[26]; // Unique vessel name, consisting up to 25 characteres
   float lowRemainingLength; // Available low remaining length
   float highRemainingLength; // Available high remaining length
 };
+// Immutable copy of every sailing, see sailingSnapshot
+typedef std::shared_ptr<const std::vector<Sailing>> SailingSnapshot;
 //================================================================
 // Function open creates and opens the Sailing file
 // Throws an exception if the file cannot be opened
@@ -44,14 +51,94 @@ void sailingReset();
 //----------------------------------------------------------------
 bool getNextSailing(Sailing& s);
 // Function writeSailing writes a sailing record to the Sailing file
-// Throws an exception if the write operation fails
+// Throws an exception if the write operation fails or if a sailing
+// with the same sailingID already exists
 //----------------------------------------------------------------
 void writeSailing(const Sailing& s);
+// Function writeSailings writes a batch of sailings with one append
+// Throws an exception, writing nothing, if a sailingID already exists
+// or appears twice in the batch
+//----------------------------------------------------------------
+void writeSailings(const std::vector<Sailing>& sailings);
+// Function getSailingRange copies every sailing whose sailingID lies
+// between first and last, inclusive, into out in sailingID order
+// Returns the number copied
+//----------------------------------------------------------------
+int getSailingRange(SailingKey first, SailingKey last, std::vector<Sailing>& out);
+// Function getTerminalDaySailings copies every sailing leaving the
+// terminal (see sailingKeyTerminal) on day into out, by hour
+// Returns the number copied
+//----------------------------------------------------------------
+int getTerminalDaySailings(SailingKey terminal, int day, std::vector<Sailing>& out);
+// Function readSailingAt copies the sailing record stored in slot into s
+// Throws an exception if the slot does not exist
+//----------------------------------------------------------------
+void readSailingAt(int slot, Sailing& s);
+// Function writeSailingAt overwrites the sailing record stored in slot
+// with a single positioned write. The sailingID must not change
+// Throws an exception if the slot does not exist
+//----------------------------------------------------------------
+void writeSailingAt(int slot, const Sailing& s);
+// Function modifySailing reads the sailing with the provided sailingID,
+// lets change modify it and writes it back, holding the record lock
+// throughout so another process cannot update it in between. If change
+// throws, nothing is written. The sailingID must not change
+// Throws an exception if the record is not found
+//----------------------------------------------------------------
+void modifySailing(SailingKey sailingID, const std::function<void(Sailing&)>& change);
+// Function reserveSailingSpace takes length meters of the low remaining
+// length of a sailing and adds it to its high remaining length
+// Returns false, changing nothing, if less than length is left
+// Lock-free: may run on any thread, alongside any other function of
+// the module; the change reaches the file with sailingFlushCapacity
+// Throws an exception if the sailing is not found
+//----------------------------------------------------------------
+bool reserveSailingSpace(SailingKey sailingID, float length);
+// Function releaseSailingSpace gives back length meters taken by
+// reserveSailingSpace. Lock-free, like reserveSailingSpace
+// Throws an exception if the sailing is not found
+//----------------------------------------------------------------
+void releaseSailingSpace(SailingKey sailingID, float length);
+// Function sailingFlushCapacity writes the remaining lengths changed
+// since the last flush back to the sailing records; also done at close
+// Returns the number of records written
+//----------------------------------------------------------------
+int sailingFlushCapacity();
+// Function sailingRestoreCapacity sets the high remaining length of every
+// sailing to the length of the vehicles booked on it, one (sailingID,
+// length) entry per reservation in any order, and its low remaining
+// length to the rest of the sailing's total. Counters flushed after the
+// reservations they follow are put right this way after a crash
+// Call once the file is open, before any booking
+// Returns the number of records written
+//----------------------------------------------------------------
+int sailingRestoreCapacity(std::vector<std::pair<SailingKey, float>>& booked);
 // Function deleteSailing deletes a sailing record with the provided
 // sailingID. Throws an exception if the record is not found.
 //----------------------------------------------------------------
-void deleteSailing(const std::string sailingID);
+void deleteSailing(SailingKey sailingID);
+// Function sailingCompact moves at most maxMoves sailings from the end
+// of the file into free slots and truncates the file
+// Returns the number of tombstones left in the file
+//----------------------------------------------------------------
+int sailingCompact(int maxMoves);
+// Function sailingSnapshot returns every sailing in sailingID order as
+// it was when the snapshot was taken. The copy never changes, so a
+// listing or report can read it for as long as it needs while other
+// threads add, change and book sailings; it does not move the
+// getNextSailing position
+// Throws an exception if the file is not open
+//----------------------------------------------------------------
+SailingSnapshot sailingSnapshot();
+// Function sailingRemaining copies the sailingID and remaining lengths
+// of every sailing into out in sailingID order, leaving vesselName
+// empty. Reads only the in-memory counters, without a lock, so any
+// thread may call it while sailings are added and booked, though not
+// while the file is closed. Returns the number copied, none in shared
+// mode, where there are no counters
+//----------------------------------------------------------------
+int sailingRemaining(std::vector<Sailing>& out);
 // Function checkSailingExists checks if a sailing with the provided
 // sailingID exists. Returns sailingID, otherwise throws exception.
 //----------------------------------------------------------------
-int checkSailingExists(const char sailingID[]);
\ No newline at end of file
+int checkSailingExists(SailingKey sailingID);
\ No newline at end of file
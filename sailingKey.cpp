@@ -0,0 +1,137 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: sailingKey.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation file of the SailingKey module of the
+* Ferry Reservation System. Converts between ttt-dd-hh sailing IDs
+* and their 32-bit packed form.
+*
+* Design Issues: Only the shape of the ID is checked; day and hour
+* are any two digits, as accepted by the reservation screens
+*/
+//============================================================
+
+#include "sailingKey.hpp"
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+//============================================================
+// Module scope constants
+//------------------------------------------------------------
+static const int FIELDBITS = 7;  // bits of the day and of the hour
+static const int LETTERBITS = 5; // bits of one terminal letter
+static const SailingKey FIELDMASK = (1u << FIELDBITS) - 1;
+static const SailingKey LETTERMASK = (1u << LETTERBITS) - 1;
+
+//============================================================
+// Function sailingKeyParse checks that sailingID has the form
+// ttt-dd-hh and stores its packed value in key
+// Returns false if the ID is not in that form
+//------------------------------------------------------------
+bool sailingKeyParse(const char sailingID[], SailingKey& key)
+{
+    if (strnlen(sailingID, SAILINGIDSIZE) != SAILINGIDSIZE - 1)
+    {
+        return false;
+    }
+    SailingKey packed = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(sailingID[i]);
+        if (!std::isalpha(c))
+        {
+            return false;
+        }
+        packed = (packed << LETTERBITS) | static_cast<SailingKey>(std::toupper(c) - 'A' + 1);
+    }
+    if (sailingID[3] != '-' || sailingID[6] != '-')
+    {
+        return false;
+    }
+    const int fields[2] = {4, 7}; // positions of the day and the hour
+    for (int start : fields)
+    {
+        unsigned char tens = static_cast<unsigned char>(sailingID[start]);
+        unsigned char ones = static_cast<unsigned char>(sailingID[start + 1]);
+        if (!std::isdigit(tens) || !std::isdigit(ones))
+        {
+            return false;
+        }
+        packed = (packed << FIELDBITS) | static_cast<SailingKey>((tens - '0') * 10 + (ones - '0'));
+    }
+    key = packed;
+    return true;
+}
+
+// Function sailingKeyEncode returns the packed value of sailingID
+// Throws an exception if the ID is not in the form ttt-dd-hh
+//------------------------------------------------------------
+SailingKey sailingKeyEncode(const char sailingID[])
+{
+    SailingKey key;
+    if (!sailingKeyParse(sailingID, key))
+    {
+        throw std::runtime_error(std::string("Sailing ID '") + sailingID + "' is not in the form ttt-dd-hh.");
+    }
+    return key;
+}
+
+// Function sailingKeyFormat writes the ttt-dd-hh text of key into
+// sailingID, which must hold SAILINGIDSIZE characters
+//------------------------------------------------------------
+void sailingKeyFormat(SailingKey key, char sailingID[])
+{
+    SailingKey terminal = sailingKeyTerminal(key);
+    for (int i = 2; i >= 0; --i)
+    {
+        sailingID[i] = static_cast<char>('A' - 1 + (terminal & LETTERMASK));
+        terminal >>= LETTERBITS;
+    }
+    int day = sailingKeyDay(key);
+    int hour = sailingKeyHour(key);
+    sailingID[3] = '-';
+    sailingID[4] = static_cast<char>('0' + day / 10);
+    sailingID[5] = static_cast<char>('0' + day % 10);
+    sailingID[6] = '-';
+    sailingID[7] = static_cast<char>('0' + hour / 10);
+    sailingID[8] = static_cast<char>('0' + hour % 10);
+    sailingID[9] = '\0';
+}
+
+// Function sailingKeyTerminal returns the packed terminal code of key;
+// every sailing from one terminal has the same value
+//------------------------------------------------------------
+SailingKey sailingKeyTerminal(SailingKey key)
+{
+    return key >> (2 * FIELDBITS);
+}
+
+// Function sailingKeyMake returns the key of the sailing leaving
+// terminal (a value from sailingKeyTerminal) on day at hour
+//------------------------------------------------------------
+SailingKey sailingKeyMake(SailingKey terminal, int day, int hour)
+{
+    return (terminal << (2 * FIELDBITS)) | (static_cast<SailingKey>(day) << FIELDBITS) |
+           static_cast<SailingKey>(hour);
+}
+
+// Function sailingKeyDay returns the day of key
+//------------------------------------------------------------
+int sailingKeyDay(SailingKey key)
+{
+    return static_cast<int>((key >> FIELDBITS) & FIELDMASK);
+}
+
+// Function sailingKeyHour returns the hour of key
+//------------------------------------------------------------
+int sailingKeyHour(SailingKey key)
+{
+    return static_cast<int>(key & FIELDMASK);
+}
@@ -0,0 +1,66 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: sailingKey.hpp
+*
+* Description: Header file of the SailingKey module of the Ferry
+* Reservation System. A sailing ID has the form ttt-dd-hh: a three
+* letter terminal code, a two digit day and a two digit hour.
+* The module packs an ID into a 32-bit SailingKey, which is what the
+* data files store and what the indexes compare. Text IDs are only
+* used at the user interface.
+* Bit layout, most significant first:
+*   3 bits unused | terminal letters 3 x 5 bits | day 7 bits | hour 7 bits
+* Letters are stored as 1-26, so comparing two keys orders sailings
+* by terminal, then day, then hour, and no valid ID encodes to 0.
+*
+* Design Issues: Terminal codes are case-insensitive and are
+* printed in upper case
+*/
+//============================================================
+#pragma once
+#include <cstdint>
+
+//============================================================
+// Constants
+//------------------------------------------------------------
+typedef uint32_t SailingKey;
+const SailingKey SAILINGKEYNONE = 0; // never produced by a valid ID
+const int SAILINGIDSIZE = 10;        // "ttt-dd-hh" plus the terminator
+const int SAILINGFIELDMAX = 99;      // largest day or hour
+
+//============================================================
+// Function sailingKeyParse checks that sailingID has the form
+// ttt-dd-hh and stores its packed value in key
+// Returns false if the ID is not in that form
+//------------------------------------------------------------
+bool sailingKeyParse(const char sailingID[], SailingKey& key);
+
+// Function sailingKeyEncode returns the packed value of sailingID
+// Throws an exception if the ID is not in the form ttt-dd-hh
+//------------------------------------------------------------
+SailingKey sailingKeyEncode(const char sailingID[]);
+
+// Function sailingKeyFormat writes the ttt-dd-hh text of key into
+// sailingID, which must hold SAILINGIDSIZE characters
+//------------------------------------------------------------
+void sailingKeyFormat(SailingKey key, char sailingID[]);
+
+// Function sailingKeyTerminal returns the packed terminal code of key;
+// every sailing from one terminal has the same value
+//------------------------------------------------------------
+SailingKey sailingKeyTerminal(SailingKey key);
+
+// Function sailingKeyMake returns the key of the sailing leaving
+// terminal (a value from sailingKeyTerminal) on day at hour
+//------------------------------------------------------------
+SailingKey sailingKeyMake(SailingKey terminal, int day, int hour);
+
+// Function sailingKeyDay returns the day of key
+//------------------------------------------------------------
+int sailingKeyDay(SailingKey key);
+
+// Function sailingKeyHour returns the hour of key
+//------------------------------------------------------------
+int sailingKeyHour(SailingKey key);
@@ -21,6 +21,7 @@
 */
 //============================================================
 #include "sailingManager.hpp"
+#include "metrics.hpp"
 #include "vessel.hpp"            
 #include "sailing.hpp"
 #include "reservationManager.hpp"
@@ -43,6 +44,7 @@
 //----------------------------------------------------------------
 char* getVessel()
 {
+    METRICSSCOPE("sailingManager.getVessel");
     vesselReset();
     Vessel vessel;
     std::vector<std::string> names;
@@ -134,6 +136,7 @@ char* getVessel()
 //----------------------------------------------------------------
 int getVesselLength(char vesselName[])
 {
+    METRICSSCOPE("sailingManager.getVesselLength");
     vesselReset();
     Vessel vessel;
     while (getNextVessel(vessel))
@@ -152,7 +155,8 @@ int getVesselLength(char vesselName[])
 //----------------------------------------------------------------
 int sailingManagerExists(char sailingID[])
 {
-    checkSailingExists(sailingID);
+    METRICSSCOPE("sailingManager.sailingManagerExists");
+    checkSailingExists(sailingKeyEncode(sailingID));
     return 1;
 }
 
@@ -162,6 +166,7 @@ int sailingManagerExists(char sailingID[])
 //----------------------------------------------------------------
 void accessReservationManager(char sailingID[])
 {
+    METRICSSCOPE("sailingManager.accessReservationManager");
     int count = viewReservations(sailingID);
     std::cout << "Total reservations on " << sailingID << ": " << count << "\n";
 } 
@@ -171,16 +176,18 @@ void accessReservationManager(char sailingID[])
 //----------------------------------------------------------------
 void createSailing(char vesselName[])
 {
+    METRICSSCOPE("sailingManager.createSailing");
     // total capacity and if vessel exists and ask user for id
     int vesselLength = getVesselLength(vesselName);
     std::string id;
     std::cout << "Enter Sailing ID: ";
     std::cin >> id;
+    SailingKey key = sailingKeyEncode(id.c_str());
 
     //check uniqueness
     try
     {
-        checkSailingExists(id.c_str());
+        checkSailingExists(key);
         throw std::runtime_error("createSailing: ID already exists.");
     }
     catch (const std::runtime_error&){                                          // ?
@@ -189,7 +196,7 @@ void createSailing(char vesselName[])
     // build record name length lrl hrl
     Sailing s{};
     std::strncpy(s.vesselName, vesselName, sizeof(s.vesselName)-1);
-    std::strncpy(s.sailingID, id.c_str(), sizeof(s.sailingID)-1);
+    s.sailingID = key;
     s.lowRemainingLength = static_cast<float>(vesselLength);
     s.highRemainingLength = 0.0f;
 
@@ -205,36 +212,21 @@ void createSailing(char vesselName[])
 //----------------------------------------------------------------
 void updateSailing(char sailingID[], int vehicleLen)
 {
-    std::vector<Sailing> all;
-    sailingReset();
-    Sailing s;
-    while (getNextSailing(s)) all.push_back(s);
-
-    bool found = false;
-    for (auto& rec : all)
+    METRICSSCOPE("sailingManager.updateSailing");
+    // look the sailing up first so a missing ID is reported as such
+    SailingKey key = sailingKeyEncode(sailingID);
+    try
     {
-        if (std::strcmp(rec.sailingID, sailingID)==0)
-        {
-            if (rec.lowRemainingLength < vehicleLen)
-            {
-                throw std::runtime_error("updateSailing: Not enough low lane space.");
-            }
-            rec.lowRemainingLength -= vehicleLen;
-            rec.highRemainingLength += vehicleLen;
-            found = true;
-            break;
-        }
+        checkSailingExists(key);
     }
-    if (!found)
+    catch (const std::runtime_error&)
     {
         throw std::runtime_error(std::string("updateSailing: ") + sailingID + " not found.");
     }
-    sailingClose();
-    std::remove("sailings.dat");
-    sailingOpen();
-    for (auto & rec : all)
+    // one compare-and-swap on the sailing's counters, no lock against other booths
+    if (!reserveSailingSpace(key, static_cast<float>(vehicleLen)))
     {
-        writeSailing(rec);
+        throw std::runtime_error("updateSailing: Not enough low lane space.");
     }
     std::cout << "Updated sailing " << sailingID << ".\n";
 }
@@ -246,6 +238,7 @@ void updateSailing(char sailingID[], int vehicleLen)
 //----------------------------------------------------------------
 void checkInReservation(char sailingID[], char vehicleLicence[])
 {
+    METRICSSCOPE("sailingManager.checkInReservation");
     float fare = checkIn(sailingID, vehicleLicence);
     std::cout<<"Collect fare: $"<< fare << "\nConfirm payment [Y/N]: ";
     char c; std::cin>> c;
@@ -263,18 +256,21 @@ void checkInReservation(char sailingID[], char vehicleLicence[])
 //----------------------------------------------------------------
 char* querySailing()
 {
-    sailingReset();
-    Sailing s;
+    METRICSSCOPE("sailingManager.querySailing");
+    // list a snapshot, unaffected by sailings booked or added meanwhile
+    SailingSnapshot sailings = sailingSnapshot();
     std::vector<std::string> ids;
     std::cout<<"\nAvailable sailings:\n";
 
-    while(getNextSailing(s))
+    char text[SAILINGIDSIZE];
+    for (const Sailing& s : *sailings)
     {
-        ids.emplace_back(s.sailingID);
+        sailingKeyFormat(s.sailingID, text);
+        ids.emplace_back(text);
         std::cout << ids.size() << ") "
-                        << s.sailingID << " on " << s.vesselName
+                        << text << " on " << s.vesselName
                         << "  LRL=" << s.lowRemainingLength
-                        << "  HRL=" << s.lowRemainingLength << "\n";
+                        << "  HRL=" << s.highRemainingLength << "\n";
     }
     if (ids.empty())
     {
@@ -303,12 +299,27 @@ char* querySailing()
 //----------------------------------------------------------------
 void removeReservations(char sailingID[])
 {
-    deleteReservations(sailingID);
-    std::cout<<"Removed all reservation on "<< sailingID <<".\n";
+    METRICSSCOPE("sailingManager.removeReservations");
+    int removed = deleteReservations(sailingID);
+    std::cout<<"Removed "<< removed <<" reservation(s) on "<< sailingID <<".\n";
 } 
 
 // Function printSailingReport sends a sailing report to a printer to be printed
-void printSailingReport(char printerName[])
+// The report is one snapshot of the sailings, so check-ins and bookings
+// carry on while it is printed
+//----------------------------------------------------------------
+void printSailingReport(const char printerName[])
 {
+    METRICSSCOPE("sailingManager.printSailingReport");
+    SailingSnapshot sailings = sailingSnapshot();
     std::cout<<"Printing report to "<<printerName<<"...\n";
+    char text[SAILINGIDSIZE];
+    for (const Sailing& s : *sailings)
+    {
+        sailingKeyFormat(s.sailingID, text);
+        std::cout << text << "  " << std::left << std::setw(25) << s.vesselName << std::right
+                  << "  LRL=" << std::setw(8) << s.lowRemainingLength
+                  << "  HRL=" << std::setw(8) << s.highRemainingLength << "\n";
+    }
+    std::cout << sailings->size() << " sailing(s)\n";
 }
\ No newline at end of file
@@ -79,4 +79,4 @@ char* querySailing();
 void removeReservations(char sailingID[]); 
 
 // Function printSailingReport sends a sailing report to a printer to be printed
-void printSailingReport(char printerName[]);
\ No newline at end of file
+void printSailingReport(const char printerName[]);
\ No newline at end of file
@@ -0,0 +1,572 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: service.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation file of the Service module of the
+* Ferry Reservation System. Each request word maps to a handler in
+* a table. The handlers do what the interactive managers do, taking
+* every value from the request instead of prompting for it, and
+* keep the sailings' remaining lengths up to date as vehicles are
+* booked and removed.
+*
+* Design Issues: One reader/writer lock covers all the storage
+* modules, whose indexes are not safe to change from two threads.
+* Each handler parses its request first and holds the lock only
+* while it works on the mapped files and indexes in memory; the
+* request's log records are committed after it has been released
+* Space on a sailing is taken before the lock, with the lock-free
+* reserveSailingSpace, so a full sailing turns bookings away without
+* holding up anyone, and is given back if the booking then fails
+*/
+//============================================================
+
+#include "service.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "reservation.hpp"
+#include "sailing.hpp"
+#include "sailingManager.hpp"
+#include "vehicle.hpp"
+#include "vessel.hpp"
+#include "writeAheadLog.hpp"
+#include <charconv>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//============================================================
+// Struct: RequestFields
+// Purpose: The part of a request line not read yet; fields are
+// separated by spaces or tabs
+//------------------------------------------------------------
+struct RequestFields
+{
+    std::string_view rest;
+};
+
+// Struct: ServiceCommand
+// Purpose: Request word and the handler that runs it and returns the
+// results for the reply
+//------------------------------------------------------------
+struct ServiceCommand
+{
+    const char* name;
+    std::string (*run)(RequestFields& in);
+};
+
+typedef std::shared_lock<std::shared_mutex> ReadLock;  // storage modules only read
+typedef std::unique_lock<std::shared_mutex> WriteLock; // storage modules changed
+
+//============================================================
+// Module scope static variables
+//------------------------------------------------------------
+static const float CHECKINLRLFARE = 14;    // fare of a low lane vehicle
+static const float CHECKINLENGTHFARE = 2;  // fare per meter of vehicle length
+static const float CHECKINHEIGHTFARE = 3;  // fare per meter of vehicle height
+static std::shared_mutex storageMutex;     // shared by reads, held alone by writes
+
+//============================================================
+// Function nextField returns the next field of a request, empty if
+// there are no more
+//------------------------------------------------------------
+static std::string_view nextField(RequestFields& in)
+{
+    std::size_t start = in.rest.find_first_not_of(" \t\r");
+    if (start == std::string_view::npos)
+    {
+        in.rest = std::string_view();
+        return std::string_view();
+    }
+    std::size_t end = in.rest.find_first_of(" \t\r", start);
+    std::string_view field = in.rest.substr(start, end == std::string_view::npos ? end : end - start);
+    in.rest.remove_prefix(end == std::string_view::npos ? in.rest.size() : end);
+    return field;
+}
+
+// Function readWord reads the next field of a request
+// Throws an exception naming the field if the request ends
+//------------------------------------------------------------
+static std::string_view readWord(RequestFields& in, const char what[])
+{
+    std::string_view word = nextField(in);
+    if (word.empty())
+    {
+        throw std::runtime_error(std::string("missing ") + what);
+    }
+    return word;
+}
+
+// Function parseSailing stores the key of a sailing ID field in key
+// Returns false if the field is not in the form ttt-dd-hh
+//------------------------------------------------------------
+static bool parseSailing(std::string_view id, SailingKey& key)
+{
+    char text[SAILINGIDSIZE];
+    if (id.size() != SAILINGIDSIZE - 1)
+    {
+        return false;
+    }
+    std::memcpy(text, id.data(), id.size());
+    text[id.size()] = '\0';
+    return sailingKeyParse(text, key);
+}
+
+// Function readSailing reads a sailing ID field and returns its key
+// Throws an exception if it is missing or not in the form ttt-dd-hh
+//------------------------------------------------------------
+static SailingKey readSailing(RequestFields& in)
+{
+    std::string_view id = readWord(in, "sailing ID");
+    SailingKey key;
+    if (!parseSailing(id, key))
+    {
+        throw std::runtime_error("invalid sailing ID " + std::string(id));
+    }
+    return key;
+}
+
+// Function readText reads a field into a fixed size record field
+// Throws an exception if it is missing or does not fit
+//------------------------------------------------------------
+static void readText(RequestFields& in, const char what[], char field[], std::size_t size)
+{
+    std::string_view word = readWord(in, what);
+    if (word.size() >= size)
+    {
+        throw std::runtime_error(std::string(what) + " " + std::string(word) + " is too long");
+    }
+    std::memcpy(field, word.data(), word.size());
+    field[word.size()] = '\0';
+}
+
+// Function readLength reads a length in meters, which must be positive
+//------------------------------------------------------------
+static float readLength(RequestFields& in, const char what[])
+{
+    std::string_view word = readWord(in, what);
+    float value = 0;
+    std::from_chars_result parsed = std::from_chars(word.data(), word.data() + word.size(), value);
+    if (parsed.ec != std::errc() || parsed.ptr != word.data() + word.size() || !(value > 0))
+    {
+        throw std::runtime_error(std::string("invalid ") + what + " " + std::string(word));
+    }
+    return value;
+}
+
+// Function giveBackSpace returns length meters to a sailing, if it
+// still exists
+//------------------------------------------------------------
+static void giveBackSpace(SailingKey sailingID, float length)
+{
+    try
+    {
+        releaseSailingSpace(sailingID, length);
+    }
+    catch (const std::runtime_error&)
+    {
+        // the sailing was deleted, there is nothing to give back to
+    }
+}
+
+//============================================================
+// Function runCreate books a vehicle on a sailing, taking its length
+// from the sailing's remaining length and adding the vehicle to the
+// vehicle file first if it is new
+// The length is read before the space is taken and checked again
+// under the write lock, where the vehicle may since have been stored
+//------------------------------------------------------------
+static std::string runCreate(RequestFields& in)
+{
+    METRICSSCOPE("service.runCreate");
+    Reservation r{};
+    r.sailingID = readSailing(in);
+    readText(in, "licence", r.vehicleLicence, sizeof(r.vehicleLicence));
+    Vehicle v{};
+    std::memcpy(v.vehicleLicence, r.vehicleLicence, sizeof(r.vehicleLicence));
+    readText(in, "phone", v.phone, sizeof(v.phone));
+    v.vehicleLength = readLength(in, "length");
+    v.vehicleHeight = readLength(in, "height");
+
+    // A vehicle on file is booked with its stored length
+    float length = v.vehicleLength;
+    {
+        ReadLock lock(storageMutex);
+        Vehicle stored;
+        if (findVehicle(v.vehicleLicence, stored) >= 0)
+        {
+            length = stored.vehicleLength;
+        }
+    }
+    if (!reserveSailingSpace(r.sailingID, length))
+    {
+        throw std::runtime_error("not enough space left on the sailing");
+    }
+    try
+    {
+        WriteLock lock(storageMutex);
+        Reservation existing;
+        if (findReservation(r.sailingID, r.vehicleLicence, existing) >= 0)
+        {
+            throw std::runtime_error(std::string("reservation for ") + r.vehicleLicence + " already exists");
+        }
+        Vehicle stored;
+        if (findVehicle(v.vehicleLicence, stored) < 0)
+        {
+            writeVehicle(v);
+        }
+        else if (stored.vehicleLength != length)
+        {
+            // another request stored the vehicle after its length was
+            // read: book it with the stored length instead
+            giveBackSpace(r.sailingID, length);
+            length = 0;
+            if (!reserveSailingSpace(r.sailingID, stored.vehicleLength))
+            {
+                throw std::runtime_error("not enough space left on the sailing");
+            }
+            length = stored.vehicleLength;
+        }
+        r.onBoard = false;
+        r.isLRL = false;
+        writeReservation(r);
+    }
+    catch (const std::exception&)
+    {
+        if (length > 0)
+        {
+            giveBackSpace(r.sailingID, length);
+        }
+        throw;
+    }
+    if (logEnabled(LOGDEBUG))
+    {
+        char sailingID[SAILINGIDSIZE];
+        sailingKeyFormat(r.sailingID, sailingID);
+        LOGWRITE(LOGDEBUG, "service.runCreate", {"sailing", sailingID}, {"vehicle", r.vehicleLicence},
+                 {"length", static_cast<double>(length)});
+    }
+    return "";
+}
+
+// Function runDelete removes one vehicle's reservation on a sailing
+//------------------------------------------------------------
+static std::string runDelete(RequestFields& in)
+{
+    METRICSSCOPE("service.runDelete");
+    SailingKey key = readSailing(in);
+    std::string licence(readWord(in, "licence"));
+    float length = 0;
+    {
+        WriteLock lock(storageMutex);
+        Vehicle v;
+        if (findVehicle(licence.c_str(), v) >= 0)
+        {
+            length = v.vehicleLength;
+        }
+        deleteReservation(key, licence.c_str());
+    }
+    giveBackSpace(key, length);
+    return "";
+}
+
+// Function runCheckIn marks a reservation as on board and returns
+// the fare, worked out from the stored vehicle
+//------------------------------------------------------------
+static std::string runCheckIn(RequestFields& in)
+{
+    METRICSSCOPE("service.runCheckIn");
+    SailingKey key = readSailing(in);
+    std::string licence(readWord(in, "licence"));
+    WriteLock lock(storageMutex);
+    Reservation r;
+    int slot = findReservation(key, licence.c_str(), r);
+    if (slot < 0)
+    {
+        throw std::runtime_error("reservation not found for check in");
+    }
+    float fare = CHECKINLRLFARE;
+    if (!r.isLRL)
+    {
+        Vehicle v;
+        if (findVehicle(r.vehicleLicence, v) < 0)
+        {
+            throw std::runtime_error("vehicle " + licence + " not found");
+        }
+        fare = v.vehicleLength * CHECKINLENGTHFARE + v.vehicleHeight * CHECKINHEIGHTFARE;
+    }
+    r.onBoard = true;
+    updateReservation(slot, r);
+    std::ostringstream reply;
+    reply << fare;
+    return reply.str();
+}
+
+// Function runCount returns the number of reservations on a sailing
+//------------------------------------------------------------
+static std::string runCount(RequestFields& in)
+{
+    METRICSSCOPE("service.runCount");
+    SailingKey key = readSailing(in);
+    ReadLock lock(storageMutex);
+    return std::to_string(countReservations(key));
+}
+
+// Function runQuery returns the vessel, remaining lane lengths and
+// number of reservations of a sailing
+//------------------------------------------------------------
+static std::string runQuery(RequestFields& in)
+{
+    METRICSSCOPE("service.runQuery");
+    SailingKey key = readSailing(in);
+    ReadLock lock(storageMutex);
+    Sailing s;
+    readSailingAt(checkSailingExists(key), s);
+    std::ostringstream reply;
+    reply << s.vesselName << ' ' << s.lowRemainingLength << ' ' << s.highRemainingLength
+          << ' ' << countReservations(key);
+    return reply.str();
+}
+
+// Function runList returns the number of sailings followed by the ID,
+// vessel and remaining lane lengths of each, from one snapshot
+//------------------------------------------------------------
+static std::string runList(RequestFields&)
+{
+    METRICSSCOPE("service.runList");
+    SailingSnapshot sailings;
+    {
+        ReadLock lock(storageMutex);
+        sailings = sailingSnapshot();
+    }
+    // the reply is built from the snapshot with the lock released
+    std::ostringstream reply;
+    reply << sailings->size();
+    char text[SAILINGIDSIZE];
+    for (const Sailing& s : *sailings)
+    {
+        sailingKeyFormat(s.sailingID, text);
+        reply << ' ' << text << ' ' << s.vesselName << ' ' << s.lowRemainingLength
+              << ' ' << s.highRemainingLength;
+    }
+    return reply.str();
+}
+
+// Function runCancel removes every reservation on a sailing, giving
+// back their space, and returns how many there were
+//------------------------------------------------------------
+static std::string runCancel(RequestFields& in)
+{
+    METRICSSCOPE("service.runCancel");
+    SailingKey key = readSailing(in);
+    float length = 0;
+    int removed;
+    {
+        WriteLock lock(storageMutex);
+        std::vector<Reservation> booked;
+        getSailingReservations(key, booked);
+        for (const Reservation& r : booked)
+        {
+            Vehicle v;
+            if (findVehicle(r.vehicleLicence, v) >= 0)
+            {
+                length += v.vehicleLength;
+            }
+        }
+        removed = deleteSailingReservations(key);
+    }
+    if (removed == 0)
+    {
+        throw std::runtime_error("no reservations on the sailing");
+    }
+    giveBackSpace(key, length);
+    return std::to_string(removed);
+}
+
+// Function runSailing creates a sailing on a vessel with all of the
+// vessel's lane length remaining
+//------------------------------------------------------------
+static std::string runSailing(RequestFields& in)
+{
+    METRICSSCOPE("service.runSailing");
+    Sailing s{};
+    s.sailingID = readSailing(in);
+    readText(in, "vessel", s.vesselName, sizeof(s.vesselName));
+    s.highRemainingLength = 0.0f;
+    WriteLock lock(storageMutex);
+    s.lowRemainingLength = static_cast<float>(getVesselLength(s.vesselName));
+    writeSailing(s);
+    return "";
+}
+
+// Function runVessel adds a vessel
+//------------------------------------------------------------
+static std::string runVessel(RequestFields& in)
+{
+    METRICSSCOPE("service.runVessel");
+    Vessel v{};
+    readText(in, "vessel", v.name, sizeof(v.name));
+    v.LCLL = readLength(in, "low lane length");
+    v.HCLL = readLength(in, "high lane length");
+    WriteLock lock(storageMutex);
+    writeVessel(v);
+    return "";
+}
+
+//============================================================
+// Module scope request table
+//------------------------------------------------------------
+static const ServiceCommand COMMANDS[] =
+{
+    {"CREATE", runCreate},
+    {"DELETE", runDelete},
+    {"CHECKIN", runCheckIn},
+    {"COUNT", runCount},
+    {"QUERY", runQuery},
+    {"LIST", runList},
+    {"CANCEL", runCancel},
+    {"SAILING", runSailing},
+    {"VESSEL", runVessel},
+};
+
+//============================================================
+// Function findCommand returns the table entry of a request word,
+// or nullptr if there is none
+//------------------------------------------------------------
+static const ServiceCommand* findCommand(std::string_view name)
+{
+    for (const ServiceCommand& command : COMMANDS)
+    {
+        if (name == command.name)
+        {
+            return &command;
+        }
+    }
+    return nullptr;
+}
+
+// Function serviceApply runs one request line against the storage
+// modules and returns the reply line, without waiting for the commit
+// The reply may only be sent after serviceCommit with commitLsn
+//------------------------------------------------------------
+std::string serviceApply(const std::string& request, uint64_t& commitLsn)
+{
+    commitLsn = 0;
+    RequestFields in{request};
+    std::string_view name = nextField(in);
+    const ServiceCommand* command = findCommand(name);
+    if (command == nullptr)
+    {
+        return "ERR unknown request " + std::string(name);
+    }
+    std::string result;
+    WalBatch batch;
+    try
+    {
+        result = command->run(in);
+    }
+    catch (const std::exception& e)
+    {
+        // whatever was changed before the failure is committed all the same
+        commitLsn = batch.detach();
+        return std::string("ERR ") + e.what();
+    }
+    commitLsn = batch.detach();
+    return result.empty() ? "OK" : "OK " + result;
+}
+
+// Function serviceCommit waits until the changes of a request are
+// committed and returns its reply, or an error reply if the log
+// could not be written
+//------------------------------------------------------------
+std::string serviceCommit(const std::string& reply, uint64_t commitLsn)
+{
+    if (commitLsn == 0)
+    {
+        return reply;
+    }
+    try
+    {
+        walCommit(commitLsn);
+    }
+    catch (const std::exception& e)
+    {
+        return std::string("ERR ") + e.what();
+    }
+    return reply;
+}
+
+// Function serviceExecute runs one request line and returns the
+// reply line once its changes are committed
+// The storage modules must be open
+//------------------------------------------------------------
+std::string serviceExecute(const std::string& request)
+{
+    uint64_t commitLsn;
+    std::string reply = serviceApply(request, commitLsn);
+    return serviceCommit(reply, commitLsn);
+}
+
+// Function serviceFlushCapacity writes the remaining lengths changed
+// by bookings back to the sailing file and commits them
+// Returns the number of sailings written
+//------------------------------------------------------------
+int serviceFlushCapacity()
+{
+    WalBatch batch;
+    WriteLock lock(storageMutex);
+    return sailingFlushCapacity();
+}
+
+// Function serviceRestoreCapacity sets every sailing's remaining
+// lengths from the vehicles booked on it and commits them
+// Returns the number of sailings written
+//------------------------------------------------------------
+int serviceRestoreCapacity()
+{
+    METRICSSCOPE("service.serviceRestoreCapacity");
+    WalBatch batch;
+    WriteLock lock(storageMutex);
+    std::vector<std::pair<SailingKey, float>> booked;
+    Reservation r;
+    reservationReset();
+    while (getNextReservation(r))
+    {
+        // booked with the stored length, as runCreate does
+        Vehicle v;
+        if (findVehicle(r.vehicleLicence, v) >= 0)
+        {
+            booked.emplace_back(r.sailingID, v.vehicleLength);
+        }
+    }
+    int written = sailingRestoreCapacity(booked);
+    if (written > 0)
+    {
+        LOGWRITE(LOGWARN, "service.serviceRestoreCapacity", {"sailings", written});
+    }
+    return written;
+}
+
+// Function serviceSailingKey returns the key of the sailing the
+// request is about, or SAILINGKEYNONE if it names no valid sailing
+//------------------------------------------------------------
+SailingKey serviceSailingKey(const std::string& request)
+{
+    RequestFields in{request};
+    nextField(in);
+    SailingKey key;
+    if (!parseSailing(nextField(in), key))
+    {
+        return SAILINGKEYNONE;
+    }
+    return key;
+}
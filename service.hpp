@@ -0,0 +1,78 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: service.hpp
+*
+* Description: Header file of the Service module of the Ferry
+* Reservation System. The module runs one request, given as a line
+* of text, against the storage modules without asking the user
+* anything, and answers with one line of text. The daemon serves
+* these requests to its clients; every field is a single word.
+*
+* Requests:
+*   CREATE  ttt-dd-hh licence phone length height
+*   DELETE  ttt-dd-hh licence
+*   CHECKIN ttt-dd-hh licence      -> fare
+*   COUNT   ttt-dd-hh              -> reservations
+*   QUERY   ttt-dd-hh              -> vessel low-length high-length reservations
+*   LIST                           -> count, then ttt-dd-hh vessel low-length
+*                                     high-length for each sailing
+*   CANCEL  ttt-dd-hh              -> reservations removed
+*   SAILING ttt-dd-hh vessel
+*   VESSEL  vessel low-length high-length
+* Replies are "OK" followed by the results, or "ERR" followed by
+* the reason the request failed.
+*
+* Design Issues: Requests may be run from several threads at once.
+* Requests that only read share the storage modules; a request that
+* changes them runs alone. A booking takes its space on the sailing
+* before that, without a lock. The write-ahead log commit can be waited
+* for after the storage modules are released and by another thread,
+* so the disk does not hold up the requests that follow
+*/
+//============================================================
+#pragma once
+#include "sailingKey.hpp"
+#include <cstdint>
+#include <string>
+
+//============================================================
+// Function serviceExecute runs one request line and returns the
+// reply line, without the line end, once its changes are committed
+// Never throws: failures are returned as "ERR <reason>"
+// The storage modules must be open
+//------------------------------------------------------------
+std::string serviceExecute(const std::string& request);
+
+// Function serviceApply runs one request line like serviceExecute but
+// does not wait for the commit; the reply may only be sent once
+// serviceCommit has been called with commitLsn, from any thread
+//------------------------------------------------------------
+std::string serviceApply(const std::string& request, uint64_t& commitLsn);
+
+// Function serviceCommit waits until the changes of a request are
+// committed and returns its reply, or an error reply if the log
+// could not be written
+//------------------------------------------------------------
+std::string serviceCommit(const std::string& reply, uint64_t commitLsn);
+
+// Function serviceFlushCapacity writes the remaining lengths changed
+// by bookings back to the sailing file and commits them; bookings only
+// change the in-memory counters, see reserveSailingSpace
+// Returns the number of sailings written
+//------------------------------------------------------------
+int serviceFlushCapacity();
+
+// Function serviceRestoreCapacity sets every sailing's remaining
+// lengths from the vehicles booked on it and commits them, putting right
+// what a crash between a booking and the next serviceFlushCapacity lost
+// The storage modules must be open, with no request running
+// Returns the number of sailings written
+//------------------------------------------------------------
+int serviceRestoreCapacity();
+
+// Function serviceSailingKey returns the key of the sailing the
+// request is about, or SAILINGKEYNONE if it names no valid sailing
+//------------------------------------------------------------
+SailingKey serviceSailingKey(const std::string& request);
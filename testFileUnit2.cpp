@@ -36,22 +36,19 @@ int main() {
 //Creates 3 reservation records
 
     Reservation r, r2, r3;
-    strncpy(r.sailingID, "123-03-45", sizeof(r.sailingID) - 1);
-    r.sailingID[sizeof(r.sailingID) - 1] = '\0';
+    r.sailingID = sailingKeyEncode("ABC-03-45");
     strncpy(r.vehicleLicence, "123ASD", sizeof(r.vehicleLicence) - 1);
     r.vehicleLicence[sizeof(r.vehicleLicence) - 1] = '\0';
     r.onBoard = false;
     r.isLRL = true;
 
-    strncpy(r2.sailingID, "987-63-22", sizeof(r2.sailingID) - 1);
-    r2.sailingID[sizeof(r2.sailingID) - 1] = '\0';
+    r2.sailingID = sailingKeyEncode("XYZ-63-22");
     strncpy(r2.vehicleLicence, "232HHH", sizeof(r2.vehicleLicence) - 1);
     r2.vehicleLicence[sizeof(r2.vehicleLicence) - 1] = '\0';
     r2.onBoard = false;
     r2.isLRL = false;
 
-    strncpy(r3.sailingID, "808-10-10", sizeof(r3.sailingID) - 1);
-    r3.sailingID[sizeof(r3.sailingID) - 1] = '\0';
+    r3.sailingID = sailingKeyEncode("MNO-10-10");
     strncpy(r3.vehicleLicence, "5PQ222", sizeof(r3.vehicleLicence) - 1);
     r3.vehicleLicence[sizeof(r3.vehicleLicence) - 1] = '\0';
     r3.onBoard = false;
@@ -0,0 +1,224 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: testLegacyFormat.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Unit Test: Data files from before the record header was added
+* Writes sailings.dat and reservations.dat in the layouts the first
+* release used, bare arrays of 44-byte sailings and 21-byte
+* reservations with text sailing IDs, opens them and checks that
+* every record comes back with its values and packed sailing ID.
+* A headerless file that is not a whole number of old records must
+* be refused rather than read as something else.
+*
+* Test Type: Bottom-up integration
+* Preconditions:
+* - The working directory is writable and holds no data files
+* Test Steps:
+* 1. Write SAILINGS old sailings and two old reservations
+* 2. Call sailingOpen() and reservationOpen() and read every record
+* 3. Compare the data fields to those written
+* 4. Close and reopen the files, which now have a header
+* 5. Write a reservations.dat one byte short and check it is refused
+* 6. Print "Pass" or "Fail"
+*/
+//============================================================
+
+#include "reservation.hpp"
+#include "sailing.hpp"
+#include "sailingKey.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//============================================================
+// Constants
+//------------------------------------------------------------
+static const int SAILINGS = 10;
+
+//============================================================
+// Struct: OldSailing
+// Purpose: A sailing as the first release wrote it
+//------------------------------------------------------------
+struct OldSailing
+{
+    char sailingID[10];
+    char vesselName[26];
+    float lowRemainingLength;
+    float highRemainingLength;
+};
+
+// Struct: OldReservation
+// Purpose: A reservation as the first release wrote it
+//------------------------------------------------------------
+struct OldReservation
+{
+    char sailingID[9];
+    char vehicleLicence[10];
+    bool onBoard;
+    bool isLRL;
+};
+
+//============================================================
+// Function oldSailingID writes the ttt-dd-hh text of sailing i
+//------------------------------------------------------------
+static void oldSailingID(int i, char sailingID[])
+{
+    std::snprintf(sailingID, SAILINGIDSIZE, "ABC-%02d-%02d", (i + 1) % 100, (8 + i) % 24);
+}
+
+// Function checkSailings reads every sailing and compares it to those
+// written, returning false if any differ
+//------------------------------------------------------------
+static bool checkSailings()
+{
+    bool pass = true;
+    int count = 0;
+    Sailing s;
+    sailingReset();
+    while (getNextSailing(s))
+    {
+        char expected[SAILINGIDSIZE];
+        oldSailingID(count, expected);
+        if (s.sailingID != sailingKeyEncode(expected) || std::strcmp(s.vesselName, "QUEEN OF OAK BAY") != 0 ||
+            s.lowRemainingLength != 100.0f + count || s.highRemainingLength != 50.0f + count)
+        {
+            char sailingID[SAILINGIDSIZE];
+            sailingKeyFormat(s.sailingID, sailingID);
+            std::cout << "Sailing " << count << " read as " << sailingID << ' ' << s.vesselName << ' '
+                      << s.lowRemainingLength << ' ' << s.highRemainingLength << '\n';
+            pass = false;
+        }
+        count++;
+    }
+    if (count != SAILINGS)
+    {
+        std::cout << count << " sailings read instead of " << SAILINGS << '\n';
+        pass = false;
+    }
+    return pass;
+}
+
+// Function checkReservations reads every reservation and compares it
+// to those written, returning false if any differ
+//------------------------------------------------------------
+static bool checkReservations()
+{
+    bool pass = true;
+    Reservation r;
+    if (findReservation(sailingKeyEncode("ABC-01-08"), "CAR001", r) < 0 || r.onBoard || !r.isLRL)
+    {
+        std::cout << "Reservation CAR001 missing or changed\n";
+        pass = false;
+    }
+    if (findReservation(sailingKeyEncode("ABC-02-09"), "TRUCK1234", r) < 0 || !r.onBoard || r.isLRL)
+    {
+        std::cout << "Reservation TRUCK1234 missing or changed\n";
+        pass = false;
+    }
+    if (countReservations(sailingKeyEncode("ABC-01-08")) != 1)
+    {
+        std::cout << "Wrong number of reservations on ABC-01-08\n";
+        pass = false;
+    }
+    return pass;
+}
+
+//============================================================
+// Function main writes the old files, opens them and prints the result
+//------------------------------------------------------------
+int main()
+{
+    bool pass = true; // Boolean to check every step matched
+
+    // Step 1: the files as the first release left them
+    {
+        std::ofstream out("sailings.dat", std::ios::binary | std::ios::trunc);
+        for (int i = 0; i < SAILINGS; ++i)
+        {
+            OldSailing s;
+            std::memset(&s, 0, sizeof(s));
+            oldSailingID(i, s.sailingID);
+            std::strcpy(s.vesselName, "QUEEN OF OAK BAY");
+            s.lowRemainingLength = 100.0f + i;
+            s.highRemainingLength = 50.0f + i;
+            out.write(reinterpret_cast<const char*>(&s), sizeof(s));
+        }
+    }
+    {
+        std::ofstream out("reservations.dat", std::ios::binary | std::ios::trunc);
+        OldReservation r;
+        std::memset(&r, 0, sizeof(r));
+        std::memcpy(r.sailingID, "ABC-01-08", 9);
+        std::strcpy(r.vehicleLicence, "CAR001");
+        r.isLRL = true;
+        out.write(reinterpret_cast<const char*>(&r), sizeof(r));
+        std::memset(&r, 0, sizeof(r));
+        std::memcpy(r.sailingID, "ABC-02-09", 9);
+        std::strcpy(r.vehicleLicence, "TRUCK1234");
+        r.onBoard = true;
+        out.write(reinterpret_cast<const char*>(&r), sizeof(r));
+    }
+    if (sizeof(OldSailing) != 44 || sizeof(OldReservation) != 21)
+    {
+        std::cout << "Old layouts are not 44 and 21 bytes on this compiler\n";
+        pass = false;
+    }
+
+    // Steps 2 to 4: converted at the first open, unchanged at the second
+    for (int round = 0; round < 2; ++round)
+    {
+        try
+        {
+            sailingOpen();
+            reservationOpen();
+            pass = checkSailings() && pass;
+            pass = checkReservations() && pass;
+            reservationClose();
+            sailingClose();
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "Open " << round << " failed: " << e.what() << '\n';
+            pass = false;
+        }
+    }
+
+    // Step 5: a file that is not whole old records is refused, untouched
+    {
+        std::ofstream out("reservations.dat", std::ios::binary | std::ios::trunc);
+        out << std::string(2 * sizeof(OldReservation) - 1, 'x');
+    }
+    try
+    {
+        reservationOpen();
+        std::cout << "A reservations.dat of 41 bytes was opened\n";
+        pass = false;
+        reservationClose();
+    }
+    catch (const std::exception& e)
+    {
+        if (std::string(e.what()).find("21-byte") == std::string::npos)
+        {
+            std::cout << "Unclear error: " << e.what() << '\n';
+            pass = false;
+        }
+    }
+    std::ifstream in("reservations.dat", std::ios::binary | std::ios::ate);
+    if (static_cast<long>(in.tellg()) != static_cast<long>(2 * sizeof(OldReservation) - 1))
+    {
+        std::cout << "The refused file was changed\n";
+        pass = false;
+    }
+
+    std::cout << (pass ? "Pass" : "Fail") << "\n";
+    return pass ? 0 : 1;
+}
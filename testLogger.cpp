@@ -0,0 +1,146 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: testLogger.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Unit Test: Logger ring buffer and formatting
+* Logs from several threads at once through the ring and checks that
+* every record reaches the file exactly once, in each thread's order,
+* and that records above the level are left out.
+*
+* Test Type: Unit
+* Preconditions:
+* - The working directory is writable
+* Test Steps:
+* 1. Start the logger at info level on test.log
+* 2. Log LINES records from each of THREADS threads, and one debug record
+* 3. Log a text field holding quotes and one longer than a field holds
+* 4. Stop the logger and read test.log back
+* 5. Print "Pass" or "Fail"
+*/
+//============================================================
+
+#include "logger.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//============================================================
+// Constants
+//------------------------------------------------------------
+static const int THREADS = 4;
+static const int LINES = 3000; // per thread; together more than the ring holds
+
+//============================================================
+// Function main runs the Logger checks and prints the result
+//------------------------------------------------------------
+int main()
+{
+    bool pass = true; // Boolean to check every step matched
+    std::remove("test.log");
+    logStart("test.log", LOGINFO);
+
+    // Each thread logs its own numbered records; a full ring waits a
+    // little so that nothing is dropped
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([t]()
+        {
+            for (int i = 0; i < LINES; ++i)
+            {
+                LOGWRITE(LOGINFO, "test.line", {"thread", t}, {"line", i});
+                if (i % 500 == 499)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2 * LOGFLUSHMS));
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    LOGWRITE(LOGDEBUG, "test.hidden", {"line", 0});
+    LOGWRITE(LOGERROR, "test.text", {"quoted", "say \"hi\""}, {"long", std::string(100, 'x')}, {"real", 2.5});
+    logStop();
+
+    // Every record arrives once, in order within its thread
+    std::ifstream in("test.log");
+    std::vector<int> next(THREADS, 0);
+    std::string line;
+    std::string textLine;
+    int lines = 0;
+    bool hidden = false;
+    bool dropped = false;
+    while (std::getline(in, line))
+    {
+        lines++;
+        hidden = hidden || line.find("test.hidden") != std::string::npos;
+        dropped = dropped || line.find("logger.dropped") != std::string::npos;
+        if (line.find("test.text") != std::string::npos)
+        {
+            textLine = line;
+        }
+        std::string::size_type at = line.find("test.line thread=");
+        if (at == std::string::npos)
+        {
+            continue;
+        }
+        int thread = -1;
+        int number = -1;
+        std::istringstream fields(line.substr(at + 17));
+        std::string rest;
+        fields >> thread >> rest;
+        if (thread >= 0 && thread < THREADS && std::sscanf(rest.c_str(), "line=%d", &number) == 1 &&
+            number == next[thread])
+        {
+            next[thread]++;
+        }
+        else
+        {
+            std::cout << "Out of order: " << line << '\n';
+            pass = false;
+        }
+    }
+    for (int t = 0; t < THREADS; ++t)
+    {
+        if (next[t] != LINES)
+        {
+            std::cout << "Thread " << t << " logged " << next[t] << " of " << LINES << " records\n";
+            pass = false;
+        }
+    }
+    if (hidden || dropped)
+    {
+        std::cout << "A debug record was written, or records were dropped\n";
+        pass = false;
+    }
+
+    // Texts are quoted, escaped and cut to the field size
+    std::string expected = "ERROR t";
+    if (textLine.find(expected) == std::string::npos ||
+        textLine.find("quoted=\"say \\\"hi\\\"\"") == std::string::npos ||
+        textLine.find("long=\"" + std::string(LOGTEXTSIZE - 1, 'x') + "\" real=2.5") == std::string::npos)
+    {
+        std::cout << "Formatted as: " << textLine << '\n';
+        pass = false;
+    }
+    if (lines != THREADS * LINES + 1)
+    {
+        std::cout << lines << " lines in the log\n";
+        pass = false;
+    }
+
+    std::cout << (pass ? "Pass" : "Fail") << "\n";
+    return pass ? 0 : 1;
+}
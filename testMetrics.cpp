@@ -0,0 +1,166 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: testMetrics.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Unit Test: Metrics operations and counters
+* Records known latencies and checks the percentiles read back from
+* the histogram, then checks that an operation is charged the records
+* and bytes counted while it runs, including by the operations it
+* calls, and by no other thread.
+*
+* Test Type: Unit
+* Preconditions:
+* - None, the module does not use any files
+* Test Steps:
+* 1. Record 1..1000 microseconds and check p50, p99 and the maximum
+* 2. Count inside nested timers and on another thread
+* 3. Check that a call left by an exception is counted as an error
+* 4. Check that the report lists the operations
+* 5. Turn metrics off and check that nothing more is counted
+* 6. Print "Pass" or "Fail"
+*/
+//============================================================
+
+#include "metrics.hpp"
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+//============================================================
+// Function near returns true if value is within 7% of expected
+//------------------------------------------------------------
+static bool near(uint64_t value, uint64_t expected)
+{
+    double ratio = static_cast<double>(value) / static_cast<double>(expected);
+    return ratio > 0.93 && ratio < 1.07;
+}
+
+// Function inner scans three records and writes 100 bytes
+//------------------------------------------------------------
+static void inner()
+{
+    METRICSSCOPE("test.inner");
+    metricsCountScanned(3);
+    metricsCountWritten(100);
+}
+
+// Function outer scans one record itself and calls inner twice
+//------------------------------------------------------------
+static void outer()
+{
+    METRICSSCOPE("test.outer");
+    metricsCountScanned(1);
+    inner();
+    inner();
+}
+
+// Function failing throws after calling inner, unless it is told not to
+//------------------------------------------------------------
+static void failing(bool fail)
+{
+    METRICSSCOPE("test.failing");
+    inner();
+    if (fail)
+    {
+        throw std::runtime_error("failing");
+    }
+}
+
+//============================================================
+// Function main runs the Metrics checks and prints the result
+//------------------------------------------------------------
+int main()
+{
+    bool pass = true; // Boolean to check every step matched
+    metricsEnable(true);
+
+    // Percentiles come back within the histogram's resolution
+    MetricsOperation& latency = metricsOperation("test.latency");
+    uint64_t none[4] = {0, 0, 0, 0};
+    for (uint64_t us = 1; us <= 1000; ++us)
+    {
+        metricsRecord(latency, us * 1000, none);
+    }
+    if (metricsCalls(latency) != 1000 || !near(metricsPercentile(latency, 0.50), 500000) ||
+        !near(metricsPercentile(latency, 0.99), 990000) || latency.maxNs != 1000000 ||
+        metricsPercentile(latency, 1.0) != 1000000)
+    {
+        std::cout << "Percentiles " << metricsPercentile(latency, 0.50) << " and "
+                  << metricsPercentile(latency, 0.99) << " ns are wrong\n";
+        pass = false;
+    }
+    if (&metricsOperation("test.latency") != &latency)
+    {
+        std::cout << "The same name gave two operations\n";
+        pass = false;
+    }
+
+    // Nested operations include what the operations they call count
+    outer();
+    std::thread other([]()
+    {
+        metricsCountScanned(1000);
+    });
+    other.join();
+    MetricsOperation& outerOp = metricsOperation("test.outer");
+    MetricsOperation& innerOp = metricsOperation("test.inner");
+    if (metricsCalls(outerOp) != 1 || outerOp.scanned != 7 || outerOp.bytesWritten != 200 ||
+        metricsCalls(innerOp) != 2 || innerOp.scanned != 6 || innerOp.bytesWritten != 200)
+    {
+        std::cout << "Counted " << outerOp.scanned << " and " << innerOp.scanned << " records scanned\n";
+        pass = false;
+    }
+
+    // Only the call left by an exception is an error, not the calls it made
+    failing(false);
+    try
+    {
+        failing(true);
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+    MetricsOperation& failingOp = metricsOperation("test.failing");
+    if (metricsCalls(failingOp) != 2 || failingOp.errors != 1 || innerOp.errors != 0)
+    {
+        std::cout << "Counted " << failingOp.errors << " errors\n";
+        pass = false;
+    }
+
+    uint64_t scannedBefore = metricsThread.scanned;
+    outer();
+    if (outerOp.scanned != 14 || metricsThread.scanned != scannedBefore + 7)
+    {
+        std::cout << "Another thread's records were charged\n";
+        pass = false;
+    }
+
+    // The report lists every operation called, and the ended thread
+    std::ostringstream report;
+    metricsReport(report);
+    if (report.str().find("test.inner") == std::string::npos ||
+        report.str().find("All threads: 1020 records scanned") == std::string::npos)
+    {
+        std::cout << report.str();
+        pass = false;
+    }
+
+    // Nothing is counted once metrics are turned off
+    metricsEnable(false);
+    outer();
+    if (metricsCalls(outerOp) != 2 || outerOp.scanned != 14 || metricsThread.scanned != scannedBefore + 7)
+    {
+        std::cout << "Counted with metrics turned off\n";
+        pass = false;
+    }
+
+    std::cout << (pass ? "Pass" : "Fail") << "\n";
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: testRecordFile.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Unit Test: RecordFile<T> slot operations
+* Appends a batch of Vessel records, then checks readAt, writeAt,
+* tombstone removeAt, free slot reuse and compact, and that the
+* records are still there after the file is closed and opened again.
+*
+* Test Type: Bottom-up integration
+* Preconditions:
+* - The file testrecords.dat is not used by another program
+* - The file is deleted first so the test starts from an empty file
+* Test Steps:
+* 1. Delete the file and open it
+* 2. Append 5 records with appendBatch()
+* 3. Overwrite record 2 with writeAt() and read it back with readAt()
+* 4. Remove records 1 and 3 with removeAt() and check the live count
+* 5. Append a record and check that it reuses a freed slot
+* 6. Compact, close, re-open and read with getNext()
+* 7. Print "Pass" or "Fail"
+*/
+//============================================================
+
+#include "recordFile.hpp"
+#include "vessel.hpp"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+//============================================================
+// Function makeVessel fills in a vessel record for the test
+//------------------------------------------------------------
+static Vessel makeVessel(const char name[], float length)
+{
+    Vessel v;
+    std::memset(&v, 0, sizeof(v));
+    std::strncpy(v.name, name, sizeof(v.name) - 1);
+    v.HCLL = length;
+    v.LCLL = length * 2;
+    return v;
+}
+
+//============================================================
+// Function main runs the RecordFile checks and prints the result
+//------------------------------------------------------------
+int main()
+{
+    bool pass = true; // Boolean to check every step matched
+
+    try
+    {
+        std::remove("testrecords.dat");
+        RecordFile<Vessel> file("testrecords.dat");
+        file.open();
+
+        // Append 5 records in one batch
+        Vessel batch[5] = {makeVessel("V0", 10), makeVessel("V1", 11), makeVessel("V2", 12),
+                           makeVessel("V3", 13), makeVessel("V4", 14)};
+        int slots[5];
+        file.appendBatch(batch, 5, slots);
+        if (file.count() != 5 || slots[0] != 0 || slots[4] != 4)
+        {
+            std::cout << "appendBatch did not write 5 records\n";
+            pass = false;
+        }
+
+        // Overwrite record 2 in place
+        Vessel result;
+        file.writeAt(2, makeVessel("V2B", 22));
+        file.readAt(2, result);
+        if (std::strcmp(result.name, "V2B") != 0 || result.HCLL != 22)
+        {
+            std::cout << "writeAt/readAt returned the wrong record\n";
+            pass = false;
+        }
+
+        // Remove records 1 and 3, their slots become tombstones
+        file.removeAt(1);
+        file.removeAt(3);
+        if (file.count() != 5 || file.liveCount() != 3 || file.isLive(1) || file.isLive(3))
+        {
+            std::cout << "removeAt did not leave tombstones\n";
+            pass = false;
+        }
+
+        // The next append reuses the most recently freed slot
+        if (file.append(makeVessel("V5", 15)) != 3 || file.count() != 5)
+        {
+            std::cout << "append did not reuse a free slot\n";
+            pass = false;
+        }
+
+        // Compact moves the last record into slot 1 and shrinks the file
+        int movedFrom = -1;
+        int movedTo = -1;
+        int dead = file.compact(10, [&](int from, int to) { movedFrom = from; movedTo = to; });
+        if (dead != 0 || file.count() != 4 || movedFrom != 4 || movedTo != 1)
+        {
+            std::cout << "compact did not move the last record into the hole\n";
+            pass = false;
+        }
+
+        // Check the records survive a close and re-open
+        file.close();
+        file.open();
+        const char* expected[] = {"V0", "V4", "V2B", "V5"};
+        int read = 0;
+        file.reset();
+        while (file.getNext(result))
+        {
+            if (read >= 4 || std::strcmp(result.name, expected[read]) != 0)
+            {
+                std::cout << "Re-opened file has the wrong records\n";
+                pass = false;
+            }
+            read++;
+        }
+        if (read != 4)
+        {
+            std::cout << "Re-opened file has " << read << " records, expected 4\n";
+            pass = false;
+        }
+
+        // Reading past the end must be rejected
+        try
+        {
+            file.readAt(4, result);
+            std::cout << "readAt past the end did not throw\n";
+            pass = false;
+        }
+        catch (const std::exception&)
+        {
+        }
+        file.close();
+        std::remove("testrecords.dat");
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Problem with test: " << e.what();
+        return 1;
+    }
+
+    if (pass)
+    {
+        std::cout << "Pass" << '\n';
+    }
+    else
+    {
+        std::cout << "Fail" << '\n';
+    }
+    std::cout << "---Record File Complete---";
+    return 0;
+}
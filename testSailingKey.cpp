@@ -0,0 +1,91 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: testSailingKey.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Unit Test: SailingKey encoding of sailing IDs
+* Packs sailing IDs into 32-bit keys and checks that they print
+* back unchanged, that keys sort by terminal, day and hour, and
+* that IDs not in the form ttt-dd-hh are rejected.
+*
+* Test Type: Unit
+* Preconditions:
+* - None, the module does not use any files
+* Test Steps:
+* 1. Encode and format a set of valid IDs
+* 2. Compare the keys of IDs that differ in terminal, day and hour,
+*    and rebuild a key from its terminal, day and hour
+* 3. Parse a set of malformed IDs
+* 4. Print "Pass" or "Fail"
+*/
+//============================================================
+
+#include "sailingKey.hpp"
+#include <cstring>
+#include <iostream>
+
+//============================================================
+// Function main runs the SailingKey checks and prints the result
+//------------------------------------------------------------
+int main()
+{
+    bool pass = true; // Boolean to check every step matched
+    char text[SAILINGIDSIZE];
+
+    // Valid IDs print back the same, lower case terminals in upper case
+    const char* valid[] = {"ABC-01-02", "ZZZ-99-99", "AAA-00-00", "van-12-07"};
+    const char* printed[] = {"ABC-01-02", "ZZZ-99-99", "AAA-00-00", "VAN-12-07"};
+    for (int i = 0; i < 4; ++i)
+    {
+        SailingKey key = sailingKeyEncode(valid[i]);
+        sailingKeyFormat(key, text);
+        if (key == SAILINGKEYNONE || std::strcmp(text, printed[i]) != 0)
+        {
+            std::cout << valid[i] << " printed back as " << text << "\n";
+            pass = false;
+        }
+    }
+
+    // Keys order by terminal, then day, then hour
+    if (!(sailingKeyEncode("ABC-99-99") < sailingKeyEncode("ABD-00-00") &&
+          sailingKeyEncode("ABC-01-99") < sailingKeyEncode("ABC-02-00") &&
+          sailingKeyEncode("ABC-02-03") < sailingKeyEncode("ABC-02-04")))
+    {
+        std::cout << "Keys do not sort by terminal, day and hour\n";
+        pass = false;
+    }
+    SailingKey key = sailingKeyEncode("VAN-12-07");
+    if (sailingKeyTerminal(key) != sailingKeyTerminal(sailingKeyEncode("VAN-30-23")) ||
+        sailingKeyDay(key) != 12 || sailingKeyHour(key) != 7 ||
+        sailingKeyMake(sailingKeyTerminal(key), 12, 7) != key)
+    {
+        std::cout << "Terminal, day or hour decoded wrongly\n";
+        pass = false;
+    }
+
+    // Malformed IDs are rejected
+    const char* invalid[] = {"", "ABC", "ABC-01-0", "ABC-01-023", "AB1-01-02", "ABC_01-02", "ABC-0A-02"};
+    for (const char* id : invalid)
+    {
+        if (sailingKeyParse(id, key))
+        {
+            std::cout << "'" << id << "' was accepted\n";
+            pass = false;
+        }
+    }
+
+    if (pass)
+    {
+        std::cout << "Pass" << '\n';
+    }
+    else
+    {
+        std::cout << "Fail" << '\n';
+    }
+    std::cout << "---Sailing Key Complete---";
+    return 0;
+}
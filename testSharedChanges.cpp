@@ -0,0 +1,182 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: testSharedChanges.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Unit Test: Change log of a data file in shared mode
+* A child process changes a RecordFile that this process also has
+* open; refreshChanges must then report exactly the slots the child
+* changed, with the records this process saw there before and the
+* ones there now. After more changes than the log holds it must ask
+* for a rebuild instead.
+*
+* Test Type: Bottom-up integration
+* Preconditions:
+* - POSIX, for fork and shared mode
+* - The working directory is writable
+* Test Steps:
+* 1. In shared mode, append 3 records and keep the file open
+* 2. In a child: remove record 1, append two records, exit
+* 3. Check refreshChanges reports slot 1 as SECOND -> FOURTH and
+*    slot 3 as new FIFTH, and nothing else
+* 4. In a child: append and remove a record RECORDCHANGES times
+* 5. Check refreshChanges returns false and reports nothing
+* 6. Print "Pass" or "Fail"
+*/
+//============================================================
+
+#include "recordFile.hpp"
+#include "vessel.hpp"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+//============================================================
+// Constants
+//------------------------------------------------------------
+static const char* DATANAME = "sharedrecords.dat";
+
+//============================================================
+// Struct: SeenChange
+// Purpose: One call of the refreshChanges callback, as names
+//------------------------------------------------------------
+struct SeenChange
+{
+    int slot;
+    std::string before; // empty for no live record
+    std::string after;
+};
+
+//============================================================
+// Function makeVessel fills in a vessel record for the test
+//------------------------------------------------------------
+static Vessel makeVessel(const char name[], float length)
+{
+    Vessel v;
+    std::memset(&v, 0, sizeof(v));
+    std::strncpy(v.name, name, sizeof(v.name) - 1);
+    v.HCLL = length;
+    v.LCLL = length * 2;
+    return v;
+}
+
+// Function runChild runs change on the file in a child process and
+// waits for it. Returns false if the child failed
+//------------------------------------------------------------
+static bool runChild(void (*change)(RecordFile<Vessel>& file))
+{
+    std::cout.flush();
+    pid_t child = fork();
+    if (child == 0)
+    {
+        try
+        {
+            RecordFile<Vessel> file(DATANAME);
+            file.open();
+            change(file);
+            file.close();
+            _exit(0);
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "Child: " << e.what() << '\n';
+            _exit(1);
+        }
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Function refreshAll calls refreshChanges and collects its callbacks
+// Returns what refreshChanges returned
+//------------------------------------------------------------
+static bool refreshAll(RecordFile<Vessel>& file, std::vector<SeenChange>& seen)
+{
+    seen.clear();
+    RecordLock lock = file.lockHeader(false);
+    return file.refreshChanges([&seen](int slot, const Vessel* before, const Vessel* after)
+    {
+        seen.push_back({slot, before != nullptr ? before->name : "", after != nullptr ? after->name : ""});
+    });
+}
+
+//============================================================
+// Function main runs the change log checks and prints the result
+//------------------------------------------------------------
+int main()
+{
+    bool pass = true; // Boolean to check every step matched
+
+    try
+    {
+        // Step 1: this process holds the file open throughout
+        std::remove(DATANAME);
+        std::remove((std::string(DATANAME) + ".changes").c_str());
+        mappedSetShared(true);
+        RecordFile<Vessel> file(DATANAME);
+        file.open();
+        Vessel batch[3] = {makeVessel("FIRST", 10), makeVessel("SECOND", 20), makeVessel("THIRD", 30)};
+        file.appendBatch(batch, 3);
+
+        // Steps 2 and 3: the freed slot is reused, the next one appended
+        pass = runChild([](RecordFile<Vessel>& other)
+        {
+            other.removeAt(1);
+            other.append(makeVessel("FOURTH", 40));
+            other.append(makeVessel("FIFTH", 50));
+        }) && pass;
+        std::vector<SeenChange> seen;
+        if (!refreshAll(file, seen) || seen.size() != 2 ||
+            seen[0].slot != 1 || seen[0].before != "SECOND" || seen[0].after != "FOURTH" ||
+            seen[1].slot != 3 || !seen[1].before.empty() || seen[1].after != "FIFTH")
+        {
+            std::cout << "refreshChanges reported " << seen.size() << " changes:";
+            for (const SeenChange& change : seen)
+            {
+                std::cout << ' ' << change.slot << ':' << change.before << "->" << change.after;
+            }
+            std::cout << '\n';
+            pass = false;
+        }
+        if (!refreshAll(file, seen) || !seen.empty())
+        {
+            std::cout << "refreshChanges reported changes twice\n";
+            pass = false;
+        }
+
+        // Steps 4 and 5: more changes than the log holds
+        pass = runChild([](RecordFile<Vessel>& other)
+        {
+            for (uint32_t i = 0; i < RECORDCHANGES; ++i)
+            {
+                other.removeAt(other.append(makeVessel("BRIEF", 1)));
+            }
+        }) && pass;
+        if (refreshAll(file, seen) || !seen.empty())
+        {
+            std::cout << "refreshChanges did not ask for a rebuild after " << 2 * RECORDCHANGES << " changes\n";
+            pass = false;
+        }
+        file.close();
+        std::remove(DATANAME);
+        std::remove((std::string(DATANAME) + ".changes").c_str());
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Problem with test: " << e.what() << '\n';
+        pass = false;
+    }
+
+    std::cout << (pass ? "Pass" : "Fail") << "\n";
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: testWriteAheadLog.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Unit Test: Crash recovery through the write-ahead log
+* A child process changes a RecordFile with the log open and exits
+* without closing anything, as a crash would. The data file on disk
+* must not have changed, since the log only redoes changes; opening
+* it again must replay every committed change from the log, and a
+* clean close must leave the log empty.
+*
+* Test Type: Bottom-up integration
+* Preconditions:
+* - POSIX, for fork
+* - The working directory is writable
+* Test Steps:
+* 1. Write 3 records with the log open and close cleanly
+* 2. In a child: overwrite record 1, append a record, exit at once
+* 3. Check the data file is byte for byte as step 1 left it
+* 4. Open it again and check the child's changes were replayed
+* 5. Check that a second process cannot open the log while it is open
+* 6. Close cleanly and check the log is empty and no .new file is left
+* 7. Print "Pass" or "Fail"
+*/
+//============================================================
+
+#include "recordFile.hpp"
+#include "vessel.hpp"
+#include "writeAheadLog.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+//============================================================
+// Constants
+//------------------------------------------------------------
+static const char* LOGNAME = "test.wal";
+static const char* DATANAME = "walrecords.dat";
+
+//============================================================
+// Function makeVessel fills in a vessel record for the test
+//------------------------------------------------------------
+static Vessel makeVessel(const char name[], float length)
+{
+    Vessel v;
+    std::memset(&v, 0, sizeof(v));
+    std::strncpy(v.name, name, sizeof(v.name) - 1);
+    v.HCLL = length;
+    v.LCLL = length * 2;
+    return v;
+}
+
+// Function readWhole returns the bytes of fileName, empty if missing
+//------------------------------------------------------------
+static std::string readWhole(const char* fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+//============================================================
+// Function main runs the recovery checks and prints the result
+//------------------------------------------------------------
+int main()
+{
+    bool pass = true; // Boolean to check every step matched
+
+    try
+    {
+        // Step 1: a clean starting point
+        std::remove(LOGNAME);
+        std::remove(DATANAME);
+        {
+            walOpen(LOGNAME, WALSYNCPEROP, 10);
+            RecordFile<Vessel> file(DATANAME);
+            file.open();
+            Vessel batch[3] = {makeVessel("FIRST", 10), makeVessel("SECOND", 20), makeVessel("THIRD", 30)};
+            file.appendBatch(batch, 3);
+            file.close();
+            walClose();
+            walUnlock(); // let the child have the log
+        }
+        std::string before = readWhole(DATANAME);
+
+        // Step 2: committed changes, then a crash
+        std::cout.flush();
+        pid_t child = fork();
+        if (child == 0)
+        {
+            walOpen(LOGNAME, WALSYNCPEROP, 10);
+            RecordFile<Vessel> file(DATANAME);
+            file.open();
+            file.writeAt(1, makeVessel("CHANGED", 25));
+            file.append(makeVessel("FOURTH", 40));
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+
+        // Step 3: nothing reached the data file before a checkpoint
+        if (readWhole(DATANAME) != before)
+        {
+            std::cout << "The data file changed before a checkpoint\n";
+            pass = false;
+        }
+        if (readWhole(LOGNAME).empty())
+        {
+            std::cout << "The child's changes are not in the log\n";
+            pass = false;
+        }
+
+        // Step 4: the log redoes the child's changes
+        walOpen(LOGNAME, WALSYNCPEROP, 10);
+        RecordFile<Vessel> file(DATANAME);
+        file.open();
+        Vessel v;
+        file.readAt(1, v);
+        if (file.liveCount() != 4 || std::strcmp(v.name, "CHANGED") != 0 || v.HCLL != 25)
+        {
+            std::cout << "Recovered " << file.liveCount() << " records, record 1 is " << v.name << '\n';
+            pass = false;
+        }
+        file.readAt(3, v);
+        if (std::strcmp(v.name, "FOURTH") != 0)
+        {
+            std::cout << "The appended record was not recovered\n";
+            pass = false;
+        }
+
+        // Step 5: another process is kept out while this one has the log
+        std::cout.flush();
+        child = fork();
+        if (child == 0)
+        {
+            try
+            {
+                // forget the parent's lock, as a process of its own would not have it
+                walUnlock();
+                walLock(LOGNAME, true);
+                _exit(1);
+            }
+            catch (const std::exception& e)
+            {
+                _exit(std::strstr(e.what(), "Another process") != nullptr ? 0 : 2);
+            }
+        }
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            std::cout << "A second process opened the log, or failed unclearly\n";
+            pass = false;
+        }
+
+        // Step 6: a clean close writes everything back and empties the log
+        file.close();
+        walClose();
+        if (!readWhole(LOGNAME).empty() || std::ifstream(std::string(LOGNAME) + ".new"))
+        {
+            std::cout << "The log was not emptied by the checkpoint\n";
+            pass = false;
+        }
+        file.open();
+        file.readAt(3, v);
+        if (file.liveCount() != 4 || std::strcmp(v.name, "FOURTH") != 0)
+        {
+            std::cout << "The changes were not written back to the data file\n";
+            pass = false;
+        }
+        file.close();
+        std::remove(DATANAME);
+        std::remove(LOGNAME);
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Problem with test: " << e.what() << '\n';
+        pass = false;
+    }
+
+    std::cout << (pass ? "Pass" : "Fail") << "\n";
+    return pass ? 0 : 1;
+}
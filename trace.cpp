@@ -0,0 +1,177 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: trace.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation of the Trace module of the Ferry
+* Reservation System, see trace.hpp.
+* Buffers are created on a thread's first span and kept after the
+* thread ends, so spans of daemon workers and import threads are
+* written too. Spans are written as complete ("X") events, with times
+* in microseconds from traceStart; the viewer nests the spans of a
+* thread by their times.
+*
+* Design Issues: A full ring loses the oldest spans of its thread; the
+* number lost is reported on std::cerr when the trace is written
+*/
+//============================================================
+
+#include "trace.hpp"
+#include "metrics.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+//============================================================
+// Module scope static variables
+//------------------------------------------------------------
+static std::mutex buffersMutex;
+static std::vector<std::unique_ptr<TraceBuffer>> buffers; // every thread that traced
+static std::string traceFileName;
+static uint64_t traceStartNs = 0;                         // steady clock time of traceStart
+static const char* COUNTNAMES[4] = {"scanned", "bytesRead", "bytesWritten", "syscalls"};
+
+//============================================================
+// Function writeName writes name as a JSON string
+//------------------------------------------------------------
+static void writeName(std::ostream& out, const char* name)
+{
+    out << '"';
+    for (const char* c = name; *c != '\0'; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+}
+
+// Function writeMicroseconds writes ns as microseconds with three decimals
+//------------------------------------------------------------
+static void writeMicroseconds(std::ostream& out, uint64_t ns)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%llu.%03llu", static_cast<unsigned long long>(ns / 1000),
+                  static_cast<unsigned long long>(ns % 1000));
+    out << text;
+}
+
+// Function writeSpan writes one span of thread as a complete event
+//------------------------------------------------------------
+static void writeSpan(std::ostream& out, const TraceSpan& span, int thread)
+{
+    std::string category(span.name);
+    category = category.substr(0, category.find('.'));
+    out << "{\"name\":";
+    writeName(out, span.name);
+    out << ",\"cat\":";
+    writeName(out, category.c_str());
+    out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread << ",\"ts\":";
+    writeMicroseconds(out, span.beginNs > traceStartNs ? span.beginNs - traceStartNs : 0);
+    out << ",\"dur\":";
+    writeMicroseconds(out, span.durationNs);
+    out << ",\"args\":{";
+    for (int i = 0; i < 4; ++i)
+    {
+        out << (i > 0 ? "," : "") << '"' << COUNTNAMES[i] << "\":" << span.counts[i];
+    }
+    out << "}}";
+}
+
+//============================================================
+// Function traceRegisterThread creates the calling thread's buffer
+//------------------------------------------------------------
+TraceBuffer* traceRegisterThread()
+{
+    std::unique_ptr<TraceBuffer> buffer(new TraceBuffer);
+    buffer->spans.resize(TRACEBUFFERSPANS);
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffer->thread = static_cast<int>(buffers.size()) + 1;
+    buffers.push_back(std::move(buffer));
+    traceThread = buffers.back().get();
+    return traceThread;
+}
+
+// Function traceStart starts recording spans, which traceStop writes
+// to fileName; it turns on the metrics counters too
+// Must be called before any other thread is started
+//------------------------------------------------------------
+void traceStart(const std::string& fileName)
+{
+    traceFileName = fileName;
+    traceStartNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    metricsEnable(true);
+    traceEnabled = true;
+}
+
+// Function traceWrite writes every span recorded so far to fileName as
+// Chrome trace-event JSON
+// Throws an exception if the file cannot be written
+//------------------------------------------------------------
+void traceWrite(const std::string& fileName)
+{
+    std::ofstream out(fileName, std::ios::trunc);
+    if (!out)
+    {
+        throw std::runtime_error("Cannot open " + fileName);
+    }
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& buffer : buffers)
+    {
+        out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread
+            << ",\"args\":{\"name\":\"" << (buffer->thread == 1 ? "main" : "thread " + std::to_string(buffer->thread))
+            << "\"}}";
+        first = false;
+
+        // Oldest span first; a full ring starts at the slot written next
+        uint64_t kept = buffer->next < TRACEBUFFERSPANS ? buffer->next : TRACEBUFFERSPANS;
+        for (uint64_t i = buffer->next - kept; i < buffer->next; ++i)
+        {
+            out << ",\n";
+            writeSpan(out, buffer->spans[i & (TRACEBUFFERSPANS - 1)], buffer->thread);
+        }
+        if (buffer->next > kept)
+        {
+            std::cerr << "trace: " << buffer->next - kept << " oldest span(s) of thread " << buffer->thread
+                      << " were overwritten\n";
+        }
+    }
+    out << "\n]}\n";
+    if (!out)
+    {
+        throw std::runtime_error("Cannot write " + fileName);
+    }
+}
+
+// Function traceStop stops recording and, if traceStart was called,
+// writes the spans to its file, reporting any failure on std::cerr
+//------------------------------------------------------------
+void traceStop()
+{
+    if (!traceEnabled)
+    {
+        return;
+    }
+    traceEnabled = false;
+    try
+    {
+        traceWrite(traceFileName);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "trace: " << e.what() << '\n';
+    }
+}
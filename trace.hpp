@@ -0,0 +1,101 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: trace.hpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Header file of the Trace module of the Ferry
+* Reservation System. While tracing, every operation instrumented
+* with METRICSSCOPE (see metrics.hpp) leaves a span: its name, start,
+* duration, and the records scanned, bytes read and written and
+* system calls counted while it ran. Spans of one thread nest the way
+* the calls did: a UI command, the manager function it runs, and the
+* storage calls under that.
+* Each thread writes its spans to its own ring buffer, without locks;
+* once the ring is full the oldest spans are overwritten. traceStop
+* writes every buffer as Chrome trace-event JSON, which chrome://tracing
+* and Perfetto open.
+*
+* Design Issues: traceStop must run after the other threads have
+* stopped, since it reads their buffers without a lock
+*/
+//============================================================
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//============================================================
+// Constants
+//------------------------------------------------------------
+const uint64_t TRACEBUFFERSPANS = 1 << 16; // spans kept per thread, a power of two
+
+//============================================================
+// Struct: TraceSpan
+// Purpose: One completed call of an operation
+//------------------------------------------------------------
+struct TraceSpan
+{
+    const char* name;     // operation name, which lives as long as the program
+    uint64_t beginNs;     // steady clock time of the start
+    uint64_t durationNs;
+    uint32_t counts[4];   // records scanned, bytes read, bytes written, syscalls
+};
+
+// Struct: TraceBuffer
+// Purpose: Ring of the spans of one thread
+//------------------------------------------------------------
+struct TraceBuffer
+{
+    std::vector<TraceSpan> spans; // TRACEBUFFERSPANS entries
+    uint64_t next = 0;            // spans ever written; the ring slot is next % TRACEBUFFERSPANS
+    int thread = 0;               // 1 for the first thread that traced, then 2, ...
+};
+
+//============================================================
+// Whether spans are recorded, and the buffer of the calling thread;
+// defined here so that reaching them needs no call
+//------------------------------------------------------------
+inline bool traceEnabled = false;
+inline thread_local TraceBuffer* traceThread = nullptr;
+
+// Function traceRegisterThread creates the calling thread's buffer
+//------------------------------------------------------------
+TraceBuffer* traceRegisterThread();
+
+// Function traceRecord adds a span of the operation called name to the
+// calling thread's buffer; counts hold what it did, see TraceSpan
+//------------------------------------------------------------
+inline void traceRecord(const char* name, uint64_t beginNs, uint64_t durationNs, const uint64_t counts[4])
+{
+    TraceBuffer* buffer = traceThread != nullptr ? traceThread : traceRegisterThread();
+    TraceSpan& span = buffer->spans[buffer->next++ & (TRACEBUFFERSPANS - 1)];
+    span.name = name;
+    span.beginNs = beginNs;
+    span.durationNs = durationNs;
+    for (int i = 0; i < 4; ++i)
+    {
+        span.counts[i] = counts[i] > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(counts[i]);
+    }
+}
+
+//============================================================
+// Function traceStart starts recording spans, which traceStop writes
+// to fileName; it turns on the metrics counters too
+// Must be called before any other thread is started
+//------------------------------------------------------------
+void traceStart(const std::string& fileName);
+
+// Function traceWrite writes every span recorded so far to fileName as
+// Chrome trace-event JSON
+// Throws an exception if the file cannot be written
+//------------------------------------------------------------
+void traceWrite(const std::string& fileName);
+
+// Function traceStop stops recording and, if traceStart was called,
+// writes the spans to its file, reporting any failure on std::cerr
+//------------------------------------------------------------
+void traceStop();
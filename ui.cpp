@@ -10,14 +10,23 @@
  *
  * Description: UI of the Ferry Reservation System,
  *              displays the menu to user, takes commands.
+ *              When connected to the daemon (see client.hpp) the
+ *              operations are sent to it instead of being run here.
+ *              Lines end with '\n' rather than std::endl: std::cin
+ *              flushes std::cout before every read, so prompts still
+ *              show up in time without a flush per line.
  *              
  */
 
 //================================================================
 
 #include <string>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include "ui.hpp"
+#include "client.hpp"
+#include "metrics.hpp"
 
 // different submenus user can be in, start at main menu
 enum menu{mainMenu, sailingMenu, reservationMenu, exitProgram};
@@ -35,30 +44,146 @@ void reservation()
     return;
 }
 
+// Function sendRequest sends a request to the daemon, printing the
+// reason if it fails
+// Returns true and the results of the reply if it succeeded
+//----------------------------------------------------------------
+bool sendRequest(const std::string& request, std::string& results)
+{
+    try
+    {
+        results = clientRequest(request);
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Error: " << e.what() << '\n';
+        return false;
+    }
+}
+
+// Function askSailingID prompts for a sailing ID
+//----------------------------------------------------------------
+std::string askSailingID()
+{
+    std::string sailingID;
+    std::cout << "Please enter a sailing ID\n";
+    std::cin >> sailingID;
+    return sailingID;
+}
+
+// Function remoteCreateReservation books a vehicle on a sailing
+// through the daemon, taking the vehicle details in case it is new
+//----------------------------------------------------------------
+void remoteCreateReservation(const char sailingID[], const char vehicleLicence[])
+{
+    std::string phone, length, height, results;
+    std::cout << "Enter the customer phone number (Length: 14 char max.):\n";
+    std::cin >> phone;
+    std::cout << "Enter the length of the vehicle in meters (Range: 7.1-99.9 max):\n";
+    std::cin >> length;
+    std::cout << "Enter the height of the vehicle in meters (Range: 2.1-9.9m max):\n";
+    std::cin >> height;
+    if (sendRequest(std::string("CREATE ") + sailingID + " " + vehicleLicence + " " +
+                    phone + " " + length + " " + height, results))
+    {
+        std::cout << "Reservation created.\n";
+    }
+}
+
+// Function remoteQuerySailing displays a sailing held by the daemon
+//----------------------------------------------------------------
+void remoteQuerySailing()
+{
+    std::string sailingID = askSailingID();
+    std::string results;
+    if (sendRequest("QUERY " + sailingID, results))
+    {
+        std::istringstream fields(results);
+        std::string vessel, low, high, reservations;
+        fields >> vessel >> low >> high >> reservations;
+        std::cout << sailingID << " on " << vessel << "  LRL=" << low << "  HRL=" << high
+                  << "\nTotal reservations: " << reservations << '\n';
+    }
+}
+
+// Function remotePrintSailingReport prints a report of the daemon's
+// sailings, taken from one snapshot
+//----------------------------------------------------------------
+void remotePrintSailingReport(const char printerName[])
+{
+    std::string results;
+    if (sendRequest("LIST", results))
+    {
+        std::istringstream fields(results);
+        int count = 0;
+        fields >> count;
+        std::cout << "Printing report to " << printerName << "...\n";
+        std::string sailingID, vessel, low, high;
+        while (fields >> sailingID >> vessel >> low >> high)
+        {
+            std::cout << sailingID << "  " << vessel << "  LRL=" << low << "  HRL=" << high << '\n';
+        }
+        std::cout << count << " sailing(s)\n";
+    }
+}
+
 void createVessel()
 {
     Vessel userVessel;
-    std::cout << "Please enter a valid vessel name (max 20 char.)" << std::endl;
+    std::cout << "Please enter a valid vessel name (max 20 char.)\n";
     cin >> userVessel.name;
-    std::cout << "Please enter the low ceiling lane length of the vessel" << std::endl;
+    std::cout << "Please enter the low ceiling lane length of the vessel\n";
     cin >> userVessel.LCLL;
-    std::cout << "Please enter the high ceiling lane length of the vessel" << std::endl;
+    std::cout << "Please enter the high ceiling lane length of the vessel\n";
     cin >> userVessel.HCLL;
+    if (clientIsConnected())
+    {
+        std::string results;
+        std::ostringstream request;
+        request << "VESSEL " << userVessel.name << " " << userVessel.LCLL << " " << userVessel.HCLL;
+        sendRequest(request.str(), results);
+        return;
+    }
     writeVessel(userVessel);
 }
 
+// Function returns the name under which the metrics and the trace
+// show the command picked by choice in the current menu
+static const char* commandName(int choice)
+{
+    static const char* MAINCOMMANDS[] = {"ui.reservationSubmenu", "ui.sailingSubmenu", "ui.createVessel", "ui.exit"};
+    static const char* RESERVATIONCOMMANDS[] = {"ui.createReservation", "ui.deleteReservation", "ui.mainMenu"};
+    static const char* SAILINGCOMMANDS[] = {"ui.checkIn", "ui.createSailing", "ui.querySailing", "ui.deleteSailing",
+                                            "ui.printSailingReport", "ui.mainMenu"};
+    switch (currentMenu)
+    {
+    case mainMenu:
+        return choice >= 1 && choice <= 4 ? MAINCOMMANDS[choice - 1] : "ui.invalidChoice";
+    case reservationMenu:
+        return choice >= 1 && choice <= 3 ? RESERVATIONCOMMANDS[choice - 1] : "ui.invalidChoice";
+    case sailingMenu:
+        return choice >= 1 && choice <= 6 ? SAILINGCOMMANDS[choice - 1] : "ui.invalidChoice";
+    default:
+        return "ui.invalidChoice";
+    }
+}
+
 // Function takes user input and takes an action
 // depending on which menu the user is in
 void processInput()
 {
     // variable initialization
     int userInput;
-    char* printerName;
+    std::string printerName;
     char sailingID[10];
     char vehicleLicence[11];
     char vesselName[26];
-    std::cout << "Enter choice: " << std::endl;
+    std::string results; // reply of the daemon when connected to one
+    std::cout << "Enter choice: \n";
     std::cin >> userInput;
+    // time the command from the choice until its work is done
+    MetricsTimer timer(metricsOperation(commandName(userInput)));
 
     switch(currentMenu)
     {
@@ -82,7 +207,7 @@ void processInput()
             currentMenu = exitProgram;
         // invalid user input
         default:
-            std::cout << "Please select a valid option" << std::endl;
+            std::cout << "Please select a valid option\n";
             break;
         }
         break;
@@ -91,18 +216,31 @@ void processInput()
         {
         // create a reservation
         case 1:
-            std::cout << "Please enter a valid sailing ID" << std::endl;
-            std::cin >> sailingID;
-            std::cout << "Please enter the vehicle's licence plate" << std::endl;
-            std::cin >> vehicleLicence;
+            std::cout << "Please enter a valid sailing ID\n";
+            std::cin >> std::setw(sizeof(sailingID)) >> sailingID;
+            std::cout << "Please enter the vehicle's licence plate\n";
+            std::cin >> std::setw(sizeof(vehicleLicence)) >> vehicleLicence;
+            if (clientIsConnected())
+            {
+                remoteCreateReservation(sailingID, vehicleLicence);
+                break;
+            }
             createReservation(sailingID, vehicleLicence);
             break;
         // delete a reservation
         case 2:
-            std::cout << "Please enter a sailing ID" << std::endl;
-            std::cin >> sailingID;
-            std::cout << "Please enter the vehicle's licence plate" << std::endl;
-            std::cin >> vehicleLicence;
+            std::cout << "Please enter a sailing ID\n";
+            std::cin >> std::setw(sizeof(sailingID)) >> sailingID;
+            std::cout << "Please enter the vehicle's licence plate\n";
+            std::cin >> std::setw(sizeof(vehicleLicence)) >> vehicleLicence;
+            if (clientIsConnected())
+            {
+                if (sendRequest(std::string("DELETE ") + sailingID + " " + vehicleLicence, results))
+                {
+                    std::cout << "Reservation deleted.\n";
+                }
+                break;
+            }
             deleteReservations(sailingID, vehicleLicence);
             break;
         // return to main menu
@@ -110,7 +248,7 @@ void processInput()
             currentMenu = mainMenu;
         // invalid user input
         default:
-            std::cout << "Please select a valid option" << std::endl;
+            std::cout << "Please select a valid option\n";
             break;
         }
         break;
@@ -119,32 +257,66 @@ void processInput()
         {
         // customer check in 
         case 1:
-            std::cout << "Please enter a valid sailing ID" << std::endl;
-            std::cin >> sailingID;
-            std::cout << "Please enter the vehicle's licence plate" << std::endl;
-            std::cin >> vehicleLicence;
+            std::cout << "Please enter a valid sailing ID\n";
+            std::cin >> std::setw(sizeof(sailingID)) >> sailingID;
+            std::cout << "Please enter the vehicle's licence plate\n";
+            std::cin >> std::setw(sizeof(vehicleLicence)) >> vehicleLicence;
+            if (clientIsConnected())
+            {
+                if (sendRequest(std::string("CHECKIN ") + sailingID + " " + vehicleLicence, results))
+                {
+                    std::cout << "Collect fare: $" << results << "\nReservation checked in.\n";
+                }
+                break;
+            }
             checkInReservation(sailingID, vehicleLicence);
             break;
         // create sailing
         case 2:
-            std::cout << "Please enter a valid vessel name" << std::endl;
-            std::cin >> vesselName;
+            std::cout << "Please enter a valid vessel name\n";
+            std::cin >> std::setw(sizeof(vesselName)) >> vesselName;
+            if (clientIsConnected())
+            {
+                if (sendRequest("SAILING " + askSailingID() + " " + vesselName, results))
+                {
+                    std::cout << "Sailing created.\n";
+                }
+                break;
+            }
             createSailing(vesselName);
             break;
         // query sailing
         case 3:
+            if (clientIsConnected())
+            {
+                remoteQuerySailing();
+                break;
+            }
             querySailing();
             break;
         // delete sailing
         case 4:
+            if (clientIsConnected())
+            {
+                if (sendRequest("CANCEL " + askSailingID(), results))
+                {
+                    std::cout << "Removed " << results << " reservation(s).\n";
+                }
+                break;
+            }
             removeReservations(querySailing());
             break;
         // print sailing report
         case 5:
             cout << "Please enter the name"
-                << " of the desired printing location." << std::endl;
+                << " of the desired printing location.\n";
             cin >> printerName;
-            printSailingReport(printerName);
+            if (clientIsConnected())
+            {
+                remotePrintSailingReport(printerName.c_str());
+                break;
+            }
+            printSailingReport(printerName.c_str());
             break;
         // return to main menu
         case 6:
@@ -152,7 +324,7 @@ void processInput()
             break;
         // invalid user input
         default:
-            std::cout << "Please select a valid option" << std::endl;
+            std::cout << "Please select a valid option\n";
         }
         break;
     case exitProgram:
@@ -164,7 +336,7 @@ void processInput()
 // Function displays the appropriate menu to the user depending on currentMenu
 void displayCurrentMenu()
 {
-    std::cout << "Welcome to the Ferry Reservation System!" << std::endl;
+    std::cout << "Welcome to the Ferry Reservation System!\n";
     // display menus and take input until user decides to exit
     while (currentMenu != exitProgram)
     {
@@ -175,14 +347,14 @@ void displayCurrentMenu()
                 << "1. Reservation Submenu\n"
                 << "2. Sailing Submenu\n"
                 << "3. Create Vessel\n"
-                << "4. Exit" << std::endl;
+                << "4. Exit\n";
             processInput();
             break;
         case reservationMenu:
             std::cout << "\n=== Reservation Menu ===\n"
                 << "1. Create Reservation\n"
                 << "2. Delete Reservation\n"
-                << "3. Return to Main Menu" << std::endl;
+                << "3. Return to Main Menu\n";
             processInput();
             break;
         case sailingMenu:
@@ -192,12 +364,12 @@ void displayCurrentMenu()
                 << "3. Query Sailing\n"
                 << "4. Delete Sailing\n"
                 << "5. Print Sailing Report\n"
-                << "6. Return to Main Menu" << std::endl;
+                << "6. Return to Main Menu\n";
             processInput();
             break;
         }
     }
     currentMenu = mainMenu;
-    std::cout << "Exiting Ferry Reservation System. Goodbye!" << std::endl;
+    std::cout << "Exiting Ferry Reservation System. Goodbye!\n";
     return;
 }
\ No newline at end of file
@@ -17,69 +17,192 @@
 * Should call the init() function before any
 * operations
 * 
-* Design Issues: Using linear search for the data file
-* Must be on a system able to use fstream
+* Design Issues: Lookups by licence go through a Bloom filter and
+* then a licence -> slot hash index. The index is saved to
+* vehicles.idx at close with the generation and checksum of the data
+* file, and loaded at open only if both still match; otherwise it is
+* rebuilt with one scan. A lookup checks the licence of the record it
+* reads, and rebuilds the index if the record holds another vehicle
+* In shared mode the index and filter take in the vehicles other
+* processes add one slot at a time, see RecordFile::refreshChanges
+* Storage is a RecordFile<Vehicle>, see recordFile.hpp
 * Fixed-length records may waste space
 */
 //============================================================
 
 #include "vehicle.hpp"
-#include <fstream>
+#include "bloomFilter.hpp"
+#include "hashIndex.hpp"
+#include "metrics.hpp"
+#include "recordFile.hpp"
 #include <stdexcept>
 #include <cstring> 
+#include <mutex>
+#include <shared_mutex>
 
 //============================================================
 // Module scope static variables
 //------------------------------------------------------------
-static std::fstream vehicleFile; // file stream for the vehicle data file
 static const std::string VEHICLEFILENAME = "vehicles.dat"; // name of the vessel file
+static RecordFile<Vehicle> vehicleFile(VEHICLEFILENAME); // the vehicle data file
+static const std::string VEHICLEINDEXNAME = "vehicles.idx"; // saved licence index
+static HashIndex vehicleIndex;   // vehicleLicence -> record slot
+static BloomFilter vehicleFilter; // licences that may be in the file
+static std::shared_mutex rebuildMutex; // held alone while findVehicle rebuilds the index
+static const int INDEXWRONG = -2; // lookupVehicle found another vehicle at the indexed slot
 
 //============================================================
-// Function vehicleOpen creates and opens the Vehicle file for binary read/write
-// Takes and returns nothing
-// Throws an exception if the file cannot be opened
+// Function makeVehicleKey copies the licence into an index key,
+// bounded by the record field size
 //------------------------------------------------------------
-void vehicleOpen()
+static void makeVehicleKey(const char vehicleLicence[], char key[])
+{
+    std::size_t length = strnlen(vehicleLicence, sizeof(Vehicle::vehicleLicence) - 1);
+    std::memcpy(key, vehicleLicence, length);
+    key[length] = '\0';
+}
+
+// Function rebuildVehicleFilter sizes the Bloom filter for twice the
+// indexed licences and adds every key of the index to it
+//------------------------------------------------------------
+static void rebuildVehicleFilter()
 {
-    // Try to open the vehicle file without overwriting the contents
-    vehicleFile.open(VEHICLEFILENAME, std::ios::in | std::ios::out | std::ios::binary | std::ios::app);
-    if (!vehicleFile.is_open())
-    {
-        // Try to create a vehicle file if it does not exist
-        vehicleFile.clear();
-        vehicleFile.open(VEHICLEFILENAME, std::ios::out | std::ios::binary);
-        
-        if (!vehicleFile.is_open())
+    bloomClear(vehicleFilter, vehicleIndex.count * 2);
+    for (const HashIndexEntry& entry : vehicleIndex.table)
+    {
+        if (entry.slot != HASHEMPTY)
         {
-            // Throw an exception if the file cannot be created
-            throw std::runtime_error("Cannot create " + VEHICLEFILENAME + ".");
+            bloomAdd(vehicleFilter, entry.key);
         }
-        vehicleFile.close();
+    }
+}
 
-        // Try to now re-open the file for reading and writing
-        vehicleFile.open(VEHICLEFILENAME, std::ios::in | std::ios::out | std::ios::binary | std::ios::app);
-        if (!vehicleFile.is_open())
+// Function scanVehicleIndex rebuilds the index and filter with one
+// scan of the file
+//------------------------------------------------------------
+static void scanVehicleIndex()
+{
+    hashIndexClear(vehicleIndex, vehicleFile.liveCount());
+    char key[HASHKEYSIZE];
+    for (int slot = 0; slot < vehicleFile.count(); ++slot)
+    {
+        if (vehicleFile.isLive(slot))
+        {
+            makeVehicleKey(vehicleFile.at(slot).vehicleLicence, key);
+            hashIndexInsert(vehicleIndex, key, slot);
+        }
+    }
+    rebuildVehicleFilter();
+}
+
+// Function buildVehicleIndex loads the saved licence index if it was
+// saved for the current contents of the file, otherwise scans the file
+//------------------------------------------------------------
+static void buildVehicleIndex()
+{
+    if (hashIndexLoad(vehicleIndex, VEHICLEINDEXNAME, vehicleFile.generation(), vehicleFile.checksum()))
+    {
+        rebuildVehicleFilter();
+    }
+    else
+    {
+        scanVehicleIndex();
+    }
+}
+
+// Function lookupVehicle reads the vehicle the index holds for key
+// into v, checking that the record really has that licence
+// Returns its slot, -1 if not found, or INDEXWRONG if the index is wrong
+//------------------------------------------------------------
+static int lookupVehicle(const char key[], Vehicle& v)
+{
+    // Most licences asked about are new: the filter rules them out in memory
+    if (!bloomMayContain(vehicleFilter, key))
+    {
+        return -1;
+    }
+    int slot = hashIndexFind(vehicleIndex, key);
+    if (slot == HASHEMPTY)
+    {
+        return -1;
+    }
+    if (!vehicleFile.isLive(slot))
+    {
+        return INDEXWRONG;
+    }
+    vehicleFile.readAt(slot, v);
+    char found[HASHKEYSIZE];
+    makeVehicleKey(v.vehicleLicence, found);
+    return std::strcmp(found, key) == 0 ? slot : INDEXWRONG;
+}
+
+// Function reindexChangedVehicle takes the vehicle another process
+// removed from slot out of the index and puts the one it stored there
+// in; either may be null. A removed licence stays in the filter, which
+// only costs a lookup
+//------------------------------------------------------------
+static void reindexChangedVehicle(int slot, const Vehicle* before, const Vehicle* after)
+{
+    char key[HASHKEYSIZE];
+    if (before != nullptr)
+    {
+        makeVehicleKey(before->vehicleLicence, key);
+        if (hashIndexFind(vehicleIndex, key) == slot)
+        {
+            hashIndexErase(vehicleIndex, key);
+        }
+    }
+    if (after != nullptr)
+    {
+        makeVehicleKey(after->vehicleLicence, key);
+        hashIndexInsert(vehicleIndex, key, slot);
+        bloomAdd(vehicleFilter, key);
+        if (bloomIsFull(vehicleFilter))
         {
-            // Throw an exception if the file cannot be opened
-            throw std::runtime_error("Cannot open " + VEHICLEFILENAME + ".");
-        } 
+            rebuildVehicleFilter();
+        }
+    }
+}
+
+// Function refreshVehicleIndex brings the index and filter up to date
+// with the vehicles another process has added since this one last
+// looked (shared mode), or builds them again if there were more
+// changes than the file's change log holds
+// The header lock must be held
+//------------------------------------------------------------
+static void refreshVehicleIndex()
+{
+    if (!vehicleFile.refreshChanges(reindexChangedVehicle))
+    {
+        buildVehicleIndex();
     }
 }
 
+//============================================================
+// Function vehicleOpen creates and opens the Vehicle file for binary read/write
+// Takes and returns nothing
+// Throws an exception if the file cannot be opened
+//------------------------------------------------------------
+void vehicleOpen()
+{
+    METRICSSCOPE("vehicle.vehicleOpen");
+    // Open the vehicle file without overwriting the contents, creating it
+    // if it does not exist. Throws an exception if it cannot be opened
+    vehicleFile.open();
+    buildVehicleIndex();
+}
+
 // Function vehicleReset seeks to the beginning of the Vehicle file
 // Takes and returns nothing
 // Throws an exception if the file is not open
 //------------------------------------------------------------
 void vehicleReset()
 {
-    if (!vehicleFile.is_open())
-    {
-        // Throw an exception if the file could not be opened
-        throw std::runtime_error("File " + VEHICLEFILENAME + "is not open.");
-    }
-    vehicleFile.clear();
-    vehicleFile.seekg(0, std::ios::beg); // Set get position to the start of the file
-    vehicleFile.seekp(0, std::ios::beg); // Set put position to the start of the file
+    METRICSSCOPE("vehicle.vehicleReset");
+    // Set get position to the start of the file
+    RecordLock lock = vehicleFile.lockHeader(false);
+    refreshVehicleIndex();
+    vehicleFile.reset();
 }
 
 // Function getNextVehicle binary reads a line from the Vehicle file
@@ -89,53 +212,112 @@ void vehicleReset()
 //------------------------------------------------------------
 bool getNextVehicle(Vehicle& v)
 {
-    if (!vehicleFile.is_open())
+    METRICSSCOPE("vehicle.getNextVehicle");
+    // Copy the next vehicle object out of the file, false at end of file
+    return vehicleFile.getNext(v);
+}
+
+// Function findVehicle looks up the vehicle with the provided licence
+// Returns its slot and copies the record into v, or -1 if not found
+// Throws an exception if the file is not open
+//------------------------------------------------------------
+int findVehicle(const char vehicleLicence[], Vehicle& v)
+{
+    METRICSSCOPE("vehicle.findVehicle");
+    if (!vehicleFile.isOpen())
     {
-        // Throw an exception if the file is not open
-        throw std::runtime_error("File " + VEHICLEFILENAME + "is not open.");
+        throw std::runtime_error("File " + VEHICLEFILENAME + " is not open.");
     }
-
-    // Read information of the next vehicle object in the file
-    vehicleFile.read(reinterpret_cast<char *>(&v), sizeof(Vehicle));
-
-    if (vehicleFile.eof())
+    RecordLock lock = vehicleFile.lockHeader(false);
+    refreshVehicleIndex();
+    char key[HASHKEYSIZE];
+    makeVehicleKey(vehicleLicence, key);
+    int slot;
     {
-        // Return false if there is no more data to read
-        return false;
+        std::shared_lock<std::shared_mutex> reading(rebuildMutex);
+        slot = lookupVehicle(key, v);
     }
-
-    if (!vehicleFile)
+    if (slot == INDEXWRONG)
     {
-        // Throw an exception if the file could not be read from
-        throw std::runtime_error("Error reading from file " + VEHICLEFILENAME + ".");
+        // The index does not match the file: rebuild it from the records,
+        // keeping other lookups out while it changes
+        std::unique_lock<std::shared_mutex> rebuilding(rebuildMutex);
+        slot = lookupVehicle(key, v);
+        if (slot == INDEXWRONG)
+        {
+            scanVehicleIndex();
+            slot = lookupVehicle(key, v);
+        }
     }
-
-    return true;
+    return slot == INDEXWRONG ? -1 : slot;
 }
 
 // Function writeVehicle binary writes to the Vehicle file
 // Returns nothing
 // Takes a Vehicle object
-// Throws an exception if the binary write operation fails
+// Throws an exception if the binary write operation fails or if a
+// vehicle with the same licence is already stored
 //------------------------------------------------------------
 void writeVehicle(const Vehicle& v)
 {
-    if (!vehicleFile.is_open())
+    METRICSSCOPE("vehicle.writeVehicle");
+    RecordLock lock = vehicleFile.lockHeader(true);
+    refreshVehicleIndex();
+    char key[HASHKEYSIZE];
+    makeVehicleKey(v.vehicleLicence, key);
+    if (hashIndexFind(vehicleIndex, key) != HASHEMPTY)
+    {
+        throw std::runtime_error(std::string("writeVehicle: Vehicle ") + key + " already exists.");
+    }
+
+    // Write information of the vehicle object at the end and index it
+    int slot = vehicleFile.append(v);
+    hashIndexInsert(vehicleIndex, key, slot);
+    bloomAdd(vehicleFilter, key);
+    if (bloomIsFull(vehicleFilter))
+    {
+        rebuildVehicleFilter();
+    }
+}
+
+// Function writeVehicles writes a batch of vehicles at the end of the
+// Vehicle file with one append, then indexes them and rebuilds the
+// filter once
+// Throws an exception, writing nothing, if a licence is already stored
+// or appears twice in the batch
+//------------------------------------------------------------
+void writeVehicles(const std::vector<Vehicle>& vehicles)
+{
+    METRICSSCOPE("vehicle.writeVehicles");
+    if (vehicles.empty())
     {
-        // Throw an exception if the file is not open
-        throw std::runtime_error("File " + VEHICLEFILENAME + "is not open.");
+        return;
+    }
+    RecordLock lock = vehicleFile.lockHeader(true);
+    refreshVehicleIndex();
+    int n = static_cast<int>(vehicles.size());
+    HashIndex batchKeys; // licences seen earlier in the batch
+    hashIndexClear(batchKeys, n);
+    char key[HASHKEYSIZE];
+    for (int i = 0; i < n; ++i)
+    {
+        makeVehicleKey(vehicles[i].vehicleLicence, key);
+        if (hashIndexFind(vehicleIndex, key) != HASHEMPTY || hashIndexFind(batchKeys, key) != HASHEMPTY)
+        {
+            throw std::runtime_error(std::string("writeVehicles: Vehicle ") + key + " already exists.");
+        }
+        hashIndexInsert(batchKeys, key, i);
     }
 
-    // Write information of the vehicle object at the end 
-    vehicleFile.clear();
-    vehicleFile.seekp(0, std::ios::end); // Move to the end of the file
-    vehicleFile.write(reinterpret_cast<const char *>(&v), sizeof(Vehicle));
-    
-    if (!vehicleFile)
+    std::vector<int> slots(vehicles.size());
+    vehicleFile.appendBatch(vehicles.data(), n, slots.data());
+    hashIndexReserve(vehicleIndex, vehicleIndex.count + n);
+    for (int i = 0; i < n; ++i)
     {
-        // Throw an exception if the file could not be written to
-        throw std::runtime_error("Error writing to file " + VEHICLEFILENAME + ".");
+        makeVehicleKey(vehicles[i].vehicleLicence, key);
+        hashIndexInsert(vehicleIndex, key, slots[i]);
     }
+    rebuildVehicleFilter();
 }
 
 // Function close closes the Vehicle file
@@ -144,13 +326,14 @@ void writeVehicle(const Vehicle& v)
 //------------------------------------------------------------
 void vehicleClose()
 {
-    if (vehicleFile.is_open())
-    {
-        vehicleFile.close();
-    }
-    else
+    METRICSSCOPE("vehicle.vehicleClose");
+    // Save the index first so the next start does not have to scan
+    if (vehicleFile.isOpen())
     {
-        // Throw an exception if the file was already closed
-        throw std::runtime_error("File " + VEHICLEFILENAME + "was already closed.");
+        // One process at a time, with the index up to date for the stamp
+        RecordLock lock = vehicleFile.lockHeader(true);
+        refreshVehicleIndex();
+        hashIndexSave(vehicleIndex, VEHICLEINDEXNAME, vehicleFile.generation(), vehicleFile.checksum());
     }
+    vehicleFile.close();
 }
\ No newline at end of file
@@ -17,6 +17,7 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <vector>
 
 //============================================================
 // Struct: Vehicle
@@ -45,10 +46,21 @@ void vehicleReset();
 // Throws an exception if the read operation fails
 //------------------------------------------------------------
 bool getNextVehicle(Vehicle& v);
+// Function findVehicle looks up the vehicle with the provided licence
+// Returns its slot and copies the record into v, or -1 if not found
+// Throws an exception if the file is not open
+//------------------------------------------------------------
+int findVehicle(const char vehicleLicence[], Vehicle& v);
 // Function writeVehicle writes to the Vehicle file
-// Throws an exception if the write operation fails
+// Throws an exception if the write operation fails or if a vehicle
+// with the same licence is already stored
 //------------------------------------------------------------
 void writeVehicle(const Vehicle& v);
+// Function writeVehicles writes a batch of vehicles with one append
+// Throws an exception, writing nothing, if a licence is already stored
+// or appears twice in the batch
+//------------------------------------------------------------
+void writeVehicles(const std::vector<Vehicle>& vehicles);
 // Function close closes the Vehicle file
 //------------------------------------------------------------
 void vehicleClose();
\ No newline at end of file
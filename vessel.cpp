@@ -18,21 +18,22 @@
 * operations
 * 
 * Design Issues: Using linear search for the data file
-* Must be on a system able to use fstream
+* Storage is a RecordFile<Vessel>, see recordFile.hpp
 * Fixed-length records may waste space
 */
 //============================================================
 
 #include "vessel.hpp"
-#include <fstream>
+#include "metrics.hpp"
+#include "recordFile.hpp"
 #include <stdexcept>
 #include <cstring> 
 
 //============================================================
 // Module scope static variables
 //------------------------------------------------------------
-static std::fstream vesselFile; // file stream for the vessel data file
 static const std::string VESSELFILENAME = "vessels.dat"; // name of the vessel file
+static RecordFile<Vessel> vesselFile(VESSELFILENAME); // the vessel data file
 
 //============================================================
 // Function vesselOpen creates and opens the Vessel file for binary read/write
@@ -41,29 +42,10 @@ static const std::string VESSELFILENAME = "vessels.dat"; // name of the vessel f
 //------------------------------------------------------------
 void vesselOpen()
 {
-    // Try to open the vessel file without overwriting the contents
-    vesselFile.open(VESSELFILENAME, std::ios::in | std::ios::out | std::ios::binary | std::ios::app);
-    if (!vesselFile.is_open())
-    {
-        // Try to create a vessel file if it does not exist
-        vesselFile.clear();
-        vesselFile.open(VESSELFILENAME, std::ios::out | std::ios::binary);
-        
-        if (!vesselFile.is_open())
-        {
-            // Throw an exception if the file cannot be created
-            throw std::runtime_error("Cannot create " + VESSELFILENAME + ".");
-        }
-        vesselFile.close();
-
-        // Try to now re-open the file for reading and writing
-        vesselFile.open(VESSELFILENAME, std::ios::in | std::ios::out | std::ios::binary | std::ios::app);
-        if (!vesselFile.is_open())
-        {
-            // Throw an exception if the file cannot be opened
-            throw std::runtime_error("Cannot open " + VESSELFILENAME + ".");
-        } 
-    }
+    METRICSSCOPE("vessel.vesselOpen");
+    // Open the vessel file without overwriting the contents, creating it
+    // if it does not exist. Throws an exception if it cannot be opened
+    vesselFile.open();
 }
 
 // Function vesselReset seeks to the beginning of the Vessel file
@@ -72,14 +54,12 @@ void vesselOpen()
 //------------------------------------------------------------
 void vesselReset()
 {
-    if (!vesselFile.is_open())
-    {
-        // Throw an exception if the file could not be opened
-        throw std::runtime_error("File " + VESSELFILENAME + "is not open.");
-    }
-    vesselFile.clear();
-    vesselFile.seekg(0, std::ios::beg); // Set get position to the start of the file
-    vesselFile.seekp(0, std::ios::beg); // Set put position to the start of the file
+    METRICSSCOPE("vessel.vesselReset");
+    // Set get position to the start of the file, seeing vessels
+    // added by other processes in shared mode
+    RecordLock lock = vesselFile.lockHeader(false);
+    vesselFile.refresh();
+    vesselFile.reset();
 }
 
 // Function getNextVessel binary reads a line from the Vessel file
@@ -89,28 +69,9 @@ void vesselReset()
 //------------------------------------------------------------
 bool getNextVessel(Vessel& v)
 {
-    if (!vesselFile.is_open())
-    {
-        // Throw an exception if the file is not open
-        throw std::runtime_error("File " + VESSELFILENAME + "is not open.");
-    }
-
-    // Read information of the next vessel object in the file
-    vesselFile.read(reinterpret_cast < char *> (&v), sizeof(Vessel));
-
-    if (vesselFile.eof())
-    {
-        // Return false if there is no more data to read
-        return false;
-    }
-
-    if (!vesselFile)
-    {
-        // Throw an exception if the file could not be read from
-        throw std::runtime_error("Error reading from file " + VESSELFILENAME + ".");
-    }
-
-    return true;
+    METRICSSCOPE("vessel.getNextVessel");
+    // Copy the next vessel object out of the file, false at end of file
+    return vesselFile.getNext(v);
 }
 
 // Function writeVessel binary writes to the Vessel file
@@ -120,22 +81,9 @@ bool getNextVessel(Vessel& v)
 //------------------------------------------------------------
 void writeVessel(const Vessel& v)
 {
-    if (!vesselFile.is_open())
-    {
-        // Throw an exception if the file is not open
-        throw std::runtime_error("File " + VESSELFILENAME + "is not open.");
-    }
-
-    // Write information of the vessel object at the end 
-    vesselFile.clear();
-    vesselFile.seekp(0, std::ios::end); // Move to the end of the file
-    vesselFile.write(reinterpret_cast<const char *>(&v), sizeof(Vessel));
-    
-    if (!vesselFile)
-    {
-        // Throw an exception if the file could not be written to
-        throw std::runtime_error("Error writing to file " + VESSELFILENAME + ".");
-    }
+    METRICSSCOPE("vessel.writeVessel");
+    // Write information of the vessel object at the end
+    vesselFile.append(v);
 }
 
 // Function vesselClose closes the Vessel file
@@ -144,13 +92,6 @@ void writeVessel(const Vessel& v)
 //------------------------------------------------------------
 void vesselClose()
 {
-    if (vesselFile.is_open())
-    {
-        vesselFile.close();
-    }
-    else
-    {
-        // Throw an exception if the file was already closed
-        throw std::runtime_error("File " + VESSELFILENAME + "was already closed.");
-    }
+    METRICSSCOPE("vessel.vesselClose");
+    vesselFile.close();
 }
\ No newline at end of file
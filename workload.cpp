@@ -0,0 +1,633 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: workload.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Load testing tool of the Ferry Reservation System.
+*
+* "workload generate" writes a synthetic stream of Service requests
+* (see service.hpp), one per line in time order, for a season of
+* sailings with ttt-dd-hh IDs:
+*   - the vessels, then each sailing before its booking window opens
+*   - bookings spread over the week before a sailing, filling up to
+*     --fill of its space, with a surge in the last day before popular
+*     ones, which draw more bookings than fit
+*   - lookups of sailings by agents while bookings come in
+*   - cancellations of single bookings, and now and then of a sailing
+*   - a check-in wave in the last hour before each departure
+* The same file can be run with "ferry --batch".
+*
+* "workload replay" runs such a file against fresh data files from N
+* client threads, as fast as possible or at a target rate, and reports
+* the throughput achieved and the latency percentiles of each request
+* type as a table on std::cerr and as JSON.
+*
+* Usage: workload generate [--sailings=<n>] [--days=<n>] [--fill=<f>]
+*                          [--seed=<n>] [--output=<file>]
+*        workload replay [--clients=<n>] [--rate=<requests/s>]
+*                        [--durability=sync|group|async] [--dir=<path>]
+*                        [--output=<file>] <file>
+*
+* Design Issues: The replay drives the Service module, which does the
+* work of the manager functions without asking the user anything
+* Requests about one sailing always go to the same client, like the
+* daemon's workers, so they run in file order; VESSEL requests are
+* run before the clients start and other requests naming no sailing
+* go to the first client
+* With a target rate, request i is due at i / rate seconds and its
+* latency is counted from then, so a slow request also charges the
+* requests that had to wait for it
+*/
+//============================================================
+
+#include "reservation.hpp"
+#include "sailing.hpp"
+#include "sailingKey.hpp"
+#include "service.hpp"
+#include "vehicle.hpp"
+#include "vessel.hpp"
+#include "writeAheadLog.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//============================================================
+// Struct: WorkloadVessel
+// Purpose: A vessel of the generated fleet
+//------------------------------------------------------------
+struct WorkloadVessel
+{
+    const char* name;
+    int lowLength;  // low ceiling lane length (meters)
+    int highLength; // high ceiling lane length (meters)
+};
+
+// Struct: WorkloadVehicle
+// Purpose: A customer's vehicle, which may be booked on many sailings
+//------------------------------------------------------------
+struct WorkloadVehicle
+{
+    char licence[11];
+    char phone[14];
+    double length;
+    double height;
+};
+
+// Struct: WorkloadEvent
+// Purpose: One request and when it happens, in minutes from the start
+// of day 0 of the season
+//------------------------------------------------------------
+struct WorkloadEvent
+{
+    double minute;
+    std::string request;
+};
+
+// Struct: ReplayRequest
+// Purpose: A request of the file and its position in it
+//------------------------------------------------------------
+struct ReplayRequest
+{
+    long index;
+    std::string line;
+};
+
+// Struct: ReplayStats
+// Purpose: Latencies and failures of one request type
+//------------------------------------------------------------
+struct ReplayStats
+{
+    std::vector<uint32_t> microseconds;
+    long errors = 0;
+};
+
+//============================================================
+// Module scope static variables
+//------------------------------------------------------------
+static const WorkloadVessel VESSELS[] = {{"Coastal", 400, 300}, {"Queen", 600, 400}, {"Spirit", 900, 700}};
+static const char* TERMINALS[] = {"TSA", "SWB", "HSB", "NAN", "DUK", "LNG"};
+static const int DEPARTUREHOURS[] = {7, 9, 11, 13, 15, 17, 19, 21};
+static const double DAYMINUTES = 24 * 60;
+static const double BOOKINGWINDOW = 7 * DAYMINUTES;  // bookings open a week before departure
+static const double CHECKINWINDOW = 60;              // check-in opens an hour before departure
+static const double CHECKINCLOSE = 5;                // and closes five minutes before
+static const double SURGEHOURS = 6;                  // mean lead time of a surge booking
+static const double POPULARSHARE = 0.2;              // sailings that draw a surge
+static const double POPULARDEMAND = 1.3;             // demand of a popular sailing, share of its space
+static const double SURGESHARE = 0.6;                // bookings of a popular sailing made in the surge
+static const double CANCELSHARE = 0.08;              // bookings cancelled
+static const double CHECKINSHARE = 0.92;             // bookings kept that check in
+static const double LOOKUPSHARE = 0.2;               // lookups per booking
+static const double SAILINGCANCELSHARE = 0.01;       // sailings cancelled altogether
+static const double AVERAGELENGTH = 5.5;             // meters per booked vehicle, on average
+static const char* DATAFILES[] = {"ferry.wal", "vehicles.dat", "vehicles.idx", "vessels.dat",
+                                  "reservations.dat", "sailings.dat"};
+
+//============================================================
+// Function optionValue returns the text after prefix if arg starts
+// with it, or nullptr
+//------------------------------------------------------------
+static const char* optionValue(const std::string& arg, const char prefix[])
+{
+    std::size_t length = std::char_traits<char>::length(prefix);
+    return arg.compare(0, length, prefix) == 0 ? arg.c_str() + length : nullptr;
+}
+
+// Function makeVehicle makes the n-th customer vehicle: mostly cars,
+// some vans and campers, a few trucks
+//------------------------------------------------------------
+static WorkloadVehicle makeVehicle(long n, std::mt19937_64& random)
+{
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    WorkloadVehicle v;
+    std::snprintf(v.licence, sizeof(v.licence), "%c%c%06ld", static_cast<char>('A' + random() % 26),
+                  static_cast<char>('A' + random() % 26), n % 1000000);
+    std::snprintf(v.phone, sizeof(v.phone), "604%07ld", static_cast<long>(random() % 10000000));
+    double kind = uniform(random);
+    if (kind < 0.7)
+    {
+        v.length = 4.0 + 1.5 * uniform(random);
+        v.height = 1.5 + 0.5 * uniform(random);
+    }
+    else if (kind < 0.9)
+    {
+        v.length = 5.0 + 2.0 * uniform(random);
+        v.height = 2.0 + 0.8 * uniform(random);
+    }
+    else
+    {
+        v.length = 8.0 + 12.0 * uniform(random);
+        v.height = 3.0 + 1.2 * uniform(random);
+    }
+    return v;
+}
+
+// Function sailingRequest formats a request about a sailing
+//------------------------------------------------------------
+static std::string sailingRequest(const char word[], const char sailingID[], const char licence[] = nullptr)
+{
+    std::string request = std::string(word) + " " + sailingID;
+    if (licence != nullptr)
+    {
+        request += std::string(" ") + licence;
+    }
+    return request;
+}
+
+//============================================================
+// Function generate writes the requests of a season of the given
+// number of sailings over the given number of days to out
+//------------------------------------------------------------
+static void generate(std::ostream& out, int sailings, int days, double fill, unsigned seed)
+{
+    std::mt19937_64 random(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<WorkloadEvent> events;
+
+    // Repeat customers: about three bookings per vehicle over the season
+    long expected = 0;
+    for (int s = 0; s < sailings; ++s)
+    {
+        const WorkloadVessel& vessel = VESSELS[s % (sizeof(VESSELS) / sizeof(VESSELS[0]))];
+        expected += static_cast<long>((vessel.lowLength + vessel.highLength) / AVERAGELENGTH * fill);
+    }
+    std::vector<WorkloadVehicle> vehicles;
+    for (long n = 0; n < std::max(100L, expected / 3); ++n)
+    {
+        vehicles.push_back(makeVehicle(n, random));
+    }
+
+    int created = 0;
+    for (int day = 1; day <= days && created < sailings; ++day)
+    {
+        for (int hour : DEPARTUREHOURS)
+        {
+            for (const char* terminal : TERMINALS)
+            {
+                if (created == sailings)
+                {
+                    break;
+                }
+                const WorkloadVessel& vessel = VESSELS[created % (sizeof(VESSELS) / sizeof(VESSELS[0]))];
+                created++;
+                char sailingID[16];
+                std::snprintf(sailingID, sizeof(sailingID), "%s-%02d-%02d", terminal, day, hour);
+                double departure = day * DAYMINUTES + hour * 60.0;
+                double opens = departure - BOOKINGWINDOW;
+                events.push_back({opens - 1, std::string("SAILING ") + sailingID + " " + vessel.name});
+
+                // A cancelled sailing takes no requests after it is cancelled
+                double cancelled = departure;
+                if (uniform(random) < SAILINGCANCELSHARE)
+                {
+                    cancelled = departure - 60 * (2 + 22 * uniform(random));
+                    events.push_back({cancelled, sailingRequest("CANCEL", sailingID)});
+                }
+
+                bool popular = uniform(random) < POPULARSHARE;
+                double demand = popular ? POPULARDEMAND : fill * (0.4 + 0.6 * uniform(random));
+                long bookings = static_cast<long>((vessel.lowLength + vessel.highLength) / AVERAGELENGTH * demand);
+                std::set<long> booked;
+                for (long b = 0; b < bookings; ++b)
+                {
+                    long pick;
+                    do
+                    {
+                        pick = static_cast<long>(random() % vehicles.size());
+                    }
+                    while (!booked.insert(pick).second && booked.size() < vehicles.size());
+                    const WorkloadVehicle& v = vehicles[pick];
+
+                    double when = opens + (BOOKINGWINDOW - CHECKINWINDOW) * uniform(random);
+                    if (popular && uniform(random) < SURGESHARE)
+                    {
+                        std::exponential_distribution<double> lead(1.0 / (SURGEHOURS * 60));
+                        when = std::max(opens, departure - CHECKINWINDOW - lead(random));
+                    }
+                    if (when >= cancelled)
+                    {
+                        continue;
+                    }
+                    char line[96];
+                    std::snprintf(line, sizeof(line), "CREATE %s %s %s %.1f %.1f", sailingID, v.licence, v.phone,
+                                  v.length, v.height);
+                    events.push_back({when, line});
+
+                    if (uniform(random) < LOOKUPSHARE)
+                    {
+                        double look = opens + (cancelled - opens) * uniform(random);
+                        events.push_back({look, sailingRequest(uniform(random) < 0.5 ? "COUNT" : "QUERY", sailingID)});
+                    }
+                    if (uniform(random) < CANCELSHARE)
+                    {
+                        double drop = when + (departure - CHECKINWINDOW - when) * uniform(random);
+                        if (drop < cancelled)
+                        {
+                            events.push_back({drop, sailingRequest("DELETE", sailingID, v.licence)});
+                        }
+                    }
+                    else if (uniform(random) < CHECKINSHARE && cancelled == departure)
+                    {
+                        double arrive = departure - CHECKINWINDOW + (CHECKINWINDOW - CHECKINCLOSE) * uniform(random);
+                        events.push_back({arrive, sailingRequest("CHECKIN", sailingID, v.licence)});
+                    }
+                }
+            }
+        }
+    }
+
+    for (const WorkloadVessel& vessel : VESSELS)
+    {
+        out << "VESSEL " << vessel.name << ' ' << vessel.lowLength << ' ' << vessel.highLength << '\n';
+    }
+    std::stable_sort(events.begin(), events.end(), [](const WorkloadEvent& a, const WorkloadEvent& b)
+    {
+        return a.minute < b.minute;
+    });
+    for (const WorkloadEvent& event : events)
+    {
+        out << event.request << '\n';
+    }
+    std::cerr << "Generated " << events.size() + sizeof(VESSELS) / sizeof(VESSELS[0]) << " requests for "
+              << created << " sailings\n";
+}
+
+// Function runGenerate reads the options of "workload generate" and
+// writes the requests
+// Throws an exception for an unknown or malformed argument
+//------------------------------------------------------------
+static int runGenerate(int argc, char* argv[])
+{
+    int sailings = 100;
+    int days = 7;
+    double fill = 0.9;
+    unsigned seed = 1;
+    std::string output;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        const char* value;
+        if ((value = optionValue(arg, "--sailings=")) != nullptr)
+        {
+            sailings = std::stoi(value);
+        }
+        else if ((value = optionValue(arg, "--days=")) != nullptr)
+        {
+            days = std::stoi(value);
+        }
+        else if ((value = optionValue(arg, "--fill=")) != nullptr)
+        {
+            fill = std::stod(value);
+        }
+        else if ((value = optionValue(arg, "--seed=")) != nullptr)
+        {
+            seed = static_cast<unsigned>(std::stoul(value));
+        }
+        else if ((value = optionValue(arg, "--output=")) != nullptr)
+        {
+            output = value;
+        }
+        else
+        {
+            throw std::runtime_error("Unknown argument " + arg);
+        }
+    }
+    int perDay = static_cast<int>(sizeof(DEPARTUREHOURS) / sizeof(DEPARTUREHOURS[0]) *
+                                  (sizeof(TERMINALS) / sizeof(TERMINALS[0])));
+    if (sailings <= 0 || days <= 0 || days > SAILINGFIELDMAX || fill <= 0)
+    {
+        throw std::runtime_error("--sailings, --days and --fill must be positive, --days at most 99");
+    }
+    if (sailings > days * perDay)
+    {
+        throw std::runtime_error("At most " + std::to_string(perDay) + " sailings fit in a day");
+    }
+    if (output.empty())
+    {
+        generate(std::cout, sailings, days, fill, seed);
+        return 0;
+    }
+    std::ofstream file(output);
+    generate(file, sailings, days, fill, seed);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot write " + output);
+    }
+    return 0;
+}
+
+//============================================================
+// Function requestWord returns the first word of a request line
+//------------------------------------------------------------
+static std::string requestWord(const std::string& line)
+{
+    return line.substr(0, line.find(' '));
+}
+
+// Function runClient runs the requests queued for one client, each no
+// earlier than it is due when a rate is set, and records their latency
+//------------------------------------------------------------
+static void runClient(const std::vector<ReplayRequest>& requests, double rate,
+                      std::chrono::steady_clock::time_point start, std::map<std::string, ReplayStats>& stats)
+{
+    typedef std::chrono::steady_clock Clock;
+    for (const ReplayRequest& request : requests)
+    {
+        Clock::time_point began = Clock::now();
+        if (rate > 0)
+        {
+            began = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(request.index / rate));
+            std::this_thread::sleep_until(began);
+        }
+        std::string reply = serviceExecute(request.line);
+        long long taken = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - began).count();
+        ReplayStats& entry = stats[requestWord(request.line)];
+        entry.microseconds.push_back(static_cast<uint32_t>(std::min<long long>(taken, UINT32_MAX)));
+        if (reply.rfind("OK", 0) != 0)
+        {
+            entry.errors++;
+        }
+    }
+}
+
+// Function percentile returns the p-th fraction of the sorted values
+//------------------------------------------------------------
+static double percentile(const std::vector<uint32_t>& sorted, double p)
+{
+    return sorted.empty() ? 0 : sorted[static_cast<std::size_t>(p * (sorted.size() - 1))];
+}
+
+// Function replay runs the requests of in from clients threads and
+// writes the results to out
+// Throws an exception if the data files cannot be opened
+//------------------------------------------------------------
+static void replay(std::istream& in, std::ostream& out, int clients, double rate, const std::string& durability)
+{
+    // Requests about one sailing stay on one client, in file order
+    std::vector<std::string> setup;
+    std::vector<std::vector<ReplayRequest>> queues(clients);
+    std::string line;
+    long total = 0;
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        if (requestWord(line) == "VESSEL")
+        {
+            setup.push_back(line);
+            continue;
+        }
+        uint64_t key = serviceSailingKey(line);
+        queues[((key * 0x9E3779B97F4A7C15ull) >> 32) % clients].push_back({total++, line});
+    }
+    for (const std::string& request : setup)
+    {
+        serviceExecute(request);
+    }
+
+    std::vector<std::map<std::string, ReplayStats>> stats(clients);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < clients; ++c)
+    {
+        threads.emplace_back(runClient, std::cref(queues[c]), rate, start, std::ref(stats[c]));
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Merge the clients' latencies by request type, and over all requests
+    std::map<std::string, ReplayStats> merged;
+    for (auto& client : stats)
+    {
+        for (auto& entry : client)
+        {
+            for (const char* name : {entry.first.c_str(), "ALL"})
+            {
+                ReplayStats& into = merged[name];
+                into.microseconds.insert(into.microseconds.end(), entry.second.microseconds.begin(),
+                                         entry.second.microseconds.end());
+                into.errors += entry.second.errors;
+            }
+        }
+    }
+    out << std::fixed << std::setprecision(3)
+        << "{\n  \"benchmark\": \"replay\",\n"
+        << "  \"requests\": " << total << ",\n"
+        << "  \"clients\": " << clients << ",\n"
+        << "  \"targetRate\": " << rate << ",\n"
+        << "  \"durability\": \"" << durability << "\",\n"
+        << "  \"seconds\": " << seconds << ",\n"
+        << "  \"requestsPerSecond\": " << (seconds > 0 ? total / seconds : 0) << ",\n"
+        << "  \"results\": [";
+    std::ostringstream table;
+    table << std::fixed;
+    bool first = true;
+    for (auto& entry : merged)
+    {
+        std::vector<uint32_t>& sorted = entry.second.microseconds;
+        std::sort(sorted.begin(), sorted.end());
+        out << (first ? "\n" : ",\n")
+            << "    {\"request\": \"" << entry.first << "\", \"count\": " << sorted.size()
+            << ", \"errors\": " << entry.second.errors << ", \"p50Us\": " << percentile(sorted, 0.50)
+            << ", \"p90Us\": " << percentile(sorted, 0.90) << ", \"p99Us\": " << percentile(sorted, 0.99)
+            << ", \"maxUs\": " << (sorted.empty() ? 0 : sorted.back()) << "}";
+        first = false;
+        table << std::setw(8) << std::left << entry.first << std::right << std::setw(9) << sorted.size()
+              << " requests" << std::setw(8) << entry.second.errors << " errors  p50 " << std::setprecision(0)
+              << percentile(sorted, 0.50) << " us  p90 " << percentile(sorted, 0.90) << " us  p99 "
+              << percentile(sorted, 0.99) << " us\n" << std::setprecision(3);
+    }
+    out << "\n  ]\n}\n";
+    out.flush();
+    std::cerr << table.str() << std::fixed << std::setprecision(0) << total << " requests in "
+              << std::setprecision(2) << seconds << " s, "
+              << std::setprecision(0) << (seconds > 0 ? total / seconds : 0) << " requests/s\n";
+}
+
+// Function runReplay reads the options of "workload replay", opens
+// fresh data files and replays the request file
+// Throws an exception for an unknown or malformed argument, or if the
+// files cannot be opened
+//------------------------------------------------------------
+static int runReplay(int argc, char* argv[])
+{
+    int clients = 4;
+    double rate = 0;
+    std::string durability = "group";
+    std::string dir = "replay-data";
+    std::string output;
+    std::string input;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        const char* value;
+        if ((value = optionValue(arg, "--clients=")) != nullptr)
+        {
+            clients = std::stoi(value);
+        }
+        else if ((value = optionValue(arg, "--rate=")) != nullptr)
+        {
+            rate = std::stod(value);
+        }
+        else if ((value = optionValue(arg, "--durability=")) != nullptr)
+        {
+            durability = value;
+        }
+        else if ((value = optionValue(arg, "--dir=")) != nullptr)
+        {
+            dir = value;
+        }
+        else if ((value = optionValue(arg, "--output=")) != nullptr)
+        {
+            output = value;
+        }
+        else if (input.empty() && arg.rfind("--", 0) != 0)
+        {
+            input = arg;
+        }
+        else
+        {
+            throw std::runtime_error("Unknown argument " + arg);
+        }
+    }
+    if (clients <= 0 || rate < 0)
+    {
+        throw std::runtime_error("--clients must be positive and --rate not negative");
+    }
+    WalDurability level = walParseDurability(durability);
+
+    // Both files are opened before moving to the data directory
+    std::ifstream in;
+    if (!input.empty() && input != "-")
+    {
+        in.open(input);
+        if (!in)
+        {
+            throw std::runtime_error("Cannot open " + input);
+        }
+    }
+    std::ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+        if (!file)
+        {
+            throw std::runtime_error("Cannot open " + output);
+        }
+    }
+
+    std::filesystem::create_directories(dir);
+    std::filesystem::current_path(dir);
+    for (const char* name : DATAFILES)
+    {
+        std::filesystem::remove(name);
+    }
+    walOpen(DATAFILES[0], level, 10);
+    vehicleOpen();
+    vesselOpen();
+    reservationOpen();
+    sailingOpen();
+    replay(in.is_open() ? static_cast<std::istream&>(in) : std::cin,
+           file.is_open() ? static_cast<std::ostream&>(file) : std::cout, clients, rate, durability);
+    serviceFlushCapacity();
+    walClose();
+    vehicleClose();
+    vesselClose();
+    reservationClose();
+    sailingClose();
+    return 0;
+}
+
+//============================================================
+int main(int argc, char* argv[])
+{
+    std::string mode = argc > 1 ? argv[1] : "";
+    try
+    {
+        if (mode == "generate")
+        {
+            return runGenerate(argc, argv);
+        }
+        if (mode == "replay")
+        {
+            return runReplay(argc, argv);
+        }
+        throw std::runtime_error(mode.empty() ? "Missing mode" : "Unknown mode " + mode);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n'
+                  << "Usage: workload generate [--sailings=<n>] [--days=<n>] [--fill=<f>] [--seed=<n>] [--output=<file>]\n"
+                  << "       workload replay [--clients=<n>] [--rate=<requests/s>] [--durability=sync|group|async]\n"
+                  << "                       [--dir=<path>] [--output=<file>] <file>\n";
+        return 1;
+    }
+}
@@ -0,0 +1,782 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: writeAheadLog.cpp
+*
+* Revision History:
+* Rev. 1 - 26/10/17 Original
+*
+* Description: Implementation file of the WriteAheadLog module of the
+* Ferry Reservation System. Logged changes are collected in a memory
+* buffer; a flush writes the whole buffer with one write() and makes
+* it durable with one fdatasync(), however many changes it holds.
+* Each record is a fixed header followed by the changed bytes:
+*   magic, checksum, lsn, byte offset, file tag, size, operation
+*
+* A checkpoint writes the records still to be replayed to <log>.new,
+* syncs it, renames it over the log and syncs the directory; only then
+* does the new file take over from the old descriptor.
+*
+* Design Issues: Must be on a POSIX system for fdatasync; the _WIN32
+* build uses _commit instead, and cannot rename over an open file, so
+* it closes the old log first
+* A checkpoint holds the apply lock while the data files are flushed,
+* so changes wait for the duration of the flush
+*/
+//============================================================
+
+#include "writeAheadLog.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#ifdef _WIN32
+  #include <io.h>
+  #include <fcntl.h>
+  #include <windows.h>
+#else
+  #include <unistd.h>
+  #include <fcntl.h>
+#endif
+
+//============================================================
+// Struct: WalRecordHeader
+// Purpose: Fixed header stored in front of every log record
+//------------------------------------------------------------
+struct WalRecordHeader
+{
+    uint32_t magic;     // WALMAGIC, marks the start of a record
+    uint32_t checksum;  // FNV-1a of the header (checksum zero) and data
+    uint64_t lsn;       // log sequence number
+    uint64_t offset;    // first byte written, or the new file size
+    uint32_t fileTag;   // data file the change belongs to
+    uint32_t size;      // bytes of data following the header
+    uint16_t operation; // WalOperation
+    uint16_t reserved;  // always zero
+};
+
+//============================================================
+// Struct: RecoveredRecord
+// Purpose: A record found in the log at open, waiting to be replayed
+//------------------------------------------------------------
+struct RecoveredRecord
+{
+    uint32_t fileTag;       // data file the change belongs to
+    std::vector<char> raw;  // header and data exactly as logged
+};
+
+//============================================================
+// Module scope constants and static variables
+//------------------------------------------------------------
+static const uint32_t WALMAGIC = 0x4C415746;    // "FWAL"
+static const int CHECKPOINTMS = 1000;           // checkpoint interval in milliseconds
+static const std::size_t FLUSHBYTES = 1 << 20;  // buffered bytes that wake the committer early
+
+static int logFd = -1;                          // log file descriptor, -1 if closed
+static int lockFd = -1;                         // descriptor of <log>.lock, -1 if not locked
+static std::string lockFileName;                // name of the locked file
+static bool lockExclusive = false;              // the lock held is exclusive
+static std::string logFileName;                 // name of the log file
+static WalDurability logDurability = WALGROUPCOMMIT;
+static std::chrono::milliseconds logInterval(10);
+
+static std::mutex logMutex;                     // guards the variables below it
+static std::condition_variable durableCond;     // signalled when durableLsn advances
+static std::condition_variable committerCond;   // wakes the committer and checkpointer
+static std::vector<char> pending;               // logged but not yet written
+static uint64_t nextLsn = 1;                    // lsn of the next record
+static uint64_t loggedLsn = 0;                  // lsn of the last record in pending
+static uint64_t durableLsn = 0;                 // every record up to this lsn is on disk
+static std::size_t logBytes = 0;                // bytes in the log file since the last checkpoint
+static bool stopping = false;                   // set by walClose
+
+static std::mutex ioMutex;                      // serializes write, sync and truncate of the log
+static std::mutex applyMutex;                   // held while a change is logged and applied
+static std::map<uint32_t, std::function<void()>> registered; // data file syncs, under applyMutex
+static std::vector<RecoveredRecord> recovered;  // records not yet replayed, under applyMutex
+
+static thread_local int batchDepth = 0;         // nesting of WalBatch scopes on this thread
+static thread_local uint64_t batchLsn = 0;      // last lsn logged inside the current batch
+
+static std::thread committer;
+static std::thread checkpointer;
+
+//============================================================
+// Function checksumOf returns the FNV-1a checksum of a record
+//------------------------------------------------------------
+static uint32_t checksumOf(WalRecordHeader header, const char* data, std::size_t size)
+{
+    header.checksum = 0;
+    uint32_t hash = 2166136261u;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&header);
+    for (std::size_t i = 0; i < sizeof(header); ++i)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+// Function openLog opens (creating if needed) a log file for appending,
+// emptying it first if truncate is true
+// Returns the descriptor, or -1 if it cannot be opened
+//------------------------------------------------------------
+static int openLog(const std::string& name, bool truncate)
+{
+    metricsCountSyscalls();
+#ifdef _WIN32
+    return _open(name.c_str(), _O_RDWR | _O_CREAT | _O_APPEND | _O_BINARY | (truncate ? _O_TRUNC : 0),
+                 _S_IREAD | _S_IWRITE);
+#else
+    return ::open(name.c_str(), O_RDWR | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+#endif
+}
+
+// Function closeLog closes a log file descriptor
+//------------------------------------------------------------
+static void closeLog(int fd)
+{
+    metricsCountSyscalls();
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+// Function syncLog makes the bytes written to the log file fd durable
+//------------------------------------------------------------
+static int syncLog(int fd)
+{
+    metricsCountSyscalls();
+#ifdef _WIN32
+    return _commit(fd);
+#else
+    return fdatasync(fd);
+#endif
+}
+
+// Function writeLog writes size bytes to the end of the log file fd
+// Throws an exception if the write fails
+//------------------------------------------------------------
+static void writeLog(int fd, const char* data, std::size_t size)
+{
+    while (size > 0)
+    {
+#ifdef _WIN32
+        int written = _write(fd, data, static_cast<unsigned>(size));
+#else
+        ssize_t written = ::write(fd, data, size);
+#endif
+        metricsCountSyscalls();
+        if (written <= 0)
+        {
+            throw std::runtime_error("writeAheadLog: Cannot write to " + logFileName);
+        }
+        metricsCountWritten(static_cast<uint64_t>(written));
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+}
+
+// Function lockLog locks the whole of the open lock file fd, exclusive
+// or shared, without waiting. Returns false if another process holds a
+// conflicting lock; an unlocked fd is locked, a locked one converted
+//------------------------------------------------------------
+static bool lockLog(int fd, bool exclusive)
+{
+    metricsCountSyscalls();
+#ifdef _WIN32
+    HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+    OVERLAPPED whole = {};
+    UnlockFileEx(handle, 0, MAXDWORD, MAXDWORD, &whole);
+    DWORD flags = LOCKFILE_FAIL_IMMEDIATELY | (exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0);
+    return LockFileEx(handle, flags, 0, MAXDWORD, MAXDWORD, &whole) != 0;
+#else
+    struct flock range;
+    std::memset(&range, 0, sizeof(range));
+    range.l_type = exclusive ? F_WRLCK : F_RDLCK;
+    range.l_whence = SEEK_SET;
+    range.l_start = 0;
+    range.l_len = 0; // to the end of the file, however long
+    return fcntl(fd, F_SETLK, &range) == 0;
+#endif
+}
+
+// Function syncDirectory makes a rename in the directory of fileName
+// durable. Does nothing on _WIN32, where the rename is written through
+// Throws an exception if the directory cannot be synced
+//------------------------------------------------------------
+static void syncDirectory(const std::string& fileName)
+{
+#ifndef _WIN32
+    std::string::size_type slash = fileName.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : fileName.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY);
+    metricsCountSyscalls(3); // the open, fsync and close
+    if (fd < 0 || fsync(fd) != 0)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        throw std::runtime_error("writeAheadLog: Cannot sync directory " + directory);
+    }
+    ::close(fd);
+#else
+    (void)fileName;
+#endif
+}
+
+// Function replaceLog writes the records still to be replayed to a new
+// log file and puts it in place of the log. The caller holds ioMutex
+// Returns the bytes in the new log
+// Throws an exception if the new log cannot be written or renamed; the
+// old log is then still in use
+//------------------------------------------------------------
+static std::size_t replaceLog()
+{
+    std::string nextName = logFileName + ".new";
+    int next = openLog(nextName, true);
+    if (next < 0)
+    {
+        throw std::runtime_error("writeAheadLog: Cannot open " + nextName);
+    }
+    std::size_t kept = 0;
+    try
+    {
+        for (const RecoveredRecord& record : recovered)
+        {
+            writeLog(next, record.raw.data(), record.raw.size());
+            kept += record.raw.size();
+        }
+        if (syncLog(next) != 0)
+        {
+            throw std::runtime_error("writeAheadLog: Cannot sync " + nextName);
+        }
+    }
+    catch (const std::exception&)
+    {
+        closeLog(next);
+        std::remove(nextName.c_str());
+        throw;
+    }
+    metricsCountSyscalls();
+#ifdef _WIN32
+    // The log cannot be replaced while it is open
+    closeLog(next);
+    closeLog(logFd);
+    bool renamed = MoveFileExA(nextName.c_str(), logFileName.c_str(),
+                               MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+    int reopened = openLog(logFileName, false);
+    if (reopened < 0)
+    {
+        throw std::runtime_error("writeAheadLog: Cannot reopen " + logFileName);
+    }
+    logFd = reopened;
+    if (!renamed)
+    {
+        std::remove(nextName.c_str());
+        throw std::runtime_error("writeAheadLog: Cannot replace " + logFileName);
+    }
+#else
+    if (std::rename(nextName.c_str(), logFileName.c_str()) != 0)
+    {
+        closeLog(next);
+        std::remove(nextName.c_str());
+        throw std::runtime_error("writeAheadLog: Cannot replace " + logFileName);
+    }
+    // The old descriptor now refers to the replaced file: switch first
+    closeLog(logFd);
+    logFd = next;
+    syncDirectory(logFileName);
+#endif
+    return kept;
+}
+
+// Function flushLog writes every pending record with one write()
+// and makes it durable with one sync
+// Throws an exception if the log cannot be written
+//------------------------------------------------------------
+static void flushLog()
+{
+    std::lock_guard<std::mutex> io(ioMutex);
+    std::vector<char> batch;
+    uint64_t upTo;
+    {
+        std::lock_guard<std::mutex> lock(logMutex);
+        if (loggedLsn <= durableLsn)
+        {
+            return;
+        }
+        batch.swap(pending);
+        upTo = loggedLsn;
+    }
+    writeLog(logFd, batch.data(), batch.size());
+    if (syncLog(logFd) != 0)
+    {
+        throw std::runtime_error("writeAheadLog: Cannot sync " + logFileName);
+    }
+    {
+        std::lock_guard<std::mutex> lock(logMutex);
+        durableLsn = upTo;
+        logBytes += batch.size();
+    }
+    durableCond.notify_all();
+}
+
+// Function appendRecord adds a record to the pending buffer
+// Returns its log sequence number
+//------------------------------------------------------------
+static uint64_t appendRecord(uint32_t fileTag, uint64_t offset, WalOperation operation, const void* data, std::size_t size)
+{
+    if (logFd < 0)
+    {
+        throw std::runtime_error("writeAheadLog: Log not open.");
+    }
+    WalRecordHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = WALMAGIC;
+    header.fileTag = fileTag;
+    header.offset = offset;
+    header.size = static_cast<uint32_t>(size);
+    header.operation = static_cast<uint16_t>(operation);
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(logMutex);
+        header.lsn = nextLsn++;
+        header.checksum = checksumOf(header, static_cast<const char*>(data), size);
+        const char* headerBytes = reinterpret_cast<const char*>(&header);
+        pending.insert(pending.end(), headerBytes, headerBytes + sizeof(header));
+        pending.insert(pending.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+        loggedLsn = header.lsn;
+        wake = pending.size() >= FLUSHBYTES;
+    }
+    if (wake)
+    {
+        committerCond.notify_all();
+    }
+    return header.lsn;
+}
+
+// Function readRecovered reads every valid record of the log into
+// recovered, stopping at the first torn or corrupt record
+//------------------------------------------------------------
+static void readRecovered()
+{
+    struct stat info;
+    metricsCountSyscalls();
+    if (fstat(logFd, &info) != 0)
+    {
+        throw std::runtime_error("writeAheadLog: Cannot read size of " + logFileName);
+    }
+    std::vector<char> content(static_cast<std::size_t>(info.st_size));
+    std::size_t done = 0;
+    while (done < content.size())
+    {
+#ifdef _WIN32
+        int got = _read(logFd, content.data() + done, static_cast<unsigned>(content.size() - done));
+#else
+        ssize_t got = ::pread(logFd, content.data() + done, content.size() - done, static_cast<off_t>(done));
+#endif
+        metricsCountSyscalls();
+        if (got <= 0)
+        {
+            break;
+        }
+        metricsCountRead(static_cast<uint64_t>(got));
+        done += static_cast<std::size_t>(got);
+    }
+
+    recovered.clear();
+    std::size_t offset = 0;
+    while (offset + sizeof(WalRecordHeader) <= done)
+    {
+        WalRecordHeader header;
+        std::memcpy(&header, content.data() + offset, sizeof(header));
+        std::size_t end = offset + sizeof(header) + header.size;
+        if (header.magic != WALMAGIC || end > done ||
+            checksumOf(header, content.data() + offset + sizeof(header), header.size) != header.checksum)
+        {
+            break;
+        }
+        RecoveredRecord record;
+        record.fileTag = header.fileTag;
+        record.raw.assign(content.begin() + offset, content.begin() + end);
+        recovered.push_back(record);
+        if (header.lsn >= nextLsn)
+        {
+            nextLsn = header.lsn + 1;
+        }
+        offset = end;
+    }
+    durableLsn = nextLsn - 1;
+    loggedLsn = durableLsn;
+    logBytes = done;
+}
+
+// Function runCommitter flushes the pending buffer every interval
+//------------------------------------------------------------
+static void runCommitter()
+{
+    std::unique_lock<std::mutex> lock(logMutex);
+    while (!stopping)
+    {
+        committerCond.wait_for(lock, logInterval);
+        if (loggedLsn > durableLsn)
+        {
+            lock.unlock();
+            try
+            {
+                flushLog();
+            }
+            catch (const std::exception& e)
+            {
+                LOGWRITE(LOGERROR, "writeAheadLog.flush", {"error", e.what()});
+            }
+            lock.lock();
+        }
+    }
+}
+
+// Function runCheckpointer checkpoints every CHECKPOINTMS while the
+// log holds records
+//------------------------------------------------------------
+static void runCheckpointer()
+{
+    std::unique_lock<std::mutex> lock(logMutex);
+    while (!stopping)
+    {
+        committerCond.wait_for(lock, std::chrono::milliseconds(CHECKPOINTMS));
+        if (stopping || (logBytes == 0 && pending.empty()))
+        {
+            continue;
+        }
+        lock.unlock();
+        try
+        {
+            walCheckpoint();
+        }
+        catch (const std::exception& e)
+        {
+            LOGWRITE(LOGERROR, "writeAheadLog.checkpoint", {"error", e.what()});
+        }
+        lock.lock();
+    }
+}
+
+//============================================================
+// Function walOpen opens (creating if needed) the log file and starts
+// the committer and checkpointer threads
+// intervalMs is the group commit / async flush interval in milliseconds
+// Throws an exception if the log cannot be opened
+//------------------------------------------------------------
+void walOpen(const std::string& logName, WalDurability durability, int intervalMs)
+{
+    if (logFd >= 0)
+    {
+        throw std::runtime_error("File " + logName + " is already open.");
+    }
+    walLock(logName, true);
+    logFd = openLog(logName, false);
+    if (logFd < 0)
+    {
+        throw std::runtime_error("Cannot open " + logName + ".");
+    }
+    // A log left half written by a checkpoint that did not finish; the
+    // log it was to replace is still complete
+    std::remove((logName + ".new").c_str());
+    logFileName = logName;
+    logDurability = durability;
+    logInterval = std::chrono::milliseconds(intervalMs > 0 ? intervalMs : 1);
+    pending.clear();
+    stopping = false;
+    readRecovered();
+
+    if (logDurability != WALSYNCPEROP)
+    {
+        committer = std::thread(runCommitter);
+    }
+    checkpointer = std::thread(runCheckpointer);
+}
+
+// Function walLock locks <logName>.lock for this process until it exits
+// or calls walUnlock, exclusive or shared
+// Throws an exception if another process holds a lock that conflicts
+//------------------------------------------------------------
+void walLock(const std::string& logName, bool exclusive)
+{
+    std::string name = logName + ".lock";
+    if (lockFd >= 0 && name == lockFileName && exclusive == lockExclusive)
+    {
+        return;
+    }
+    if (lockFd >= 0 && name != lockFileName)
+    {
+        walUnlock();
+    }
+    if (lockFd < 0)
+    {
+        // never renamed or written, so every process locks the same file
+        lockFd = openLog(name, false);
+        if (lockFd < 0)
+        {
+            throw std::runtime_error("Cannot open " + name + ".");
+        }
+        lockFileName = name;
+    }
+    if (!lockLog(lockFd, exclusive))
+    {
+        walUnlock();
+        throw std::runtime_error("Another process is using the data files of " + logName +
+                                 (exclusive ? "; stop it, or start every process with --shared." :
+                                              "; stop it before starting with --shared."));
+    }
+    lockExclusive = exclusive;
+}
+
+// Function walUnlock releases the lock taken by walLock
+//------------------------------------------------------------
+void walUnlock()
+{
+    if (lockFd >= 0)
+    {
+        closeLog(lockFd); // closing the descriptor releases the lock
+        lockFd = -1;
+        lockFileName.clear();
+        lockExclusive = false;
+    }
+}
+
+// Function walIsOpen returns true if the log is open
+//------------------------------------------------------------
+bool walIsOpen()
+{
+    return logFd >= 0;
+}
+
+// Function walClose checkpoints, stops the threads and closes the log
+//------------------------------------------------------------
+void walClose()
+{
+    if (logFd < 0)
+    {
+        throw std::runtime_error("File " + logFileName + " was already closed.");
+    }
+    {
+        std::lock_guard<std::mutex> lock(logMutex);
+        stopping = true;
+    }
+    committerCond.notify_all();
+    if (committer.joinable())
+    {
+        committer.join();
+    }
+    if (checkpointer.joinable())
+    {
+        checkpointer.join();
+    }
+    walCheckpoint();
+    closeLog(logFd);
+    logFd = -1;
+}
+
+// Function walParseDurability converts "sync", "group" or "async"
+// to a durability level. Throws an exception for any other text
+//------------------------------------------------------------
+WalDurability walParseDurability(const std::string& text)
+{
+    if (text == "sync")
+    {
+        return WALSYNCPEROP;
+    }
+    if (text == "group")
+    {
+        return WALGROUPCOMMIT;
+    }
+    if (text == "async")
+    {
+        return WALASYNC;
+    }
+    throw std::runtime_error("Unknown durability level '" + text + "' (use sync, group or async).");
+}
+
+// Function walFileTag returns the tag identifying a data file in the log
+//------------------------------------------------------------
+uint32_t walFileTag(const std::string& fileName)
+{
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : fileName)
+    {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+// Function walApplyLock locks out checkpoints while a change is
+// logged and applied to its data file
+//------------------------------------------------------------
+std::unique_lock<std::mutex> walApplyLock()
+{
+    return std::unique_lock<std::mutex>(applyMutex);
+}
+
+// Function walLogWrite logs size bytes written at a byte offset of a data file
+// Returns the log sequence number of the record
+//------------------------------------------------------------
+uint64_t walLogWrite(uint32_t fileTag, uint64_t offset, const void* data, std::size_t size)
+{
+    return appendRecord(fileTag, offset, WALWRITE, data, size);
+}
+
+// Function walLogTruncate logs that a data file was cut down to fileSize bytes
+// Returns the log sequence number of the record
+//------------------------------------------------------------
+uint64_t walLogTruncate(uint32_t fileTag, uint64_t fileSize)
+{
+    return appendRecord(fileTag, fileSize, WALTRUNCATE, nullptr, 0);
+}
+
+// Function walFlush makes every change logged so far durable now,
+// whatever the durability level
+// Throws an exception if the log cannot be written
+//------------------------------------------------------------
+void walFlush()
+{
+    flushLog();
+}
+
+// Function walCommit returns once the record lsn is committed
+// according to the durability level
+// Throws an exception if the log cannot be written
+//------------------------------------------------------------
+void walCommit(uint64_t lsn)
+{
+    if (batchDepth > 0)
+    {
+        batchLsn = lsn > batchLsn ? lsn : batchLsn;
+        return;
+    }
+    if (logDurability == WALSYNCPEROP)
+    {
+        flushLog();
+    }
+    else if (logDurability == WALGROUPCOMMIT)
+    {
+        std::unique_lock<std::mutex> lock(logMutex);
+        durableCond.wait(lock, [lsn] { return durableLsn >= lsn || stopping; });
+    }
+}
+
+// Function walBeginBatch starts a batch on this thread: walCommit calls
+// only remember their lsn until the matching walEndBatch
+//------------------------------------------------------------
+void walBeginBatch()
+{
+    batchDepth++;
+}
+
+// Function walEndBatch ends a batch and commits every change made in it
+// with a single walCommit
+// Throws an exception if the log cannot be written
+//------------------------------------------------------------
+void walEndBatch()
+{
+    uint64_t lsn = walDetachBatch();
+    if (lsn != 0)
+    {
+        walCommit(lsn);
+    }
+}
+
+// Function walDetachBatch ends a batch without committing it
+// Returns the lsn to pass to walCommit, from any thread, before the
+// batch's changes count as committed; 0 if there is nothing to wait for
+//------------------------------------------------------------
+uint64_t walDetachBatch()
+{
+    if (batchDepth == 0 || --batchDepth > 0 || batchLsn == 0)
+    {
+        return 0;
+    }
+    uint64_t lsn = batchLsn;
+    batchLsn = 0;
+    return logFd >= 0 ? lsn : 0;
+}
+
+// Function walRegister gives the checkpointer the function that
+// flushes a data file to disk
+//------------------------------------------------------------
+void walRegister(uint32_t fileTag, const std::function<void()>& sync)
+{
+    std::lock_guard<std::mutex> apply(applyMutex);
+    registered[fileTag] = sync;
+}
+
+// Function walUnregister removes a data file from checkpoints
+//------------------------------------------------------------
+void walUnregister(uint32_t fileTag)
+{
+    std::lock_guard<std::mutex> apply(applyMutex);
+    registered.erase(fileTag);
+}
+
+// Function walReplay calls apply, in log order, for every record of
+// a data file still in the log. Returns the number of records replayed
+//------------------------------------------------------------
+int walReplay(uint32_t fileTag,
+              const std::function<void(int operation, uint64_t offset, const char* data, std::size_t size)>& apply)
+{
+    std::lock_guard<std::mutex> lock(applyMutex);
+    int replayed = 0;
+    std::vector<RecoveredRecord> remaining;
+    for (RecoveredRecord& record : recovered)
+    {
+        if (record.fileTag != fileTag)
+        {
+            remaining.push_back(record);
+            continue;
+        }
+        WalRecordHeader header;
+        std::memcpy(&header, record.raw.data(), sizeof(header));
+        apply(header.operation, header.offset, record.raw.data() + sizeof(header), header.size);
+        replayed++;
+    }
+    recovered.swap(remaining);
+    return replayed;
+}
+
+// Function walCheckpoint makes the log durable, has every registered
+// data file write its changes back, and replaces the log with one
+// holding only the records of files not opened yet
+// Throws an exception if a file cannot be flushed or the log replaced
+//------------------------------------------------------------
+void walCheckpoint()
+{
+    std::lock_guard<std::mutex> apply(applyMutex);
+    flushLog();
+    for (auto& file : registered)
+    {
+        file.second();
+    }
+
+    // Every logged change is now durable in its data file. Records of
+    // files that have not been opened and replayed yet move to the new log
+    std::lock_guard<std::mutex> io(ioMutex);
+    std::size_t kept = replaceLog();
+    std::lock_guard<std::mutex> lock(logMutex);
+    logBytes = kept;
+}
@@ -0,0 +1,213 @@
+//@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+//============================================================
+//============================================================
+/*
+* Filename: writeAheadLog.hpp
+*
+* Description: Header file of the WriteAheadLog module of the Ferry
+* Reservation System. Every change a RecordFile makes to a data file
+* is first appended to a single shared log file. The log is made
+* durable according to the selected durability level:
+*   WALSYNCPEROP   - the caller waits for its own fdatasync
+*   WALGROUPCOMMIT - a committer thread issues one fdatasync for all
+*                    changes logged in the last interval, and callers
+*                    wait for that batch to be durable
+*   WALASYNC       - the committer thread flushes every interval and
+*                    callers never wait
+* The log only redoes changes, so a data file must not receive a
+* change before the log holds it durably: RecordFile keeps its changes
+* in a private copy of the file while the log is open. A checkpointer
+* thread periodically makes the log durable, has every data file write
+* its changes back, and replaces the log with an empty one. When a
+* data file is opened, any changes for it still in the log are
+* replayed into it first.
+* walOpen() must be called before the data files are opened.
+* A process holding private copies must be the only one using the
+* data files, or whichever wrote back last would undo the other's
+* changes; walOpen() therefore locks <log>.lock exclusively for as
+* long as the process runs, and processes in shared mode, which work
+* on the files themselves, lock it shared with walLock().
+*
+* Design Issues: Records carry a checksum so a torn tail is ignored
+* Changes are applied to the data files under walApplyLock() so a
+* checkpoint never sees a change that is logged but not yet applied
+* The emptied log is written as <log>.new and renamed over the log,
+* so a crash during a checkpoint leaves either the old log, which
+* replays onto the partly written data files, or the new one
+*/
+//============================================================
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <mutex>
+#include <string>
+
+//============================================================
+// Enum: WalDurability
+// Purpose: When a logged change is considered committed
+//------------------------------------------------------------
+enum WalDurability
+{
+    WALSYNCPEROP,
+    WALGROUPCOMMIT,
+    WALASYNC
+};
+
+//============================================================
+// Enum: WalOperation
+// Purpose: Kind of change stored in a log record
+//------------------------------------------------------------
+enum WalOperation
+{
+    WALWRITE = 1,   // bytes written starting at a byte offset
+    WALTRUNCATE = 2 // file cut down to a size in bytes
+};
+
+//============================================================
+// Function walOpen opens (creating if needed) the log file and starts
+// the committer and checkpointer threads, after locking it for this
+// process with walLock; the lock outlives walClose, since the data
+// files are written back when they are closed
+// intervalMs is the group commit / async flush interval in milliseconds
+// Throws an exception if the log cannot be opened or another process
+// is using it
+//------------------------------------------------------------
+void walOpen(const std::string& logName, WalDurability durability, int intervalMs);
+
+// Function walLock locks <logName>.lock for this process until it exits
+// or calls walUnlock: exclusive for a process using the log, see walOpen,
+// shared for processes working on the data files in shared mode
+// Throws an exception if another process holds a lock that conflicts
+//------------------------------------------------------------
+void walLock(const std::string& logName, bool exclusive);
+
+// Function walUnlock releases the lock taken by walLock. Must not be
+// called before the data files are closed
+//------------------------------------------------------------
+void walUnlock();
+
+// Function walIsOpen returns true if the log is open
+//------------------------------------------------------------
+bool walIsOpen();
+
+// Function walClose checkpoints, stops the threads and closes the log
+//------------------------------------------------------------
+void walClose();
+
+// Function walParseDurability converts "sync", "group" or "async"
+// to a durability level. Throws an exception for any other text
+//------------------------------------------------------------
+WalDurability walParseDurability(const std::string& text);
+
+// Function walFileTag returns the tag identifying a data file in the log
+//------------------------------------------------------------
+uint32_t walFileTag(const std::string& fileName);
+
+// Function walApplyLock locks out checkpoints while a change is
+// logged and applied to its data file
+//------------------------------------------------------------
+std::unique_lock<std::mutex> walApplyLock();
+
+// Function walLogWrite logs size bytes written at a byte offset of a data file
+// Returns the log sequence number of the record
+//------------------------------------------------------------
+uint64_t walLogWrite(uint32_t fileTag, uint64_t offset, const void* data, std::size_t size);
+
+// Function walLogTruncate logs that a data file was cut down to fileSize bytes
+// Returns the log sequence number of the record
+//------------------------------------------------------------
+uint64_t walLogTruncate(uint32_t fileTag, uint64_t fileSize);
+
+// Function walFlush makes every change logged so far durable now,
+// whatever the durability level
+// Throws an exception if the log cannot be written
+//------------------------------------------------------------
+void walFlush();
+
+// Function walCommit returns once the record lsn is committed
+// according to the durability level
+// Throws an exception if the log cannot be written
+//------------------------------------------------------------
+void walCommit(uint64_t lsn);
+
+// Function walBeginBatch starts a batch on this thread: walCommit calls
+// only remember their lsn until the matching walEndBatch
+//------------------------------------------------------------
+void walBeginBatch();
+
+// Function walEndBatch ends a batch and commits every change made in it
+// with a single walCommit
+// Throws an exception if the log cannot be written
+//------------------------------------------------------------
+void walEndBatch();
+
+// Function walDetachBatch ends a batch without committing it
+// Returns the lsn to pass to walCommit, from any thread, before the
+// batch's changes count as committed; 0 if there is nothing to wait for
+//------------------------------------------------------------
+uint64_t walDetachBatch();
+
+//============================================================
+// Struct: WalBatch
+// Purpose: Commits a multi-record operation once, when it goes out of scope
+//------------------------------------------------------------
+struct WalBatch
+{
+    WalBatch()
+    {
+        walBeginBatch();
+    }
+    ~WalBatch()
+    {
+        if (detached)
+        {
+            return;
+        }
+        try
+        {
+            walEndBatch();
+        }
+        catch (const std::exception&)
+        {
+            // the changes stay in the log buffer and go out with the next flush
+        }
+    }
+    WalBatch(const WalBatch&) = delete;
+    WalBatch& operator=(const WalBatch&) = delete;
+
+    // Function detach ends the batch now, leaving the commit to the
+    // caller; see walDetachBatch
+    //--------------------------------------------------------
+    uint64_t detach()
+    {
+        detached = true;
+        return walDetachBatch();
+    }
+
+private:
+    bool detached = false; // ended by detach, nothing left to commit
+};
+
+// Function walRegister gives the checkpointer the function that
+// flushes a data file to disk
+//------------------------------------------------------------
+void walRegister(uint32_t fileTag, const std::function<void()>& sync);
+
+// Function walUnregister removes a data file from checkpoints
+//------------------------------------------------------------
+void walUnregister(uint32_t fileTag);
+
+// Function walReplay calls apply, in log order, for every record of
+// a data file still in the log. Returns the number of records replayed
+//------------------------------------------------------------
+int walReplay(uint32_t fileTag,
+              const std::function<void(int operation, uint64_t offset, const char* data, std::size_t size)>& apply);
+
+// Function walCheckpoint makes the log durable, has every registered
+// data file write its changes back, and replaces the log with one
+// holding only the records of files not opened yet
+// Throws an exception if a file cannot be flushed or the log replaced
+//------------------------------------------------------------
+void walCheckpoint();